@@ -0,0 +1,29 @@
+#include "Benchmark.hpp"
+#include <cstdio>
+#include "AllocationCounter.hpp"
+
+using namespace uwv_kalman_filters::benchmark;
+
+std::size_t uwv_kalman_filters::benchmark::allocationCount()
+{
+    return test::allocationCount();
+}
+
+Runner::Runner(double min_time, std::size_t min_iterations) : min_time(min_time), min_iterations(min_iterations)
+{
+}
+
+void Runner::printHeader()
+{
+#ifndef UWV_KALMAN_FILTERS_COUNTS_MALLOC
+    std::printf("allocs/op only counts operator new, the allocations of the Eigen types are not included\n");
+#endif
+    std::printf("%-56s %12s %14s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+}
+
+void Runner::report(const Result& result)
+{
+    std::printf("%-56s %12zu %14.1f %12.2f\n", result.name.c_str(), result.iterations,
+                result.ns_per_op, result.allocations_per_op);
+    std::fflush(stdout);
+}
@@ -0,0 +1,91 @@
+#ifndef _UWV_KALMAN_FILTERS_BENCHMARK_HPP_
+#define _UWV_KALMAN_FILTERS_BENCHMARK_HPP_
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace uwv_kalman_filters
+{
+namespace benchmark
+{
+
+/* Number of heap allocations since program start, counted by test/AllocationCounter at the level of malloc,
+ * which includes the allocations of the Eigen types */
+std::size_t allocationCount();
+
+struct Result
+{
+    std::string name;
+    std::size_t iterations;
+    double ns_per_op;
+    double allocations_per_op;
+};
+
+/**
+ * Runs benchmarks and collects their results.
+ *
+ * Each iteration calls setup() untimed, followed by the timed call of operation().
+ * Heap allocations are only counted within operation().
+ */
+class Runner
+{
+public:
+    Runner(double min_time = 0.5, std::size_t min_iterations = 100);
+
+    template<typename Setup, typename Operation>
+    const Result& run(const std::string& name, Setup setup, Operation operation)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        // warm up, buffers are expected to be allocated here
+        for(std::size_t i = 0; i < 10; i++)
+        {
+            setup();
+            operation();
+        }
+
+        Result result;
+        result.name = name;
+        result.iterations = 0;
+        double elapsed_ns = 0.;
+        std::size_t allocations = 0;
+        while(result.iterations < min_iterations || elapsed_ns < min_time * 1e9)
+        {
+            setup();
+            const std::size_t allocations_before = allocationCount();
+            const Clock::time_point start = Clock::now();
+            operation();
+            const Clock::time_point end = Clock::now();
+            allocations += allocationCount() - allocations_before;
+            elapsed_ns += std::chrono::duration<double, std::nano>(end - start).count();
+            result.iterations++;
+        }
+        result.ns_per_op = elapsed_ns / result.iterations;
+        result.allocations_per_op = double(allocations) / result.iterations;
+
+        results.push_back(result);
+        report(result);
+        return results.back();
+    }
+
+    const std::vector<Result>& getResults() const { return results; }
+
+    static void printHeader();
+
+private:
+    static void report(const Result& result);
+
+    double min_time;
+    std::size_t min_iterations;
+    std::vector<Result> results;
+};
+
+/* Empty setup */
+inline void noSetup() {}
+
+}
+}
+
+#endif
@@ -0,0 +1,410 @@
+#include "Scenario.hpp"
+#include <uwv_kalman_filters/EffortModel.hpp>
+#include <pose_estimation/GeographicProjection.hpp>
+#include <pose_estimation/GravitationalModel.hpp>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace uwv_kalman_filters;
+
+/* Velocity of the scenario vehicle in the navigation frame */
+static const Eigen::Vector3d VEHICLE_VELOCITY(1., 0.1, 0.);
+
+static EffortModel::ParameterBlock parameterBlock(const base::Matrix6d& matrix)
+{
+    EffortModel::ParameterBlock block;
+    block << matrix.block<2,2>(0,0), matrix.block<2,1>(0,5);
+    return block;
+}
+
+uwv_dynamic_model::UWVParameters benchmark::vehicleParameters()
+{
+    uwv_dynamic_model::UWVParameters parameters;
+    base::Vector6d inertia;
+    inertia << 120., 160., 160., 15., 25., 25.;
+    parameters.inertia_matrix = inertia.asDiagonal();
+    parameters.damping_matrices.resize(2);
+    base::Vector6d lin_damping;
+    lin_damping << 20., 30., 30., 5., 8., 8.;
+    parameters.damping_matrices[0] = lin_damping.asDiagonal();
+    base::Vector6d quad_damping;
+    quad_damping << 60., 90., 90., 10., 15., 15.;
+    parameters.damping_matrices[1] = quad_damping.asDiagonal();
+    return parameters;
+}
+
+LocationConfiguration benchmark::scenarioLocation()
+{
+    LocationConfiguration location;
+    location.latitude = 0.9325;
+    location.longitude = 0.1552;
+    location.altitude = 0.;
+    return location;
+}
+
+PoseUKF::PoseUKFParameter benchmark::filterParameter()
+{
+    PoseUKF::PoseUKFParameter filter_parameter;
+    filter_parameter.imu_in_body = Eigen::Vector3d(0.1, 0., 0.05);
+    filter_parameter.gyro_bias_tau = 3600.;
+    filter_parameter.acc_bias_tau = 3600.;
+    filter_parameter.inertia_tau = 3600.;
+    filter_parameter.lin_damping_tau = 3600.;
+    filter_parameter.quad_damping_tau = 3600.;
+    filter_parameter.water_velocity_tau = 900.;
+    filter_parameter.water_velocity_limits = 0.5;
+    filter_parameter.water_velocity_scale = 0.001;
+    filter_parameter.adcp_bias_tau = 3600.;
+    return filter_parameter;
+}
+
+boost::shared_ptr<PoseUKF> benchmark::createPoseUKF(unsigned sigma_point_threads, FilterBackend backend,
+                                                    const LocationConfiguration& location)
+{
+    uwv_dynamic_model::UWVParameters model_parameters = vehicleParameters();
+
+    PoseUKF::State state;
+    state.velocity = VEHICLE_VELOCITY;
+    state.gravity(0) = 9.81;
+    state.inertia = parameterBlock(model_parameters.inertia_matrix);
+    state.lin_damping = parameterBlock(model_parameters.damping_matrices[0]);
+    state.quad_damping = parameterBlock(model_parameters.damping_matrices[1]);
+
+    PoseUKF::Covariance state_cov = PoseUKF::Covariance::Zero();
+    MTK::setDiagonal(state_cov, &PoseUKF::State::position, 1.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::orientation, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::acceleration, 1e-1);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_gyro, 1e-8);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_acc, 1e-4);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::gravity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::inertia, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::lin_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::quad_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity_below, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_adcp, 1e-3);
+
+    boost::shared_ptr<PoseUKF> filter(new PoseUKF(state, state_cov, location, model_parameters,
+                                                  filterParameter(), sigma_point_threads));
+    filter->setFilterBackend(backend);
+
+    PoseUKF::Covariance process_noise = PoseUKF::Covariance::Zero();
+    MTK::setDiagonal(process_noise, &PoseUKF::State::position, 1e-4);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::orientation, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::velocity, 1e-4);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::acceleration, 1e-2);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_gyro, 1e-12);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_acc, 1e-8);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::gravity, 1e-8);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::inertia, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::lin_damping, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::quad_damping, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::water_velocity, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::water_velocity_below, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_adcp, 1e-8);
+    filter->setProcessNoiseCovariance(process_noise);
+
+    return filter;
+}
+
+benchmark::ReplayConfiguration benchmark::scenarioConfiguration()
+{
+    ReplayConfiguration configuration;
+    const uwv_dynamic_model::UWVParameters model_parameters = vehicleParameters();
+    configuration.inertia = model_parameters.inertia_matrix.diagonal();
+    configuration.lin_damping = model_parameters.damping_matrices[0].diagonal();
+    configuration.quad_damping = model_parameters.damping_matrices[1].diagonal();
+    configuration.imu_in_body = Eigen::Vector3d(0.1, 0., 0.05);
+    configuration.initial_velocity = VEHICLE_VELOCITY;
+
+    // close to the process noise of createPoseUKF at the IMU rate of the synthetic mission
+    PoseUKFConfig& config = configuration.filter;
+    config.rotation_rate.randomwalk = Eigen::Vector3d::Constant(1e-3);
+    config.rotation_rate.bias_offset = Eigen::Vector3d::Zero();
+    config.rotation_rate.bias_instability = Eigen::Vector3d::Constant(4e-6);
+    config.rotation_rate.bias_tau = 3600.;
+    config.acceleration.randomwalk = Eigen::Vector3d::Constant(1e-2);
+    config.acceleration.bias_offset = Eigen::Vector3d::Zero();
+    config.acceleration.bias_instability = Eigen::Vector3d::Constant(4e-4);
+    config.acceleration.bias_tau = 3600.;
+    config.model_noise_parameters.body_efforts_std = base::Vector6d::Ones();
+    config.model_noise_parameters.inertia_instability = base::Vector6d::Constant(0.13);
+    config.model_noise_parameters.lin_damping_instability = base::Vector6d::Constant(0.13);
+    config.model_noise_parameters.quad_damping_instability = base::Vector6d::Constant(0.13);
+    config.model_noise_parameters.inertia_tau = 3600.;
+    config.model_noise_parameters.lin_damping_tau = 3600.;
+    config.model_noise_parameters.quad_damping_tau = 3600.;
+    config.water_velocity.tau = 900.;
+    config.water_velocity.limits = 2e-3;
+    config.water_velocity.measurement_std = Eigen::Vector3d::Constant(0.05);
+    config.water_velocity.scale = 0.001;
+    config.water_velocity.cell_size = 5.;
+    config.water_velocity.first_cell_blank = 0.;
+    config.water_velocity.minimum_correlation = 0.;
+    config.water_velocity.adcp_bias_tau = 3600.;
+    config.water_velocity.adcp_bias_limits = 4e-4;
+    config.location = scenarioLocation();
+    config.max_jerk = Eigen::Vector3d::Constant(0.1);
+    config.max_effort = base::Vector6d::Constant(100.);
+    config.dynamic_model_min_depth = 0.;
+    return configuration;
+}
+
+namespace
+{
+/* Named field of the replay configuration */
+struct ConfigurationField
+{
+    const char* name;
+    double* values;
+    unsigned size;
+};
+}
+
+void benchmark::loadReplayConfiguration(const std::string& path, ReplayConfiguration& configuration)
+{
+    PoseUKFConfig& config = configuration.filter;
+    const ConfigurationField fields[] = {
+        {"filter.rotation_rate.randomwalk", config.rotation_rate.randomwalk.data(), 3},
+        {"filter.rotation_rate.bias_offset", config.rotation_rate.bias_offset.data(), 3},
+        {"filter.rotation_rate.bias_instability", config.rotation_rate.bias_instability.data(), 3},
+        {"filter.rotation_rate.bias_tau", &config.rotation_rate.bias_tau, 1},
+        {"filter.acceleration.randomwalk", config.acceleration.randomwalk.data(), 3},
+        {"filter.acceleration.bias_offset", config.acceleration.bias_offset.data(), 3},
+        {"filter.acceleration.bias_instability", config.acceleration.bias_instability.data(), 3},
+        {"filter.acceleration.bias_tau", &config.acceleration.bias_tau, 1},
+        {"filter.model_noise_parameters.body_efforts_std", config.model_noise_parameters.body_efforts_std.data(), 6},
+        {"filter.model_noise_parameters.inertia_instability", config.model_noise_parameters.inertia_instability.data(), 6},
+        {"filter.model_noise_parameters.lin_damping_instability", config.model_noise_parameters.lin_damping_instability.data(), 6},
+        {"filter.model_noise_parameters.quad_damping_instability", config.model_noise_parameters.quad_damping_instability.data(), 6},
+        {"filter.model_noise_parameters.inertia_tau", &config.model_noise_parameters.inertia_tau, 1},
+        {"filter.model_noise_parameters.lin_damping_tau", &config.model_noise_parameters.lin_damping_tau, 1},
+        {"filter.model_noise_parameters.quad_damping_tau", &config.model_noise_parameters.quad_damping_tau, 1},
+        {"filter.water_velocity.tau", &config.water_velocity.tau, 1},
+        {"filter.water_velocity.limits", &config.water_velocity.limits, 1},
+        {"filter.water_velocity.measurement_std", config.water_velocity.measurement_std.data(), 3},
+        {"filter.water_velocity.scale", &config.water_velocity.scale, 1},
+        {"filter.water_velocity.cell_size", &config.water_velocity.cell_size, 1},
+        {"filter.water_velocity.first_cell_blank", &config.water_velocity.first_cell_blank, 1},
+        {"filter.water_velocity.minimum_correlation", &config.water_velocity.minimum_correlation, 1},
+        {"filter.water_velocity.adcp_bias_tau", &config.water_velocity.adcp_bias_tau, 1},
+        {"filter.water_velocity.adcp_bias_limits", &config.water_velocity.adcp_bias_limits, 1},
+        {"filter.max_jerk", config.max_jerk.data(), 3},
+        {"filter.max_effort", config.max_effort.data(), 6},
+        {"filter.dynamic_model_min_depth", &config.dynamic_model_min_depth, 1},
+        {"filter.innovation_gates.velocity", &config.innovation_gates.velocity, 1},
+        {"filter.innovation_gates.acceleration", &config.innovation_gates.acceleration, 1},
+        {"filter.innovation_gates.z_position", &config.innovation_gates.z_position, 1},
+        {"filter.innovation_gates.xy_position", &config.innovation_gates.xy_position, 1},
+        {"filter.innovation_gates.geographic_position", &config.innovation_gates.geographic_position, 1},
+        {"filter.innovation_gates.body_efforts", &config.innovation_gates.body_efforts, 1},
+        {"filter.innovation_gates.water_velocity", &config.innovation_gates.water_velocity, 1},
+        {"filter.sigma_points.alpha", &config.sigma_points.alpha, 1},
+        {"filter.sigma_points.beta", &config.sigma_points.beta, 1},
+        {"filter.sigma_points.kappa", &config.sigma_points.kappa, 1},
+        {"filter.sigma_points.center_weight", &config.sigma_points.center_weight, 1},
+        {"vehicle.inertia", configuration.inertia.data(), 6},
+        {"vehicle.lin_damping", configuration.lin_damping.data(), 6},
+        {"vehicle.quad_damping", configuration.quad_damping.data(), 6},
+        {"vehicle.imu_in_body", configuration.imu_in_body.data(), 3},
+        {"vehicle.initial_velocity", configuration.initial_velocity.data(), 3}
+    };
+
+    std::ifstream file(path.c_str());
+    if(!file)
+        throw std::runtime_error("Failed to open replay configuration " + path);
+    std::string line;
+    for(unsigned line_number = 1; std::getline(file, line); line_number++)
+    {
+        std::istringstream stream(line);
+        std::string name;
+        if(!(stream >> name) || name[0] == '#')
+            continue;
+
+        const ConfigurationField* field = NULL;
+        for(unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]) && !field; i++)
+        {
+            if(name == fields[i].name)
+                field = &fields[i];
+        }
+        std::ostringstream location;
+        location << path << ":" << line_number << ": ";
+        if(name == "filter.sigma_points.scheme")
+        {
+            static const char* const scheme_names[] = {"SYMMETRIC_SIGMA_POINTS", "SCALED_UNSCENTED", "SPHERICAL_SIMPLEX", "CUBATURE"};
+            std::string scheme, rest;
+            stream >> scheme;
+            unsigned i = 0;
+            while(i < sizeof(scheme_names) / sizeof(scheme_names[0]) && scheme != scheme_names[i])
+                i++;
+            if(i == sizeof(scheme_names) / sizeof(scheme_names[0]) || stream >> rest)
+                throw std::runtime_error(location.str() + "expected one of SYMMETRIC_SIGMA_POINTS, SCALED_UNSCENTED, SPHERICAL_SIMPLEX and CUBATURE");
+            config.sigma_points.scheme = SigmaPointScheme(i);
+            continue;
+        }
+        if(!field)
+            throw std::runtime_error(location.str() + "unknown field " + name);
+
+        double values[6];
+        unsigned count = 0;
+        double value;
+        while(stream >> value)
+        {
+            if(count == field->size)
+                throw std::runtime_error(location.str() + "too many values of " + name);
+            values[count++] = value;
+        }
+        if(!stream.eof() || count != field->size)
+            throw std::runtime_error(location.str() + "wrong number of values of " + name);
+        std::copy(values, values + count, field->values);
+    }
+}
+
+boost::shared_ptr<PoseUKF> benchmark::createPoseUKF(const ReplayConfiguration& configuration, const LocationConfiguration& location,
+                                                    double imu_delta_t, unsigned sigma_point_threads)
+{
+    uwv_dynamic_model::UWVParameters model_parameters;
+    model_parameters.inertia_matrix = configuration.inertia.asDiagonal();
+    model_parameters.damping_matrices.resize(2);
+    model_parameters.damping_matrices[0] = configuration.lin_damping.asDiagonal();
+    model_parameters.damping_matrices[1] = configuration.quad_damping.asDiagonal();
+
+    const PoseUKFConfig& config = configuration.filter;
+    PoseUKF::State state;
+    state.velocity = configuration.initial_velocity;
+    state.gravity(0) = 9.81;
+    state.bias_gyro = config.rotation_rate.bias_offset;
+    state.bias_acc = config.acceleration.bias_offset;
+    state.inertia = parameterBlock(model_parameters.inertia_matrix);
+    state.lin_damping = parameterBlock(model_parameters.damping_matrices[0]);
+    state.quad_damping = parameterBlock(model_parameters.damping_matrices[1]);
+
+    PoseUKF::Covariance state_cov = PoseUKF::Covariance::Zero();
+    MTK::setDiagonal(state_cov, &PoseUKF::State::position, 1.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::orientation, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::acceleration, 1e-1);
+    MTK::subblock(state_cov, &PoseUKF::State::bias_gyro) = config.rotation_rate.bias_instability.cwiseAbs2().asDiagonal();
+    MTK::subblock(state_cov, &PoseUKF::State::bias_acc) = config.acceleration.bias_instability.cwiseAbs2().asDiagonal();
+    MTK::setDiagonal(state_cov, &PoseUKF::State::gravity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::inertia, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::lin_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::quad_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity_below, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_adcp, 1e-3);
+
+    // the navigation frame of the recorded measurements
+    PoseUKFConfig located_config = config;
+    located_config.location = location;
+    return boost::shared_ptr<PoseUKF>(new PoseUKF(state, state_cov, located_config, model_parameters,
+                                                  configuration.imu_in_body, imu_delta_t, sigma_point_threads));
+}
+
+boost::shared_ptr<VelocityUKF> benchmark::createVelocityUKF(FilterBackend backend)
+{
+    VelocityUKF::State state;
+    state.velocity = Eigen::Vector3d(1., 0.1, 0.);
+    state.z_position(0) = -10.;
+    VelocityUKF::Covariance state_cov = VelocityUKF::Covariance::Identity() * 0.1;
+
+    boost::shared_ptr<VelocityUKF> filter(new VelocityUKF(state, state_cov));
+    filter->setFilterBackend(backend);
+    filter->setupMotionModel(vehicleParameters());
+
+    VelocityUKF::GyroMeasurement gyro;
+    gyro.mu = Eigen::Vector3d(0., 0., 0.05);
+    gyro.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    filter->integrateMeasurement(gyro);
+
+    VelocityUKF::BodyEffortsMeasurement efforts;
+    efforts.mu << 20., 0., 0., 0., 0., 1.;
+    efforts.cov = base::Matrix6d::Identity();
+    filter->integrateMeasurement(efforts);
+
+    return filter;
+}
+
+void benchmark::writeSyntheticMission(const std::string& path, double duration, unsigned seed)
+{
+    const LocationConfiguration location = scenarioLocation();
+    pose_estimation::GeographicProjection projection(location.latitude, location.longitude);
+    uwv_dynamic_model::UWVParameters model_parameters = vehicleParameters();
+    EffortModel effort_model(model_parameters);
+
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal;
+    MissionLogWriter writer(location);
+
+    const int64_t start_time = 1500000000000000LL;
+    const int64_t period = 10000; // IMU period in microseconds
+    const int64_t steps = int64_t(duration * 1e6) / period;
+    for(int64_t step = 0; step <= steps; step++)
+    {
+        const int64_t time = start_time + step * period;
+        const Eigen::Vector3d position = VEHICLE_VELOCITY * (step * period * 1e-6);
+        MissionLogRecord record;
+
+        // the vehicle keeps its orientation, the gyros only sense the earth rotation
+        double latitude, longitude;
+        projection.navToWorld(position.x(), position.y(), latitude, longitude);
+        Eigen::Vector3d rotation_rate(pose_estimation::EARTHW * cos(latitude), 0., pose_estimation::EARTHW * sin(latitude));
+        rotation_rate += 1e-5 * Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+        record.setMeasurement(LOG_ROTATION_RATE, time, rotation_rate, Eigen::Matrix3d::Identity() * 1e-10);
+        writer.add(record);
+
+        Eigen::Vector3d acceleration(0., 0., 9.81);
+        acceleration += 1e-2 * Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+        record.setMeasurement(LOG_ACCELERATION, time, acceleration, Eigen::Matrix3d::Identity() * 1e-4);
+        writer.add(record);
+
+        if(step % 10 == 0)
+        {
+            record.setMeasurement(LOG_REFERENCE_POSITION, time, position, Eigen::Matrix3d::Zero());
+            writer.add(record);
+
+            Eigen::Matrix<double,1,1> z_position(position.z() + 0.01 * normal(generator));
+            record.setMeasurement(LOG_Z_POSITION, time, z_position, Eigen::Matrix<double,1,1>::Constant(1e-4));
+            writer.add(record);
+
+            base::Vector6d velocity_6d;
+            velocity_6d << VEHICLE_VELOCITY, base::Vector3d::Zero();
+            base::Vector6d efforts = effort_model.calcEfforts(parameterBlock(model_parameters.inertia_matrix),
+                                                              parameterBlock(model_parameters.damping_matrices[0]),
+                                                              parameterBlock(model_parameters.damping_matrices[1]),
+                                                              base::Vector6d::Zero(), velocity_6d, base::Orientation::Identity());
+            for(unsigned i = 0; i < 6; i++)
+                efforts[i] += normal(generator);
+            record.setMeasurement(LOG_BODY_EFFORTS, time, efforts, base::Matrix6d::Identity());
+            writer.add(record);
+        }
+
+        if(step % 20 == 0)
+        {
+            Eigen::Vector3d velocity = VEHICLE_VELOCITY + 0.01 * Eigen::Vector3d(normal(generator), normal(generator), normal(generator));
+            record.setMeasurement(LOG_VELOCITY, time, velocity, Eigen::Matrix3d::Identity() * 1e-4);
+            writer.add(record);
+        }
+
+        if(step % 100 == 0)
+        {
+            Eigen::Vector2d geo_position;
+            projection.navToWorld(position.x() + 2. * normal(generator), position.y() + 2. * normal(generator),
+                                  geo_position.x(), geo_position.y());
+            record.setMeasurement(LOG_GEOGRAPHIC_POSITION, time, geo_position, Eigen::Matrix2d::Identity() * 4.);
+            writer.add(record);
+
+            // no water currents, the ADCP senses the vehicle velocity
+            Eigen::Vector2d water_velocity = VEHICLE_VELOCITY.head<2>() + 0.05 * Eigen::Vector2d(normal(generator), normal(generator));
+            record.setMeasurement(LOG_WATER_VELOCITY, time, water_velocity, Eigen::Matrix2d::Identity() * 2.5e-3);
+            record.aux[0] = 0.5;
+            writer.add(record);
+            record.aux[0] = 0.;
+        }
+    }
+    writer.write(path);
+}
@@ -0,0 +1,65 @@
+#ifndef _UWV_KALMAN_FILTERS_BENCHMARK_SCENARIO_HPP_
+#define _UWV_KALMAN_FILTERS_BENCHMARK_SCENARIO_HPP_
+
+#include <uwv_kalman_filters/PoseUKF.hpp>
+#include <uwv_kalman_filters/VelocityUKF.hpp>
+#include <uwv_kalman_filters/MissionLog.hpp>
+#include <boost/shared_ptr.hpp>
+#include <string>
+
+namespace uwv_kalman_filters
+{
+namespace benchmark
+{
+
+/* Motion model parameters of a medium sized AUV */
+uwv_dynamic_model::UWVParameters vehicleParameters();
+
+/* Origin of the navigation frame of the scenario */
+LocationConfiguration scenarioLocation();
+
+/* Time constants and IMU placement of the filters of the scenario */
+PoseUKF::PoseUKFParameter filterParameter();
+
+/* PoseUKF with the state sizes and noise parameters of a typical mission */
+boost::shared_ptr<PoseUKF> createPoseUKF(unsigned sigma_point_threads = 1, FilterBackend backend = STANDARD_UKF,
+                                         const LocationConfiguration& location = scenarioLocation());
+
+/* Writes a mission log of a vehicle moving with constant velocity near the surface.
+ * It contains IMU (100Hz), DVL (5Hz), pressure (10Hz), GPS (1Hz), ADCP (1Hz) and
+ * thruster effort (10Hz) measurements with white noise and reference positions (10Hz) */
+void writeSyntheticMission(const std::string& path, double duration, unsigned seed = 42);
+
+/* Configuration of a replayed vehicle, see loadReplayConfiguration */
+struct ReplayConfiguration
+{
+    PoseUKFConfig filter;
+    /* Diagonals of the inertia and damping matrices of the motion model */
+    base::Vector6d inertia;
+    base::Vector6d lin_damping;
+    base::Vector6d quad_damping;
+    Eigen::Vector3d imu_in_body;
+    /* Velocity of the initial state in the navigation frame */
+    Eigen::Vector3d initial_velocity;
+};
+
+/* Configuration of the scenario vehicle */
+ReplayConfiguration scenarioConfiguration();
+
+/* Overrides the fields given in the file. Each line holds the name of a field followed by its values,
+ * e.g. "filter.acceleration.randomwalk 0.01 0.01 0.01", lines starting with # are ignored.
+ * Throws std::runtime_error if the file can't be read, on unknown fields and on a wrong number of values */
+void loadReplayConfiguration(const std::string& path, ReplayConfiguration& configuration);
+
+/* PoseUKF of the configuration, the origin of the navigation frame is given by location.
+ * imu_delta_t is the period of the inertial measurements in seconds */
+boost::shared_ptr<PoseUKF> createPoseUKF(const ReplayConfiguration& configuration, const LocationConfiguration& location,
+                                         double imu_delta_t, unsigned sigma_point_threads = 1);
+
+/* VelocityUKF with an initialized motion model */
+boost::shared_ptr<VelocityUKF> createVelocityUKF(FilterBackend backend = STANDARD_UKF);
+
+}
+}
+
+#endif
@@ -0,0 +1,256 @@
+#include "Benchmark.hpp"
+#include "Scenario.hpp"
+#include <uwv_kalman_filters/VehicleFleet.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace uwv_kalman_filters;
+using namespace uwv_kalman_filters::benchmark;
+
+/* Prediction rate of the IMU driven filters */
+static const double IMU_PERIOD = 0.01;
+/* Valid cells of a typical ADCP ping */
+static const unsigned ADCP_CELLS = 30;
+
+struct PoseMeasurements
+{
+    PoseUKF::GeographicPosition geographic_position;
+    PoseUKF::XY_Position xy_position;
+    PoseUKF::Z_Position z_position;
+    PoseUKF::RotationRate rotation_rate;
+    PoseUKF::Acceleration acceleration;
+    PoseUKF::Velocity velocity;
+    PoseUKF::BodyEffortsMeasurement body_efforts;
+    PoseUKF::WaterVelocityMeasurement water_velocity;
+    PoseUKF::WaterVelocityProfile water_velocity_profile;
+
+    PoseMeasurements()
+    {
+        geographic_position.mu << 0.9325, 0.1552;
+        geographic_position.cov = Eigen::Matrix2d::Identity() * 4.;
+        xy_position.mu << 0.5, 0.1;
+        xy_position.cov = Eigen::Matrix2d::Identity();
+        z_position.mu << -10.;
+        z_position.cov << 0.01;
+        rotation_rate.mu << 0., 0., 0.05;
+        rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+        acceleration.mu << 0.05, 0., 9.81;
+        acceleration.cov = Eigen::Matrix3d::Identity() * 1e-3;
+        velocity.mu << 1., 0.1, 0.;
+        velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+        body_efforts.mu << 20., 0., 0., 0., 0., 1.;
+        body_efforts.cov = base::Matrix6d::Identity();
+        water_velocity.mu << 0.9, 0.1;
+        water_velocity.cov = Eigen::Matrix2d::Identity() * 1e-2;
+        for(unsigned i = 0; i < ADCP_CELLS; i++)
+            water_velocity_profile.addCell(water_velocity.mu, water_velocity.cov, double(i) / ADCP_CELLS);
+    }
+};
+
+/* Keeps the filter in a steady state by predicting between the timed operations */
+struct PredictSetup
+{
+    const boost::shared_ptr<PoseUKF>& filter;
+    PredictSetup(const boost::shared_ptr<PoseUKF>& filter) : filter(filter) {}
+    void operator()() const { filter->predictionStep(IMU_PERIOD); }
+};
+
+static void benchmarkPoseUKF(Runner& runner, const std::string& prefix, unsigned threads, FilterBackend backend,
+                             bool structured_prediction = false, SigmaPointScheme scheme = SYMMETRIC_SIGMA_POINTS,
+                             PoseUKF::PropagationPrecision precision = PoseUKF::DOUBLE_PRECISION)
+{
+    const PoseMeasurements m;
+    boost::shared_ptr<PoseUKF> filter;
+    // every case starts from a fresh filter, the states a case leaves unobserved would otherwise
+    // accumulate over the long runs until the covariance of the following cases is ill-conditioned
+    auto reset = [&]()
+    {
+        filter = createPoseUKF(threads, backend);
+        filter->setStructuredPrediction(structured_prediction);
+        filter->setPropagationPrecision(precision);
+        SigmaPointParameters sigma_points;
+        sigma_points.scheme = scheme;
+        filter->setSigmaPointScheme(sigma_points);
+        filter->integrateMeasurement(m.rotation_rate);
+    };
+    auto run = [&](const std::string& name, std::function<void()> setup, std::function<void()> operation)
+    {
+        reset();
+        runner.run(prefix + name, setup, operation);
+    };
+    PredictSetup predict(filter);
+
+    run("predictionStep", noSetup, [&]() { filter->predictionStep(IMU_PERIOD); });
+    run("GeographicPosition", predict, [&]() { filter->integrateMeasurement(m.geographic_position); });
+    run("XY_Position", predict, [&]() { filter->integrateMeasurement(m.xy_position); });
+    run("Z_Position", predict, [&]() { filter->integrateMeasurement(m.z_position); });
+    run("RotationRate", predict, [&]() { filter->integrateMeasurement(m.rotation_rate); });
+    run("Acceleration", predict, [&]() { filter->integrateMeasurement(m.acceleration); });
+    run("Velocity", predict, [&]() { filter->integrateMeasurement(m.velocity); });
+    run("BodyEfforts", predict, [&]() { filter->integrateMeasurement(m.body_efforts, false); });
+    run("BodyEfforts only_affect_velocity", predict, [&]() { filter->integrateMeasurement(m.body_efforts, true); });
+    run("WaterVelocityMeasurement", predict, [&]() { filter->integrateMeasurement(m.water_velocity, 0.5); });
+    run("WaterVelocityMeasurement x30 cells", predict, [&]()
+    {
+        for(unsigned i = 0; i < ADCP_CELLS; i++)
+            filter->integrateMeasurement(m.water_velocity, double(i) / ADCP_CELLS);
+    });
+    run("WaterVelocityProfile 30 cells", predict, [&]() { filter->integrateMeasurement(m.water_velocity_profile); });
+    run("batch Velocity+Acceleration+Z_Position", predict, [&]()
+    {
+        filter->beginUpdate();
+        filter->integrateMeasurement(m.velocity);
+        filter->integrateMeasurement(m.acceleration);
+        filter->integrateMeasurement(m.z_position);
+        filter->commitUpdate();
+    });
+}
+
+static void benchmarkVelocityUKF(Runner& runner, const std::string& prefix, FilterBackend backend,
+                                 VelocityUKF::PredictionMode mode = VelocityUKF::MODEL_SIMULATION)
+{
+    boost::shared_ptr<VelocityUKF> filter_ptr = createVelocityUKF(backend);
+    VelocityUKF& filter = *filter_ptr;
+    filter.setPredictionMode(mode);
+
+    VelocityUKF::DVLMeasurement dvl;
+    dvl.mu << 1., 0.1, 0.;
+    dvl.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    VelocityUKF::PressureMeasurement pressure;
+    pressure.mu << -10.;
+    pressure.cov << 0.01;
+
+    runner.run(prefix + "predictionStep", noSetup, [&]() { filter.predictionStep(IMU_PERIOD); });
+    runner.run(prefix + "DVLMeasurement", [&]() { filter.predictionStep(IMU_PERIOD); },
+               [&]() { filter.integrateMeasurement(dvl); });
+    runner.run(prefix + "PressureMeasurement", [&]() { filter.predictionStep(IMU_PERIOD); },
+               [&]() { filter.integrateMeasurement(pressure); });
+}
+
+/* Advances a fleet of vehicles of one class, each with a PoseUKF and a VelocityUKF, in one call */
+static void benchmarkVehicleFleet(Runner& runner, const std::string& prefix, unsigned vehicles, unsigned threads,
+                                  PoseUKF::PropagationPrecision precision = PoseUKF::DOUBLE_PRECISION)
+{
+    VehicleFleet fleet(threads);
+    VehicleClass vehicle_class;
+    vehicle_class.location = scenarioLocation();
+    vehicle_class.model_parameters = vehicleParameters();
+    vehicle_class.filter_parameter = filterParameter();
+    const unsigned class_index = fleet.addVehicleClass(vehicle_class);
+
+    // the vehicles start in the state of the scenario filters
+    const boost::shared_ptr<PoseUKF> pose_prototype = createPoseUKF();
+    const boost::shared_ptr<VelocityUKF> velocity_prototype = createVelocityUKF();
+    PoseUKF::State pose_state;
+    PoseUKF::Covariance pose_cov;
+    pose_prototype->getCurrentState(pose_state, pose_cov);
+    VelocityUKF::State velocity_state;
+    VelocityUKF::Covariance velocity_cov;
+    velocity_prototype->getCurrentState(velocity_state, velocity_cov);
+
+    const PoseMeasurements m;
+    std::vector<FleetRecord> records(2 * vehicles);
+    for(unsigned i = 0; i < vehicles; i++)
+    {
+        const unsigned vehicle = fleet.createVehicle(class_index, pose_state, pose_cov);
+        fleet.getPoseFilter(vehicle)->setProcessNoiseCovariance(pose_prototype->getProcessNoiseCovariance());
+        fleet.getPoseFilter(vehicle)->setPropagationPrecision(precision);
+        fleet.getPoseFilter(vehicle)->integrateMeasurement(m.rotation_rate);
+        fleet.createVelocityFilter(vehicle, velocity_state, velocity_cov);
+        records[2 * i].vehicle = records[2 * i + 1].vehicle = vehicle;
+        records[2 * i].record.setMeasurement(LOG_VELOCITY, 0, m.velocity.mu, m.velocity.cov);
+        records[2 * i + 1].record.setMeasurement(LOG_BODY_EFFORTS, 0, m.body_efforts.mu, m.body_efforts.cov);
+    }
+    std::vector<FleetRecord> velocity_records;
+    for(unsigned i = 0; i < vehicles; i++)
+        velocity_records.push_back(records[2 * i]);
+
+    runner.run(prefix + "predictionStep", noSetup, [&]() { fleet.predictionStep(IMU_PERIOD); });
+    runner.run(prefix + "Velocity", [&]() { fleet.predictionStep(IMU_PERIOD); }, [&]() { fleet.integrateRecords(velocity_records); });
+    runner.run(prefix + "Velocity_BodyEfforts", [&]() { fleet.predictionStep(IMU_PERIOD); }, [&]() { fleet.integrateRecords(records); });
+}
+
+/* Runs a filter with single precision propagation next to the double precision one on the same
+ * measurements and prints the largest deviation of the estimate */
+static void compareSinglePrecision(double duration)
+{
+    boost::shared_ptr<PoseUKF> reference = createPoseUKF();
+    boost::shared_ptr<PoseUKF> single = createPoseUKF();
+    single->setPropagationPrecision(PoseUKF::SINGLE_PRECISION);
+    const PoseMeasurements m;
+    reference->integrateMeasurement(m.rotation_rate);
+    single->integrateMeasurement(m.rotation_rate);
+
+    double max_position_error = 0.;
+    double max_orientation_error = 0.;
+    double max_cov_error = 0.;
+    const unsigned steps = unsigned(duration / IMU_PERIOD);
+    for(unsigned i = 0; i < steps; i++)
+    {
+        reference->predictionStep(IMU_PERIOD);
+        single->predictionStep(IMU_PERIOD);
+        reference->integrateMeasurement(m.acceleration);
+        single->integrateMeasurement(m.acceleration);
+        if(i % 10 == 0)
+        {
+            reference->integrateMeasurement(m.velocity);
+            single->integrateMeasurement(m.velocity);
+            reference->integrateMeasurement(m.z_position);
+            single->integrateMeasurement(m.z_position);
+        }
+
+        PoseUKF::State a, b;
+        PoseUKF::Covariance a_cov, b_cov;
+        reference->getCurrentState(a, a_cov);
+        single->getCurrentState(b, b_cov);
+        max_position_error = std::max(max_position_error, (Eigen::Vector3d(a.position) - Eigen::Vector3d(b.position)).norm());
+        max_orientation_error = std::max(max_orientation_error, Eigen::AngleAxisd(a.orientation.inverse() * b.orientation).angle());
+        max_cov_error = std::max(max_cov_error, (a_cov - b_cov).cwiseAbs().maxCoeff() / a_cov.cwiseAbs().maxCoeff());
+    }
+
+    std::printf("\nsingle precision propagation over %.0fs: max position deviation %.3e m, "
+                "max orientation deviation %.3e rad, max relative covariance deviation %.3e\n",
+                duration, max_position_error, max_orientation_error, max_cov_error);
+}
+
+int main(int argc, char** argv)
+{
+    // minimal time in seconds spent per benchmark
+    double min_time = argc > 1 ? std::atof(argv[1]) : 0.5;
+    Runner runner(min_time);
+    Runner::printHeader();
+
+    benchmarkPoseUKF(runner, "PoseUKF/", 1, STANDARD_UKF);
+    benchmarkPoseUKF(runner, "PoseUKF/square_root/", 1, SQUARE_ROOT_UKF);
+    benchmarkPoseUKF(runner, "PoseUKF/structured/", 1, STANDARD_UKF, true);
+    benchmarkPoseUKF(runner, "PoseUKF/spherical_simplex/", 1, STANDARD_UKF, false, SPHERICAL_SIMPLEX);
+    benchmarkPoseUKF(runner, "PoseUKF/cubature/", 1, STANDARD_UKF, false, CUBATURE);
+    benchmarkPoseUKF(runner, "PoseUKF/single_precision/", 1, STANDARD_UKF, false, SYMMETRIC_SIGMA_POINTS, PoseUKF::SINGLE_PRECISION);
+    unsigned threads = std::thread::hardware_concurrency();
+    if(threads > 1)
+    {
+        char prefix[64];
+        std::snprintf(prefix, sizeof(prefix), "PoseUKF/threads_%u/", threads);
+        benchmarkPoseUKF(runner, prefix, threads, STANDARD_UKF);
+    }
+    benchmarkVehicleFleet(runner, "VehicleFleet/50_vehicles/", 50, 1);
+    benchmarkVehicleFleet(runner, "VehicleFleet/50_vehicles/single_precision/", 50, 1, PoseUKF::SINGLE_PRECISION);
+    if(threads > 1)
+    {
+        char prefix[64];
+        std::snprintf(prefix, sizeof(prefix), "VehicleFleet/50_vehicles_threads_%u/", threads);
+        benchmarkVehicleFleet(runner, prefix, 50, threads);
+    }
+
+    benchmarkVelocityUKF(runner, "VelocityUKF/", STANDARD_UKF);
+    benchmarkVelocityUKF(runner, "VelocityUKF/square_root/", SQUARE_ROOT_UKF);
+    benchmarkVelocityUKF(runner, "VelocityUKF/euler_step/", STANDARD_UKF, VelocityUKF::EULER_STEP);
+    benchmarkVelocityUKF(runner, "VelocityUKF/runge_kutta_step/", STANDARD_UKF, VelocityUKF::RUNGE_KUTTA_STEP);
+
+    compareSinglePrecision(600.);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "Scenario.hpp"
+#include <uwv_kalman_filters/MissionReplay.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace uwv_kalman_filters;
+
+static void usage()
+{
+    std::fprintf(stderr, "usage: uwv_kalman_filters_replay <log> [--config <file>] [max_prediction_step] [sigma_point_threads]\n"
+                         "       uwv_kalman_filters_replay --synthesize <log> <duration>\n"
+                         "The configuration file overrides fields of the scenario configuration, see benchmarks/Scenario.hpp\n");
+}
+
+/* Period of the first two rotation rate records */
+static double imuPeriod(const MissionLog& log)
+{
+    const MissionLogRecord* previous = NULL;
+    for(const MissionLogRecord* record = log.begin(); record != log.end(); record++)
+    {
+        if(record->type != LOG_ROTATION_RATE)
+            continue;
+        if(previous && record->time > previous->time)
+            return (record->time - previous->time) * 1e-6;
+        previous = record;
+    }
+    throw std::runtime_error("The log contains less than two rotation rate records");
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        if(std::strcmp(argv[1], "--synthesize") == 0)
+        {
+            if(argc < 4)
+            {
+                usage();
+                return 1;
+            }
+            benchmark::writeSyntheticMission(argv[2], std::atof(argv[3]));
+            return 0;
+        }
+
+        benchmark::ReplayConfiguration configuration = benchmark::scenarioConfiguration();
+        std::vector<const char*> arguments;
+        for(int i = 2; i < argc; i++)
+        {
+            if(std::strcmp(argv[i], "--config") == 0)
+            {
+                if(++i == argc)
+                {
+                    usage();
+                    return 1;
+                }
+                benchmark::loadReplayConfiguration(argv[i], configuration);
+            }
+            else
+                arguments.push_back(argv[i]);
+        }
+
+        MissionLog log(argv[1]);
+        unsigned threads = arguments.size() > 1 ? std::atoi(arguments[1]) : 1;
+        // the origin is taken from the log
+        boost::shared_ptr<PoseUKF> filter = benchmark::createPoseUKF(configuration, log.getLocation(), imuPeriod(log), threads);
+
+        MissionReplay replay(*filter);
+        if(!arguments.empty())
+            replay.setMaxPredictionStep(std::atof(arguments[0]));
+        replay.replay(log).print(stdout);
+    }
+    catch(const std::exception& e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
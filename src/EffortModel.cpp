@@ -0,0 +1,141 @@
+#include "EffortModel.hpp"
+#include <uwv_dynamic_model/DynamicModel.hpp>
+#include <algorithm>
+
+using namespace uwv_kalman_filters;
+
+EffortModel::EffortModel(const uwv_dynamic_model::UWVParameters& model_parameters) :
+    dynamic_model(new uwv_dynamic_model::DynamicModel()), parameters_applied(false)
+{
+    setUWVParameters(model_parameters);
+}
+
+void EffortModel::setUWVParameters(const uwv_dynamic_model::UWVParameters& model_parameters)
+{
+    nominal_parameters = model_parameters;
+    parameters = model_parameters;
+    dynamic_model->setUWVParameters(parameters);
+    parameters_applied = false;
+}
+
+const uwv_dynamic_model::UWVParameters& EffortModel::getUWVParameters() const
+{
+    return nominal_parameters;
+}
+
+const uwv_dynamic_model::UWVParameters& EffortModel::getAppliedParameters() const
+{
+    return parameters;
+}
+
+base::Vector6d EffortModel::calcEfforts(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                                        const ParameterBlock& quad_damping, const base::Vector6d& acceleration,
+                                        const base::Vector6d& velocity, const base::Orientation& orientation)
+{
+    applyParameters(inertia, lin_damping, quad_damping);
+    return dynamic_model->calcEfforts(acceleration, velocity, orientation);
+}
+
+void EffortModel::applyParameters(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                                  const ParameterBlock& quad_damping)
+{
+    // the motion model only needs to be updated if the parameters have changed
+    if(parameters_applied && inertia == applied_inertia &&
+        lin_damping == applied_lin_damping && quad_damping == applied_quad_damping)
+        return;
+
+    parameters.inertia_matrix.block(0,0,2,2) = inertia.block(0,0,2,2).cwiseAbs();
+    parameters.inertia_matrix.block(0,5,2,1) = inertia.block(0,2,2,1).cwiseAbs();
+    parameters.damping_matrices[0].block(0,0,2,2) = lin_damping.block(0,0,2,2).cwiseAbs();
+    parameters.damping_matrices[0].block(0,5,2,1) = lin_damping.block(0,2,2,1).cwiseAbs();
+    parameters.damping_matrices[1].block(0,0,2,2) = quad_damping.block(0,0,2,2).cwiseAbs();
+    parameters.damping_matrices[1].block(0,5,2,1) = quad_damping.block(0,2,2,1).cwiseAbs();
+    dynamic_model->setUWVParameters(parameters);
+
+    applied_inertia = inertia;
+    applied_lin_damping = lin_damping;
+    applied_quad_damping = quad_damping;
+    parameters_applied = true;
+}
+
+/* Relative change of a parameter block, with respect to the larger of its magnitude and one */
+static double relativeChange(const EffortModel::ParameterBlock& a, const EffortModel::ParameterBlock& b)
+{
+    return (a - b).cwiseAbs().maxCoeff() / std::max(1., b.cwiseAbs().maxCoeff());
+}
+
+EffortContext::EffortContext() : tolerance(1e-3), assembled(false), separable(false), valid(false)
+{
+}
+
+void EffortContext::setTolerance(double tolerance)
+{
+    this->tolerance = tolerance;
+    assembled = false;
+}
+
+bool EffortContext::requiresAssembly(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                                     const ParameterBlock& quad_damping) const
+{
+    if(!assembled)
+        return true;
+    if(tolerance <= 0.)
+        return inertia != this->inertia || lin_damping != lin_damping_parameters || quad_damping != quad_damping_parameters;
+    return relativeChange(inertia, this->inertia) > tolerance ||
+           relativeChange(lin_damping, lin_damping_parameters) > tolerance ||
+           relativeChange(quad_damping, quad_damping_parameters) > tolerance;
+}
+
+bool EffortContext::update(EffortModel& effort_model, const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                           const ParameterBlock& quad_damping, const base::Vector6d& acceleration,
+                           const base::Orientation& orientation)
+{
+    this->acceleration = acceleration;
+    this->orientation = orientation;
+
+    if(requiresAssembly(inertia, lin_damping, quad_damping))
+    {
+        this->inertia = inertia;
+        lin_damping_parameters = lin_damping;
+        quad_damping_parameters = quad_damping;
+        effort_model.calcEfforts(inertia, lin_damping, quad_damping, acceleration, base::Vector6d::Zero(), orientation);
+        const uwv_dynamic_model::UWVParameters& parameters = effort_model.getAppliedParameters();
+        this->lin_damping = parameters.damping_matrices[0];
+        this->quad_damping = parameters.damping_matrices[1];
+        assembled = true;
+        separable = validate(effort_model);
+    }
+    else if(!separable)
+    {
+        // the full model is evaluated anyway, so it uses the current parameters
+        this->inertia = inertia;
+        lin_damping_parameters = lin_damping;
+        quad_damping_parameters = quad_damping;
+    }
+
+    if(separable)
+        constant = effort_model.calcEfforts(this->inertia, lin_damping_parameters, quad_damping_parameters,
+                                            acceleration, base::Vector6d::Zero(), orientation);
+    valid = separable;
+    return valid;
+}
+
+bool EffortContext::validate(EffortModel& effort_model)
+{
+    const base::Vector6d efforts_at_rest = effort_model.calcEfforts(inertia, lin_damping_parameters, quad_damping_parameters,
+                                                                    acceleration, base::Vector6d::Zero(), orientation);
+    // two velocities of different magnitude and sign separate the linear from the quadratic terms
+    base::Vector6d test_velocities[2];
+    test_velocities[0] << 1.3, -0.4, 0.25, 0.1, -0.07, 0.2;
+    test_velocities[1] = -2.1 * test_velocities[0];
+    for(unsigned i = 0; i < 2; i++)
+    {
+        const base::Vector6d& v = test_velocities[i];
+        const base::Vector6d expected = effort_model.calcEfforts(inertia, lin_damping_parameters, quad_damping_parameters,
+                                                                 acceleration, v, orientation);
+        const base::Vector6d separated = efforts_at_rest + lin_damping * v + quad_damping * v.cwiseAbs().cwiseProduct(v);
+        if(!((expected - separated).norm() <= 1e-9 * (1. + expected.norm())))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+#ifndef _UWV_KALMAN_FILTERS_EFFORT_MODEL_HPP_
+#define _UWV_KALMAN_FILTERS_EFFORT_MODEL_HPP_
+
+#include <base/Eigen.hpp>
+#include <boost/shared_ptr.hpp>
+#include <uwv_dynamic_model/DataTypes.hpp>
+
+namespace uwv_dynamic_model
+{
+    class DynamicModel;
+}
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Evaluates the expected body efforts of the AUV motion model given a set of
+ * estimated inertia and damping parameters.
+ *
+ * The estimated parameters are the [x, xy, xψ; yx, y, yψ] components as they are
+ * represented in the PoseState. They are patched into a private, pre-allocated copy
+ * of the UWV parameters, which is only handed to the private motion model if
+ * they differ from the last evaluation. No memory is allocated per evaluation.
+ *
+ * NOTE: An instance must not be shared between threads, concurrent evaluations
+ * require one instance per thread.
+ */
+class EffortModel
+{
+public:
+    typedef Eigen::Matrix<double, 2, 3> ParameterBlock;
+
+    EffortModel(const uwv_dynamic_model::UWVParameters& model_parameters);
+
+    /* Sets the nominal model parameters */
+    void setUWVParameters(const uwv_dynamic_model::UWVParameters& model_parameters);
+
+    /* Returns the nominal model parameters */
+    const uwv_dynamic_model::UWVParameters& getUWVParameters() const;
+
+    /* Returns the model parameters including the estimated parameters of the last evaluation */
+    const uwv_dynamic_model::UWVParameters& getAppliedParameters() const;
+
+    /* Expected forces and torques in the body frame given the estimated inertia and damping parameters */
+    base::Vector6d calcEfforts(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                               const ParameterBlock& quad_damping, const base::Vector6d& acceleration,
+                               const base::Vector6d& velocity, const base::Orientation& orientation);
+
+protected:
+    void applyParameters(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                         const ParameterBlock& quad_damping);
+
+    boost::shared_ptr<uwv_dynamic_model::DynamicModel> dynamic_model;
+    uwv_dynamic_model::UWVParameters nominal_parameters;
+    uwv_dynamic_model::UWVParameters parameters;
+    ParameterBlock applied_inertia;
+    ParameterBlock applied_lin_damping;
+    ParameterBlock applied_quad_damping;
+    bool parameters_applied;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Precomputed motion model for a fixed set of parameters, acceleration and orientation.
+ *
+ * The expected efforts are represented as constant + D_lin * v + D_quad * |v| .* v, with
+ * the constant part evaluated at zero velocity and the assembled damping matrices.
+ * Whether the motion model can be represented this way is validated against the full model
+ * each time the context is assembled; if not, calcEfforts evaluates the full model instead.
+ * The context is only assembled again if the inertia or damping parameters moved by more
+ * than the relative tolerance since the last assembly.
+ *
+ * After update the context is read-only and can be shared between threads.
+ */
+class EffortContext
+{
+public:
+    typedef EffortModel::ParameterBlock ParameterBlock;
+
+    EffortContext();
+
+    /* Relative change of the inertia and damping parameters which requires to assemble the context again.
+     * With a tolerance of zero it is assembled with every change. The default is 1e-3 */
+    void setTolerance(double tolerance);
+
+    /* Prepares the context, returns true if the fast representation is valid */
+    bool update(EffortModel& effort_model, const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                const ParameterBlock& quad_damping, const base::Vector6d& acceleration,
+                const base::Orientation& orientation);
+
+    /* True if calcEfforts doesn't require the full motion model */
+    bool isValid() const { return valid; }
+
+    /* Expected forces and torques at the given velocity,
+     * the effort model is only used if the fast representation is not valid */
+    base::Vector6d calcEfforts(EffortModel& effort_model, const base::Vector6d& velocity) const
+    {
+        if(valid)
+            return constant + lin_damping * velocity + quad_damping * velocity.cwiseAbs().cwiseProduct(velocity);
+        return effort_model.calcEfforts(inertia, lin_damping_parameters, quad_damping_parameters, acceleration, velocity, orientation);
+    }
+
+protected:
+    bool requiresAssembly(const ParameterBlock& inertia, const ParameterBlock& lin_damping,
+                          const ParameterBlock& quad_damping) const;
+    bool validate(EffortModel& effort_model);
+
+    double tolerance;
+    bool assembled;
+    bool separable;
+    bool valid;
+    ParameterBlock inertia;
+    ParameterBlock lin_damping_parameters;
+    ParameterBlock quad_damping_parameters;
+    base::Vector6d acceleration;
+    base::Orientation orientation;
+    base::Matrix6d lin_damping;
+    base::Matrix6d quad_damping;
+    base::Vector6d constant;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "FilterInstrumentation.hpp"
+#include <stdexcept>
+
+using namespace uwv_kalman_filters;
+
+FilterInstrumentation::FilterInstrumentation(const char* const* channel_names, unsigned channel_count) :
+    channel_names(channel_names), channel_count(channel_count), recorded_innovation(0)
+{
+    if(channel_count > MAX_CHANNELS)
+        throw std::invalid_argument("Too many instrumentation channels");
+}
+
+FilterStatistics FilterInstrumentation::getStatistics() const
+{
+    FilterStatistics statistics;
+#ifdef UWV_KALMAN_FILTERS_INSTRUMENTATION
+    statistics.enabled = true;
+#endif
+    statistics.channels.resize(channel_count);
+    for(unsigned i = 0; i < channel_count; i++)
+    {
+        const Channel& c = channels[i];
+        ChannelStatistics& s = statistics.channels[i];
+        s.name = channel_names[i];
+        s.calls = c.calls.get();
+        s.time = 1e-9 * c.time.get();
+        s.max_time = 1e-9 * c.max_time.get();
+        s.innovations = c.innovations.get();
+        s.rejections = c.rejections.get();
+        s.nis_sum = c.nis_sum.get();
+        s.last_nis = c.last_nis.get();
+    }
+    statistics.sigma_point_batches = timer_calls[SIGMA_POINT_BATCH].get();
+    statistics.sigma_point_time = 1e-9 * timer_time[SIGMA_POINT_BATCH].get();
+    statistics.factorizations = timer_calls[FACTORIZATION].get();
+    statistics.factorization_time = 1e-9 * timer_time[FACTORIZATION].get();
+    return statistics;
+}
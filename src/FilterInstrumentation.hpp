@@ -0,0 +1,213 @@
+#ifndef _UWV_KALMAN_FILTERS_FILTER_INSTRUMENTATION_HPP_
+#define _UWV_KALMAN_FILTERS_FILTER_INSTRUMENTATION_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace uwv_kalman_filters
+{
+
+/* Statistics of one instrumented call of a filter */
+struct ChannelStatistics
+{
+    std::string name;
+    uint64_t calls;
+    /* Accumulated and maximum wall time of a call in seconds, nested calls included */
+    double time;
+    double max_time;
+    /* Number of evaluated innovations and the ones rejected by the gate */
+    uint64_t innovations;
+    uint64_t rejections;
+    /* Sum and last value of the normalized innovation squared */
+    double nis_sum;
+    double last_nis;
+
+    ChannelStatistics() : calls(0), time(0.), max_time(0.), innovations(0), rejections(0), nis_sum(0.), last_nis(0.) {}
+};
+
+/* Snapshot of the counters of a filter instance */
+struct FilterStatistics
+{
+    /* False if the library was built without instrumentation, all counters are zero then */
+    bool enabled;
+    std::vector<ChannelStatistics> channels;
+    /* Batches of process or measurement model evaluations, one per predict or update evaluating all its sigma points */
+    uint64_t sigma_point_batches;
+    double sigma_point_time;
+    /* Cholesky and QR decompositions of the state covariance */
+    uint64_t factorizations;
+    double factorization_time;
+
+    FilterStatistics() : enabled(false), sigma_point_batches(0), sigma_point_time(0.), factorizations(0), factorization_time(0.) {}
+};
+
+/**
+ * Per-instance counters of the hot paths of a filter.
+ *
+ * The counters are only written by the thread running the filter and can be read
+ * concurrently by getStatistics, e.g. to publish them at a low rate. Each counter
+ * is a relaxed atomic, a snapshot taken during an update might therefore mix
+ * values from before and after it. The counters are never reset, consumers
+ * take the difference of consecutive snapshots.
+ *
+ * Recording is only compiled in if UWV_KALMAN_FILTERS_INSTRUMENTATION is defined
+ * (CMake option ENABLE_INSTRUMENTATION, which exports the definition to the users of the
+ * library and its pkg-config file). Otherwise the scopes are empty and the
+ * layout of the classes is unchanged.
+ */
+class FilterInstrumentation
+{
+public:
+    enum { MAX_CHANNELS = 16 };
+    enum Timer { SIGMA_POINT_BATCH, FACTORIZATION, TIMER_COUNT };
+
+    /* The names must stay valid for the lifetime of the instance */
+    FilterInstrumentation(const char* const* channel_names, unsigned channel_count);
+
+    void recordCall(unsigned channel, uint64_t nanoseconds)
+    {
+        Channel& c = channels[channel];
+        c.calls.add(1);
+        c.time.add(nanoseconds);
+        c.max_time.max(nanoseconds);
+    }
+
+    void recordInnovation(unsigned channel, double nis, bool accepted)
+    {
+        Channel& c = channels[channel];
+        c.innovations.add(1);
+        if(!accepted)
+            c.rejections.add(1);
+        c.nis_sum.add(nis);
+        c.last_nis.set(nis);
+    }
+
+    void recordTime(Timer timer, uint64_t nanoseconds)
+    {
+        timer_calls[timer].add(1);
+        timer_time[timer].add(nanoseconds);
+    }
+
+    FilterStatistics getStatistics() const;
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /* Times a scope with one of the timers */
+    class ScopedTimer;
+
+    /* Times a call of a channel and records the innovation if one was evaluated during the call.
+     * Of nested calls the innermost one records the innovation */
+    template<typename Innovation>
+    class CallScope;
+
+protected:
+    /* Counter which is only modified by a single thread */
+    template<typename T>
+    class Counter
+    {
+    public:
+        Counter() : value(T()) {}
+        void add(T v) { value.store(value.load(std::memory_order_relaxed) + v, std::memory_order_relaxed); }
+        void max(T v) { if(v > value.load(std::memory_order_relaxed)) value.store(v, std::memory_order_relaxed); }
+        void set(T v) { value.store(v, std::memory_order_relaxed); }
+        T get() const { return value.load(std::memory_order_relaxed); }
+    private:
+        std::atomic<T> value;
+    };
+
+    struct Channel
+    {
+        Counter<uint64_t> calls;
+        Counter<uint64_t> time;
+        Counter<uint64_t> max_time;
+        Counter<uint64_t> innovations;
+        Counter<uint64_t> rejections;
+        Counter<double> nis_sum;
+        Counter<double> last_nis;
+    };
+
+    /* Marks the innovation as recorded, returns false if it was already recorded by a nested call */
+    bool claimInnovation(unsigned long sequence)
+    {
+        if(sequence == recorded_innovation)
+            return false;
+        recorded_innovation = sequence;
+        return true;
+    }
+
+    const char* const* channel_names;
+    unsigned channel_count;
+    /* Sequence number of the last recorded innovation, only used by the filter thread */
+    unsigned long recorded_innovation;
+    Channel channels[MAX_CHANNELS];
+    Counter<uint64_t> timer_calls[TIMER_COUNT];
+    Counter<uint64_t> timer_time[TIMER_COUNT];
+};
+
+#ifdef UWV_KALMAN_FILTERS_INSTRUMENTATION
+
+class FilterInstrumentation::ScopedTimer
+{
+public:
+    ScopedTimer(FilterInstrumentation* instrumentation, Timer timer) :
+        instrumentation(instrumentation), timer(timer), start(instrumentation ? now() : 0) {}
+    ~ScopedTimer()
+    {
+        if(instrumentation)
+            instrumentation->recordTime(timer, now() - start);
+    }
+private:
+    FilterInstrumentation* instrumentation;
+    Timer timer;
+    uint64_t start;
+};
+
+template<typename Innovation>
+class FilterInstrumentation::CallScope
+{
+public:
+    CallScope(FilterInstrumentation* instrumentation, unsigned channel, const Innovation& innovation) :
+        instrumentation(instrumentation), channel(channel), innovation(innovation),
+        sequence(innovation.sequence), start(instrumentation ? now() : 0) {}
+    ~CallScope()
+    {
+        if(!instrumentation)
+            return;
+        instrumentation->recordCall(channel, now() - start);
+        if(innovation.sequence != sequence && instrumentation->claimInnovation(innovation.sequence))
+            instrumentation->recordInnovation(channel, innovation.mahalanobis2, innovation.accepted);
+    }
+private:
+    FilterInstrumentation* instrumentation;
+    unsigned channel;
+    const Innovation& innovation;
+    unsigned long sequence;
+    uint64_t start;
+};
+
+#else
+
+class FilterInstrumentation::ScopedTimer
+{
+public:
+    ScopedTimer(FilterInstrumentation*, Timer) {}
+};
+
+template<typename Innovation>
+class FilterInstrumentation::CallScope
+{
+public:
+    CallScope(FilterInstrumentation*, unsigned, const Innovation&) {}
+};
+
+#endif
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include "ImuPreintegration.hpp"
+#include <cmath>
+
+using namespace uwv_kalman_filters;
+
+static Eigen::Matrix3d skew(const Eigen::Vector3d& v)
+{
+    Eigen::Matrix3d m;
+    m << 0., -v.z(), v.y(),
+         v.z(), 0., -v.x(),
+         -v.y(), v.x(), 0.;
+    return m;
+}
+
+ImuPreintegration::ImuPreintegration()
+{
+    reset(Eigen::Vector3d::Zero());
+}
+
+void ImuPreintegration::reset(const Eigen::Vector3d& bias_gyro)
+{
+    this->bias_gyro = bias_gyro;
+    delta_rotation.setIdentity();
+    bias_jacobian.setZero();
+    specific_force_integral.setZero();
+    specific_force_cov_sum.setZero();
+    time = 0.;
+    samples = 0;
+}
+
+void ImuPreintegration::integrate(const Eigen::Vector3d& rotation_rate, const Eigen::Vector3d& specific_force,
+                                  const Eigen::Matrix3d& specific_force_cov, double delta_t)
+{
+    // the sample is assumed to be measured at the end of its period
+    const Eigen::Vector3d rotation_vector = (rotation_rate - bias_gyro) * delta_t;
+    const Eigen::Quaterniond sample_rotation = exp(rotation_vector);
+    delta_rotation = (delta_rotation * sample_rotation).normalized();
+    bias_jacobian = sample_rotation.conjugate().toRotationMatrix() * bias_jacobian - rightJacobian(rotation_vector) * delta_t;
+
+    specific_force_integral += delta_t * (delta_rotation * specific_force);
+    specific_force_cov_sum += (delta_t * delta_t) * specific_force_cov;
+    time += delta_t;
+    samples++;
+}
+
+Eigen::Vector3d ImuPreintegration::correctedRotationVector(const Eigen::Vector3d& bias_gyro) const
+{
+    return log(delta_rotation * exp(bias_jacobian * (bias_gyro - this->bias_gyro)));
+}
+
+Eigen::Vector3d ImuPreintegration::getMeanSpecificForce() const
+{
+    if(time <= 0.)
+        return Eigen::Vector3d::Zero();
+    return delta_rotation.conjugate() * (specific_force_integral / time);
+}
+
+Eigen::Matrix3d ImuPreintegration::getMeanSpecificForceCov() const
+{
+    if(time <= 0.)
+        return Eigen::Matrix3d::Zero();
+    const Eigen::Matrix3d rotation = delta_rotation.conjugate().toRotationMatrix();
+    return rotation * (specific_force_cov_sum / (time * time)) * rotation.transpose();
+}
+
+Eigen::Matrix3d ImuPreintegration::rightJacobian(const Eigen::Vector3d& rotation_vector)
+{
+    const double angle = rotation_vector.norm();
+    const Eigen::Matrix3d phi = skew(rotation_vector);
+    if(angle < 1e-6)
+        return Eigen::Matrix3d::Identity() - 0.5 * phi;
+    const double angle2 = angle * angle;
+    return Eigen::Matrix3d::Identity() - ((1. - std::cos(angle)) / angle2) * phi +
+           ((angle - std::sin(angle)) / (angle2 * angle)) * phi * phi;
+}
+
+Eigen::Quaterniond ImuPreintegration::exp(const Eigen::Vector3d& rotation_vector)
+{
+    const double angle = rotation_vector.norm();
+    if(angle < 1e-12)
+        return Eigen::Quaterniond::Identity();
+    return Eigen::Quaterniond(Eigen::AngleAxisd(angle, rotation_vector / angle));
+}
+
+Eigen::Vector3d ImuPreintegration::log(const Eigen::Quaterniond& rotation)
+{
+    const Eigen::AngleAxisd angle_axis(rotation);
+    double angle = angle_axis.angle();
+    // shortest rotation
+    if(angle > M_PI)
+        angle -= 2. * M_PI;
+    return angle * angle_axis.axis();
+}
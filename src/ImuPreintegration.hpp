@@ -0,0 +1,77 @@
+#ifndef _UWV_KALMAN_FILTERS_IMU_PREINTEGRATION_HPP_
+#define _UWV_KALMAN_FILTERS_IMU_PREINTEGRATION_HPP_
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Pre-integration of IMU samples between two prediction steps.
+ *
+ * The rotation of the IMU frame is integrated given the gyro bias at the start of
+ * the interval, together with its Jacobian with respect to the bias. This allows to
+ * correct the delta rotation for a different bias to first order without integrating
+ * the samples again.
+ * The specific forces are averaged in the IMU frame at the end of the interval, assuming
+ * the specific force in the navigation frame to be constant during the interval.
+ * The average is not used as a delta velocity, PoseUKF observes its acceleration state with it
+ * and the accelerometer bias is part of that measurement model.
+ */
+class ImuPreintegration
+{
+public:
+    ImuPreintegration();
+
+    /* Starts a new interval with the given gyro bias */
+    void reset(const Eigen::Vector3d& bias_gyro);
+
+    /* Adds a sample measured over the period delta_t */
+    void integrate(const Eigen::Vector3d& rotation_rate, const Eigen::Vector3d& specific_force,
+                   const Eigen::Matrix3d& specific_force_cov, double delta_t);
+
+    /* Integrated time in seconds */
+    double getTime() const { return time; }
+
+    unsigned getSampleCount() const { return samples; }
+
+    /* Delta rotation of the IMU frame given the bias the interval was started with */
+    const Eigen::Quaterniond& getDeltaRotation() const { return delta_rotation; }
+
+    /* Jacobian of the delta rotation (as right perturbation) with respect to the gyro bias */
+    const Eigen::Matrix3d& getBiasJacobian() const { return bias_jacobian; }
+
+    /* Rotation vector of the delta rotation corrected for the given gyro bias */
+    Eigen::Vector3d correctedRotationVector(const Eigen::Vector3d& bias_gyro) const;
+
+    /* Mean specific force expressed in the IMU frame at the end of the interval */
+    Eigen::Vector3d getMeanSpecificForce() const;
+
+    /* Covariance of the mean specific force */
+    Eigen::Matrix3d getMeanSpecificForceCov() const;
+
+    /* Right Jacobian of SO(3) */
+    static Eigen::Matrix3d rightJacobian(const Eigen::Vector3d& rotation_vector);
+
+    static Eigen::Quaterniond exp(const Eigen::Vector3d& rotation_vector);
+    static Eigen::Vector3d log(const Eigen::Quaterniond& rotation);
+
+protected:
+    Eigen::Vector3d bias_gyro;
+    Eigen::Quaterniond delta_rotation;
+    Eigen::Matrix3d bias_jacobian;
+    /* Integral of the specific force expressed in the IMU frame at the start of the interval */
+    Eigen::Vector3d specific_force_integral;
+    /* Sum of dt^2 weighted specific force covariances */
+    Eigen::Matrix3d specific_force_cov_sum;
+    double time;
+    unsigned samples;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include "InnovationGate.hpp"
+#include <limits>
+#include <stdexcept>
+#include <boost/math/distributions/chi_squared.hpp>
+
+using namespace uwv_kalman_filters;
+
+InnovationGate::InnovationGate(unsigned dof, double confidence) : threshold(std::numeric_limits<double>::infinity())
+{
+    if(dof == 0)
+        throw std::invalid_argument("Innovation gate requires at least one degree of freedom");
+    if(confidence > 0. && confidence < 1.)
+        threshold = chiSquareQuantile(dof, confidence);
+}
+
+bool InnovationGate::isEnabled() const
+{
+    return threshold < std::numeric_limits<double>::infinity();
+}
+
+double InnovationGate::chiSquareQuantile(unsigned dof, double confidence)
+{
+    return boost::math::quantile(boost::math::chi_squared_distribution<double>(dof), confidence);
+}
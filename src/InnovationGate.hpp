@@ -0,0 +1,37 @@
+#ifndef _UWV_KALMAN_FILTERS_INNOVATION_GATE_HPP_
+#define _UWV_KALMAN_FILTERS_INNOVATION_GATE_HPP_
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Accepts an innovation if its squared Mahalanobis distance is within the quantile
+ * of the chi-square distribution with the degrees of freedom of the measurement.
+ * The threshold is computed once at construction.
+ */
+class InnovationGate
+{
+public:
+    /* A confidence outside of (0, 1) accepts any innovation */
+    explicit InnovationGate(unsigned dof = 1, double confidence = 0.);
+
+    bool operator()(const double& mahalanobis2) const
+    {
+        return mahalanobis2 <= threshold;
+    }
+
+    /* Largest accepted squared Mahalanobis distance, infinite if the gate is disabled */
+    double getThreshold() const { return threshold; }
+
+    bool isEnabled() const;
+
+    /* Quantile of the chi-square distribution with dof degrees of freedom */
+    static double chiSquareQuantile(unsigned dof, double confidence);
+
+private:
+    double threshold;
+};
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _UWV_KALMAN_FILTERS_LAZY_OUTPUT_HPP_
+#define _UWV_KALMAN_FILTERS_LAZY_OUTPUT_HPP_
+
+#include <Eigen/Core>
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Caches a value derived from the filter state.
+ *
+ * The value is computed on the first access after the revision of the state changed
+ * and returned from the cache until the next change. Not thread-safe, it has to be
+ * accessed from the thread which updates the filter or be synchronized externally.
+ */
+template<typename T>
+class LazyOutput
+{
+public:
+    LazyOutput() : revision(0), valid(false) {}
+
+    /* Returns the cached value, compute(T&) is only called if the revision changed since the last call */
+    template<typename Compute>
+    const T& get(unsigned long current_revision, const Compute& compute)
+    {
+        if(!valid || revision != current_revision)
+        {
+            compute(value);
+            revision = current_revision;
+            valid = true;
+        }
+        return value;
+    }
+
+    /* Forces the value to be computed again on the next access */
+    void invalidate() { valid = false; }
+
+private:
+    T value;
+    unsigned long revision;
+    bool valid;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}
+
+#endif
@@ -0,0 +1,244 @@
+#include "MeasurementIngestion.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+using namespace uwv_kalman_filters;
+
+IngestionQueueStatistics::IngestionQueueStatistics() : pushed(0), dropped_overflow(0), dropped_stale(0), dropped_late(0),
+    invalid(0), integrated(0), max_depth(0)
+{
+}
+
+MeasurementIngestion::MeasurementIngestion(PoseUKF& filter, const base::Time& time, double reorder_window) :
+    filter(filter), filter_time(time.toMicroseconds()), published_time(time.toMicroseconds()),
+    reorder_window(int64_t(reorder_window * 1e6)), max_prediction_step(0.1), running(false)
+{
+    if(reorder_window < 0.)
+        throw std::invalid_argument("The reorder window must not be negative");
+    for(unsigned i = 0; i < LOG_RECORD_TYPE_COUNT; i++)
+        queues[i].reset(new Queue(IngestionQueueParameters()));
+}
+
+MeasurementIngestion::~MeasurementIngestion()
+{
+    stop();
+}
+
+void MeasurementIngestion::setQueueParameters(MissionLogRecordType type, const IngestionQueueParameters& parameters)
+{
+    if(type >= LOG_RECORD_TYPE_COUNT)
+        throw std::invalid_argument("Unknown record type");
+    if(parameters.capacity == 0)
+        throw std::invalid_argument("The capacity of a queue must be positive");
+    if(running)
+        throw std::runtime_error("The queue parameters can't be changed while the estimation thread is running");
+    queues[type].reset(new Queue(parameters));
+    std::lock_guard<std::mutex> lock(statistics_mutex);
+    published[type] = queues[type]->consumer;
+}
+
+void MeasurementIngestion::setMaxPredictionStep(double max_step)
+{
+    max_prediction_step = max_step;
+}
+
+bool MeasurementIngestion::push(const MissionLogRecord& record)
+{
+    if(record.type >= LOG_RECORD_TYPE_COUNT)
+        return false;
+    Queue& queue = *queues[record.type];
+
+    Entry entry;
+    entry.record = record;
+    entry.push_time = FilterInstrumentation::now();
+    while(!queue.queue.push(entry))
+    {
+        if(queue.parameters.overflow_policy == DROP_NEWEST)
+        {
+            queue.dropped_overflow.store(queue.dropped_overflow.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+        std::this_thread::yield();
+    }
+
+    queue.pushed.store(queue.pushed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    const uint64_t depth = queue.queue.size();
+    if(depth > queue.max_depth.load(std::memory_order_relaxed))
+        queue.max_depth.store(depth, std::memory_order_relaxed);
+    if(record.time > queue.newest_time.load(std::memory_order_relaxed))
+        queue.newest_time.store(record.time, std::memory_order_release);
+    return true;
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::RotationRate& rotation_rate)
+{
+    return pushMeasurement(LOG_ROTATION_RATE, time, rotation_rate);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::Acceleration& acceleration)
+{
+    return pushMeasurement(LOG_ACCELERATION, time, acceleration);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::Velocity& velocity)
+{
+    return pushMeasurement(LOG_VELOCITY, time, velocity);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::Z_Position& z_position)
+{
+    return pushMeasurement(LOG_Z_POSITION, time, z_position);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::XY_Position& xy_position)
+{
+    return pushMeasurement(LOG_XY_POSITION, time, xy_position);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::GeographicPosition& geo_position,
+                                const Eigen::Vector3d& gps_in_body)
+{
+    return pushMeasurement(LOG_GEOGRAPHIC_POSITION, time, geo_position, gps_in_body);
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::BodyEffortsMeasurement& body_efforts,
+                                bool only_affect_velocity)
+{
+    return pushMeasurement(LOG_BODY_EFFORTS, time, body_efforts, Eigen::Vector3d(only_affect_velocity ? 1. : 0., 0., 0.));
+}
+
+bool MeasurementIngestion::push(const base::Time& time, const PoseUKF::WaterVelocityMeasurement& adcp_measurements,
+                                double cell_weighting)
+{
+    return pushMeasurement(LOG_WATER_VELOCITY, time, adcp_measurements, Eigen::Vector3d(cell_weighting, 0., 0.));
+}
+
+unsigned MeasurementIngestion::process(bool flush)
+{
+    // records are merged up to the reorder window before the newest pushed record
+    int64_t newest_time = std::numeric_limits<int64_t>::min();
+    for(unsigned i = 0; i < LOG_RECORD_TYPE_COUNT; i++)
+        newest_time = std::max(newest_time, queues[i]->newest_time.load(std::memory_order_acquire));
+    const int64_t watermark = flush ? std::numeric_limits<int64_t>::max() :
+                              newest_time < std::numeric_limits<int64_t>::min() + reorder_window ?
+                              std::numeric_limits<int64_t>::min() : newest_time - reorder_window;
+
+    unsigned merged = 0;
+    while(true)
+    {
+        // the oldest record at the front of the queues
+        Queue* next = NULL;
+        const Entry* entry = NULL;
+        for(unsigned i = 0; i < LOG_RECORD_TYPE_COUNT; i++)
+        {
+            const Entry* front = queues[i]->queue.front();
+            if(front && (!entry || front->record.time < entry->record.time))
+            {
+                next = queues[i].get();
+                entry = front;
+            }
+        }
+        if(!entry || entry->record.time > watermark)
+            break;
+
+        IngestionQueueStatistics& statistics = next->consumer;
+        const double queue_latency = double(FilterInstrumentation::now() - entry->push_time);
+        if(next->parameters.max_queue_latency > 0. && queue_latency > next->parameters.max_queue_latency * 1e9)
+            statistics.dropped_stale++;
+        else if(entry->record.time < filter_time)
+            statistics.dropped_late++;
+        else
+        {
+            predict(entry->record.time);
+            const uint64_t start = FilterInstrumentation::now();
+            if(integrateRecord(filter, entry->record))
+            {
+                statistics.integrated++;
+                statistics.queue_latency.add(queue_latency);
+                statistics.update_latency.add(double(FilterInstrumentation::now() - start));
+            }
+            else
+                statistics.invalid++;
+        }
+        next->queue.pop();
+        next->consumer_changed = true;
+        merged++;
+    }
+
+    if(merged > 0)
+    {
+        // only the statistics of the merged queues are copied, each carries two latency histograms
+        std::lock_guard<std::mutex> lock(statistics_mutex);
+        for(unsigned i = 0; i < LOG_RECORD_TYPE_COUNT; i++)
+        {
+            if(queues[i]->consumer_changed)
+            {
+                published[i] = queues[i]->consumer;
+                queues[i]->consumer_changed = false;
+            }
+        }
+    }
+    published_time.store(filter_time, std::memory_order_relaxed);
+    return merged;
+}
+
+void MeasurementIngestion::predict(int64_t time)
+{
+    if(time <= filter_time)
+        return;
+
+    double delta_t = double(time - filter_time) * 1e-6;
+    int steps = max_prediction_step > 0. ? int(std::ceil(delta_t / max_prediction_step)) : 1;
+    for(int i = 0; i < steps; i++)
+        filter.predictionStep(delta_t / steps);
+    filter_time = time;
+}
+
+void MeasurementIngestion::start(double idle_sleep)
+{
+    if(running)
+        return;
+    running = true;
+    thread = std::thread(&MeasurementIngestion::run, this, idle_sleep);
+}
+
+void MeasurementIngestion::stop()
+{
+    running = false;
+    if(thread.joinable())
+        thread.join();
+}
+
+void MeasurementIngestion::run(double idle_sleep)
+{
+    const std::chrono::duration<double> sleep(idle_sleep);
+    while(running)
+    {
+        if(process() == 0)
+            std::this_thread::sleep_for(sleep);
+    }
+}
+
+base::Time MeasurementIngestion::getTime() const
+{
+    return base::Time::fromMicroseconds(published_time.load(std::memory_order_relaxed));
+}
+
+IngestionQueueStatistics MeasurementIngestion::getStatistics(MissionLogRecordType type) const
+{
+    if(type >= LOG_RECORD_TYPE_COUNT)
+        throw std::invalid_argument("Unknown record type");
+
+    IngestionQueueStatistics statistics;
+    {
+        std::lock_guard<std::mutex> lock(statistics_mutex);
+        statistics = published[type];
+    }
+    const Queue& queue = *queues[type];
+    statistics.pushed = queue.pushed.load(std::memory_order_relaxed);
+    statistics.dropped_overflow = queue.dropped_overflow.load(std::memory_order_relaxed);
+    statistics.max_depth = queue.max_depth.load(std::memory_order_relaxed);
+    return statistics;
+}
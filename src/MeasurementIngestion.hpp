@@ -0,0 +1,176 @@
+#ifndef _UWV_KALMAN_FILTERS_MEASUREMENT_INGESTION_HPP_
+#define _UWV_KALMAN_FILTERS_MEASUREMENT_INGESTION_HPP_
+
+#include <base/Time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "PoseUKF.hpp"
+#include "MissionLog.hpp"
+#include "MissionReplay.hpp"
+#include "SpscQueue.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/* Behavior of a full ingestion queue */
+enum QueueOverflowPolicy
+{
+    /* The new record is dropped and push returns false */
+    DROP_NEWEST,
+    /* The producer waits until the estimation thread made room */
+    BLOCK_PRODUCER
+};
+
+struct IngestionQueueParameters
+{
+    /* Number of queued records, rounded up to a power of two */
+    unsigned capacity;
+
+    QueueOverflowPolicy overflow_policy;
+
+    /* Records which waited longer than this time in seconds in the queue are dropped.
+     * Zero keeps all records */
+    double max_queue_latency;
+
+    IngestionQueueParameters() : capacity(256), overflow_policy(DROP_NEWEST), max_queue_latency(0.) {}
+};
+
+struct IngestionQueueStatistics
+{
+    uint64_t pushed;
+    /* Records rejected by a full queue with DROP_NEWEST */
+    uint64_t dropped_overflow;
+    /* Records dropped because of max_queue_latency */
+    uint64_t dropped_stale;
+    /* Records older than the filter time when they were merged */
+    uint64_t dropped_late;
+    /* Records of invalid dimension */
+    uint64_t invalid;
+    uint64_t integrated;
+    /* Maximum number of queued records */
+    uint64_t max_depth;
+    /* Time the integrated records waited in the queue */
+    LatencyHistogram queue_latency;
+    /* Duration of the measurement updates */
+    LatencyHistogram update_latency;
+
+    IngestionQueueStatistics();
+};
+
+/**
+ * Asynchronous front-end of a PoseUKF.
+ *
+ * Each measurement type (see MissionLogRecordType) has its own lock-free single producer queue,
+ * so sensor drivers running on different threads never wait for the filter or for each other.
+ * Records of one type must therefore be pushed from a single thread only.
+ *
+ * A single estimation thread, either the internal one of start() or the caller of process(),
+ * merges the queues by time stamp. Before each record the filter is predicted to its time,
+ * the record is then integrated. A record is only merged once its time is at least
+ * reorder_window seconds older than the newest record pushed to any queue, which allows
+ * sensors with a different transport delay to be merged in order.
+ * Records older than the filter time can't be integrated anymore and are dropped.
+ */
+class MeasurementIngestion
+{
+public:
+    MeasurementIngestion(PoseUKF& filter, const base::Time& time, double reorder_window = 0.);
+    ~MeasurementIngestion();
+
+    /* Replaces the queue of the record type, queued records of the type are discarded.
+     * Setup only, has to be called before the first record of the type is pushed.
+     * Throws std::runtime_error if the estimation thread is running */
+    void setQueueParameters(MissionLogRecordType type, const IngestionQueueParameters& parameters);
+
+    /* Predictions longer than the given period in seconds are split into several steps (default 0.1s) */
+    void setMaxPredictionStep(double max_step);
+
+    /* Called by the producer of the record type. Returns false if the record was dropped */
+    bool push(const MissionLogRecord& record);
+    bool push(const base::Time& time, const PoseUKF::RotationRate& rotation_rate);
+    bool push(const base::Time& time, const PoseUKF::Acceleration& acceleration);
+    bool push(const base::Time& time, const PoseUKF::Velocity& velocity);
+    bool push(const base::Time& time, const PoseUKF::Z_Position& z_position);
+    bool push(const base::Time& time, const PoseUKF::XY_Position& xy_position);
+    bool push(const base::Time& time, const PoseUKF::GeographicPosition& geo_position,
+              const Eigen::Vector3d& gps_in_body = Eigen::Vector3d::Zero());
+    bool push(const base::Time& time, const PoseUKF::BodyEffortsMeasurement& body_efforts,
+              bool only_affect_velocity = false);
+    bool push(const base::Time& time, const PoseUKF::WaterVelocityMeasurement& adcp_measurements,
+              double cell_weighting);
+
+    /* Merges and integrates all records which are ready, returns the number of merged records.
+     * If flush is set the reorder window is ignored. Must not be called while the thread is running */
+    unsigned process(bool flush = false);
+
+    /* Runs process in an internal estimation thread, which sleeps for the given time in seconds when idle */
+    void start(double idle_sleep = 0.0005);
+
+    /* Stops the estimation thread, queued records are kept */
+    void stop();
+
+    /* Time of the filter */
+    base::Time getTime() const;
+
+    /* Can be called from any thread, the consumer side is updated after each call of process */
+    IngestionQueueStatistics getStatistics(MissionLogRecordType type) const;
+
+protected:
+    struct Entry
+    {
+        MissionLogRecord record;
+        /* Steady clock time of the push in ns */
+        uint64_t push_time;
+    };
+
+    struct Queue
+    {
+        Queue(const IngestionQueueParameters& parameters) : parameters(parameters), queue(parameters.capacity),
+            newest_time(std::numeric_limits<int64_t>::min()), pushed(0), dropped_overflow(0), max_depth(0),
+            consumer_changed(false) {}
+        IngestionQueueParameters parameters;
+        SpscQueue<Entry> queue;
+        /* Written by the producer only */
+        std::atomic<int64_t> newest_time;
+        std::atomic<uint64_t> pushed;
+        std::atomic<uint64_t> dropped_overflow;
+        std::atomic<uint64_t> max_depth;
+        /* Updated by the estimation thread only */
+        IngestionQueueStatistics consumer;
+        /* Set if consumer changed since it was published */
+        bool consumer_changed;
+    };
+
+    template<typename Measurement>
+    bool pushMeasurement(MissionLogRecordType type, const base::Time& time, const Measurement& measurement,
+                         const Eigen::Vector3d& aux = Eigen::Vector3d::Zero())
+    {
+        MissionLogRecord record;
+        record.setMeasurement(type, time.toMicroseconds(), measurement.mu, measurement.cov);
+        for(unsigned i = 0; i < 3; i++)
+            record.aux[i] = aux[i];
+        return push(record);
+    }
+
+    void predict(int64_t time);
+    void run(double idle_sleep);
+
+    PoseUKF& filter;
+    int64_t filter_time;
+    std::atomic<int64_t> published_time;
+    int64_t reorder_window;
+    double max_prediction_step;
+    boost::shared_ptr<Queue> queues[LOG_RECORD_TYPE_COUNT];
+    /* Consumer statistics visible to getStatistics */
+    IngestionQueueStatistics published[LOG_RECORD_TYPE_COUNT];
+    mutable std::mutex statistics_mutex;
+    std::thread thread;
+    std::atomic<bool> running;
+};
+
+}
+
+#endif
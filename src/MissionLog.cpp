@@ -0,0 +1,120 @@
+#include "MissionLog.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace uwv_kalman_filters;
+
+const char* uwv_kalman_filters::recordTypeName(MissionLogRecordType type)
+{
+    switch(type)
+    {
+        case LOG_ROTATION_RATE: return "RotationRate";
+        case LOG_ACCELERATION: return "Acceleration";
+        case LOG_VELOCITY: return "Velocity";
+        case LOG_Z_POSITION: return "Z_Position";
+        case LOG_XY_POSITION: return "XY_Position";
+        case LOG_GEOGRAPHIC_POSITION: return "GeographicPosition";
+        case LOG_BODY_EFFORTS: return "BodyEfforts";
+        case LOG_WATER_VELOCITY: return "WaterVelocity";
+        case LOG_REFERENCE_POSITION: return "ReferencePosition";
+        default: return "Unknown";
+    }
+}
+
+MissionLogRecord::MissionLogRecord()
+{
+    std::memset(this, 0, sizeof(MissionLogRecord));
+}
+
+static bool compareRecordTime(const MissionLogRecord& a, const MissionLogRecord& b)
+{
+    return a.time < b.time;
+}
+
+MissionLogWriter::MissionLogWriter(const LocationConfiguration& location) : location(location)
+{
+}
+
+void MissionLogWriter::add(const MissionLogRecord& record)
+{
+    if(record.type >= LOG_RECORD_TYPE_COUNT || record.dimension > MissionLogRecord::MAX_DIMENSION)
+        throw std::invalid_argument("Invalid mission log record");
+    records.push_back(record);
+}
+
+void MissionLogWriter::write(const std::string& path)
+{
+    std::stable_sort(records.begin(), records.end(), compareRecordTime);
+
+    MissionLogHeader header;
+    std::memset(&header, 0, sizeof(MissionLogHeader));
+    header.magic = MissionLogHeader::MAGIC;
+    header.version = MissionLogHeader::VERSION;
+    header.record_size = sizeof(MissionLogRecord);
+    header.record_count = records.size();
+    header.location = location;
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file)
+        throw std::runtime_error("Failed to open mission log " + path);
+    bool success = std::fwrite(&header, sizeof(MissionLogHeader), 1, file) == 1;
+    if(success && !records.empty())
+        success = std::fwrite(&records[0], sizeof(MissionLogRecord), records.size(), file) == records.size();
+    success = std::fclose(file) == 0 && success;
+    if(!success)
+        throw std::runtime_error("Failed to write mission log " + path);
+}
+
+MissionLog::MissionLog(const std::string& path) : data(NULL), data_size(0), header(NULL), records(NULL), record_count(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open mission log " + path);
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || std::size_t(file_stat.st_size) < sizeof(MissionLogHeader))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid mission log " + path);
+    }
+    data_size = file_stat.st_size;
+    data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        data = NULL;
+        throw std::runtime_error("Failed to map mission log " + path);
+    }
+    // the records are accessed in order
+    madvise(data, data_size, MADV_SEQUENTIAL);
+
+    header = static_cast<const MissionLogHeader*>(data);
+    if(header->magic != MissionLogHeader::MAGIC || header->version != MissionLogHeader::VERSION ||
+        header->record_size != sizeof(MissionLogRecord) ||
+        header->record_count > (data_size - sizeof(MissionLogHeader)) / sizeof(MissionLogRecord))
+    {
+        munmap(data, data_size);
+        data = NULL;
+        throw std::runtime_error("Invalid mission log " + path);
+    }
+    records = reinterpret_cast<const MissionLogRecord*>(static_cast<const char*>(data) + sizeof(MissionLogHeader));
+    record_count = header->record_count;
+}
+
+MissionLog::~MissionLog()
+{
+    if(data)
+        munmap(data, data_size);
+}
+
+double MissionLog::getDuration() const
+{
+    if(record_count == 0)
+        return 0.;
+    return double(records[record_count-1].time - records[0].time) * 1e-6;
+}
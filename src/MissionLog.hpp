@@ -0,0 +1,158 @@
+#ifndef _UWV_KALMAN_FILTERS_MISSION_LOG_HPP_
+#define _UWV_KALMAN_FILTERS_MISSION_LOG_HPP_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "PoseUKFConfig.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/* Measurement types stored in a mission log */
+enum MissionLogRecordType
+{
+    LOG_ROTATION_RATE = 0,
+    LOG_ACCELERATION,
+    LOG_VELOCITY,
+    LOG_Z_POSITION,
+    LOG_XY_POSITION,
+    LOG_GEOGRAPHIC_POSITION,
+    LOG_BODY_EFFORTS,
+    LOG_WATER_VELOCITY,
+    /* Ground truth position in the navigation frame, it is not integrated in the filter */
+    LOG_REFERENCE_POSITION,
+    LOG_RECORD_TYPE_COUNT
+};
+
+/* Name of the record type, used in reports */
+const char* recordTypeName(MissionLogRecordType type);
+
+/**
+ * Fixed size record of a timestamped measurement.
+ *
+ * The covariance is stored as packed lower triangle in row-major order.
+ * The meaning of aux depends on the type:
+ * LOG_GEOGRAPHIC_POSITION: position of the GPS antenna in the body frame
+ * LOG_WATER_VELOCITY: cell weighting in aux[0]
+ * LOG_BODY_EFFORTS: aux[0] != 0 if the efforts should only affect the velocity
+ */
+struct MissionLogRecord
+{
+    enum { MAX_DIMENSION = 6, MAX_COVARIANCE = MAX_DIMENSION * (MAX_DIMENSION + 1) / 2 };
+
+    /* Microseconds since the unix epoch, same as base::Time */
+    int64_t time;
+    uint16_t type;
+    uint16_t dimension;
+    uint32_t reserved;
+    double mu[MAX_DIMENSION];
+    double cov[MAX_COVARIANCE];
+    double aux[3];
+
+    MissionLogRecord();
+
+    /* Throws std::invalid_argument if the measurement has more than MAX_DIMENSION rows */
+    template<typename Mu, typename Cov>
+    void setMeasurement(MissionLogRecordType type, int64_t time, const Mu& mu, const Cov& cov)
+    {
+        if(mu.rows() > MAX_DIMENSION)
+            throw std::invalid_argument("The measurement exceeds the dimension of a mission log record");
+        this->type = type;
+        this->time = time;
+        dimension = mu.rows();
+        for(unsigned i = 0, k = 0; i < dimension; i++)
+        {
+            this->mu[i] = mu(i);
+            for(unsigned j = 0; j <= i; j++, k++)
+                this->cov[k] = cov(i, j);
+        }
+    }
+
+    /* Returns false if the dimension of the record doesn't match */
+    template<typename Mu, typename Cov>
+    bool getMeasurement(Mu& mu, Cov& cov) const
+    {
+        if(dimension != mu.rows())
+            return false;
+        for(unsigned i = 0, k = 0; i < dimension; i++)
+        {
+            mu(i) = this->mu[i];
+            for(unsigned j = 0; j <= i; j++, k++)
+                cov(i, j) = cov(j, i) = this->cov[k];
+        }
+        return true;
+    }
+};
+
+/* File header of a mission log, followed by record_count records */
+struct MissionLogHeader
+{
+    enum { MAGIC = 0x4c565755, VERSION = 1 }; // "UWVL"
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t record_count;
+    /* Origin of the navigation frame */
+    LocationConfiguration location;
+};
+
+/**
+ * Collects records and writes them ordered by time to a mission log file.
+ */
+class MissionLogWriter
+{
+public:
+    MissionLogWriter(const LocationConfiguration& location);
+
+    void add(const MissionLogRecord& record);
+
+    /* Writes all records in time order, records with equal time stamps keep their order.
+     * Throws std::runtime_error if the file can't be written */
+    void write(const std::string& path);
+
+    std::size_t size() const { return records.size(); }
+
+private:
+    LocationConfiguration location;
+    std::vector<MissionLogRecord> records;
+};
+
+/**
+ * Read-only memory mapped view of a mission log file.
+ */
+class MissionLog
+{
+public:
+    /* Throws std::runtime_error if the file can't be mapped or is not a valid mission log */
+    explicit MissionLog(const std::string& path);
+    ~MissionLog();
+
+    std::size_t size() const { return record_count; }
+    const MissionLogRecord& operator[](std::size_t index) const { return records[index]; }
+    const MissionLogRecord* begin() const { return records; }
+    const MissionLogRecord* end() const { return records + record_count; }
+
+    const LocationConfiguration& getLocation() const { return header->location; }
+
+    /* Time between the first and the last record in seconds */
+    double getDuration() const;
+
+private:
+    MissionLog(const MissionLog&);
+    MissionLog& operator=(const MissionLog&);
+
+    void* data;
+    std::size_t data_size;
+    const MissionLogHeader* header;
+    const MissionLogRecord* records;
+    std::size_t record_count;
+};
+
+}
+
+#endif
@@ -0,0 +1,282 @@
+#include "MissionReplay.hpp"
+#include "PoseUKF.hpp"
+#include "VelocityUKF.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace uwv_kalman_filters;
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+LatencyHistogram::LatencyHistogram() : count(0), sum_ns(0.), max_ns(0.)
+{
+    std::memset(buckets, 0, sizeof(buckets));
+}
+
+void LatencyHistogram::add(double latency_ns)
+{
+    int bucket = latency_ns >= 1. ? int(std::log2(latency_ns)) : 0;
+    buckets[std::min(bucket, int(BUCKETS) - 1)]++;
+    count++;
+    sum_ns += latency_ns;
+    max_ns = std::max(max_ns, latency_ns);
+}
+
+double LatencyHistogram::mean() const
+{
+    return count ? sum_ns / count : 0.;
+}
+
+double LatencyHistogram::quantile(double q) const
+{
+    uint64_t threshold = uint64_t(std::ceil(q * count));
+    uint64_t accumulated = 0;
+    for(int i = 0; i < BUCKETS; i++)
+    {
+        accumulated += buckets[i];
+        if(accumulated >= threshold && accumulated > 0)
+            return std::min(std::ldexp(1., i + 1), max_ns);
+    }
+    return max_ns;
+}
+
+TrajectoryError::TrajectoryError() : count(0), sum_squared(0.), sum_squared_horizontal(0.), max(0.), final(0.)
+{
+}
+
+void TrajectoryError::add(const Eigen::Vector3d& error)
+{
+    count++;
+    sum_squared += error.squaredNorm();
+    sum_squared_horizontal += error.head<2>().squaredNorm();
+    final = error.norm();
+    max = std::max(max, final);
+}
+
+double TrajectoryError::rms() const
+{
+    return count ? std::sqrt(sum_squared / count) : 0.;
+}
+
+double TrajectoryError::rmsHorizontal() const
+{
+    return count ? std::sqrt(sum_squared_horizontal / count) : 0.;
+}
+
+ReplayReport::ReplayReport() : mission_duration(0.), wall_time(0.), speed_up(0.), records(0), predictions(0), out_of_order(0), invalid(0)
+{
+}
+
+static void printLatency(FILE* stream, const char* name, const LatencyHistogram& histogram)
+{
+    if(histogram.count == 0)
+        return;
+    std::fprintf(stream, "%-20s %10llu %10.0f %10.0f %10.0f %10.0f %10.0f\n", name, (unsigned long long)histogram.count,
+                 histogram.mean(), histogram.quantile(0.5), histogram.quantile(0.9), histogram.quantile(0.99), histogram.max_ns);
+}
+
+void ReplayReport::print(FILE* stream) const
+{
+    std::fprintf(stream, "mission duration: %.1f s, replay time: %.3f s, speed-up: %.1fx\n", mission_duration, wall_time, speed_up);
+    std::fprintf(stream, "records: %llu, predictions: %llu, out of order: %llu, invalid: %llu\n", (unsigned long long)records,
+                 (unsigned long long)predictions, (unsigned long long)out_of_order, (unsigned long long)invalid);
+    std::fprintf(stream, "%-20s %10s %10s %10s %10s %10s %10s\n", "latency [ns]", "count", "mean", "p50", "p90", "p99", "max");
+    printLatency(stream, "Prediction", prediction_latency);
+    for(int i = 0; i < LOG_RECORD_TYPE_COUNT; i++)
+        printLatency(stream, recordTypeName(MissionLogRecordType(i)), latency[i]);
+    if(trajectory_error.count)
+        std::fprintf(stream, "position error [m]: rms %.3f, horizontal rms %.3f, max %.3f, final %.3f (%llu references)\n",
+                     trajectory_error.rms(), trajectory_error.rmsHorizontal(), trajectory_error.max,
+                     trajectory_error.final, (unsigned long long)trajectory_error.count);
+}
+
+MissionReplay::MissionReplay(PoseUKF& filter) : filter(filter), max_prediction_step(0.1), filter_time(0)
+{
+}
+
+void MissionReplay::setMaxPredictionStep(double max_step)
+{
+    max_prediction_step = max_step;
+}
+
+const ReplayReport& MissionReplay::replay(const MissionLog& log)
+{
+    report = ReplayReport();
+    report.mission_duration = log.getDuration();
+    if(log.size() == 0)
+        return report;
+
+    filter_time = log[0].time;
+    const Clock::time_point start = Clock::now();
+    for(const MissionLogRecord* record = log.begin(); record != log.end(); ++record)
+    {
+        report.records++;
+        if(record->time < filter_time)
+        {
+            report.out_of_order++;
+            continue;
+        }
+        predict(record->time);
+        if(!integrate(*record))
+            report.invalid++;
+    }
+    report.wall_time = elapsedNs(start) * 1e-9;
+    report.speed_up = report.wall_time > 0. ? report.mission_duration / report.wall_time : 0.;
+    return report;
+}
+
+void MissionReplay::predict(int64_t time)
+{
+    if(time <= filter_time)
+        return;
+
+    const Clock::time_point start = Clock::now();
+    double delta_t = double(time - filter_time) * 1e-6;
+    int steps = max_prediction_step > 0. ? int(std::ceil(delta_t / max_prediction_step)) : 1;
+    for(int i = 0; i < steps; i++)
+        filter.predictionStep(delta_t / steps);
+    filter_time = time;
+    report.prediction_latency.add(elapsedNs(start));
+    report.predictions++;
+}
+
+bool MissionReplay::integrate(const MissionLogRecord& record)
+{
+    const Clock::time_point start = Clock::now();
+    if(record.type == LOG_REFERENCE_POSITION)
+    {
+        if(record.dimension != 3)
+            return false;
+        PoseUKF::State state;
+        filter.getCurrentState(state);
+        Eigen::Vector3d reference(record.mu[0], record.mu[1], record.mu[2]);
+        report.trajectory_error.add(Eigen::Vector3d(state.position) - reference);
+    }
+    else if(!integrateRecord(filter, record))
+        return false;
+    report.latency[record.type].add(elapsedNs(start));
+    return true;
+}
+
+bool uwv_kalman_filters::integrateRecord(PoseUKF& filter, const MissionLogRecord& record)
+{
+    switch(record.type)
+    {
+        case LOG_ROTATION_RATE:
+        {
+            PoseUKF::RotationRate measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_ACCELERATION:
+        {
+            PoseUKF::Acceleration measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_VELOCITY:
+        {
+            PoseUKF::Velocity measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_Z_POSITION:
+        {
+            PoseUKF::Z_Position measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_XY_POSITION:
+        {
+            PoseUKF::XY_Position measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_GEOGRAPHIC_POSITION:
+        {
+            PoseUKF::GeographicPosition measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement, Eigen::Vector3d(record.aux[0], record.aux[1], record.aux[2]));
+            break;
+        }
+        case LOG_BODY_EFFORTS:
+        {
+            PoseUKF::BodyEffortsMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement, record.aux[0] != 0.);
+            break;
+        }
+        case LOG_WATER_VELOCITY:
+        {
+            PoseUKF::WaterVelocityMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement, record.aux[0]);
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool uwv_kalman_filters::integrateRecord(VelocityUKF& filter, const MissionLogRecord& record)
+{
+    switch(record.type)
+    {
+        case LOG_ROTATION_RATE:
+        {
+            VelocityUKF::GyroMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_VELOCITY:
+        {
+            VelocityUKF::DVLMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_Z_POSITION:
+        {
+            VelocityUKF::PressureMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        case LOG_BODY_EFFORTS:
+        {
+            VelocityUKF::BodyEffortsMeasurement measurement;
+            if(!record.getMeasurement(measurement.mu, measurement.cov))
+                return false;
+            filter.integrateMeasurement(measurement);
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}
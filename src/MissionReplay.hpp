@@ -0,0 +1,106 @@
+#ifndef _UWV_KALMAN_FILTERS_MISSION_REPLAY_HPP_
+#define _UWV_KALMAN_FILTERS_MISSION_REPLAY_HPP_
+
+#include <cstdio>
+#include "MissionLog.hpp"
+
+namespace uwv_kalman_filters
+{
+
+class PoseUKF;
+class VelocityUKF;
+
+/* Integrates the measurement of a record in the filter.
+ * Returns false for reference positions and records of unknown type or dimension */
+bool integrateRecord(PoseUKF& filter, const MissionLogRecord& record);
+
+/* Integrates velocities as DVL measurements, z positions as pressure measurements, rotation rates and body efforts
+ * in the velocity filter. Returns false for the other types and records of unknown dimension */
+bool integrateRecord(VelocityUKF& filter, const MissionLogRecord& record);
+
+/* Latency histogram with logarithmic buckets, bucket i counts latencies in [2^i, 2^(i+1)) ns */
+struct LatencyHistogram
+{
+    enum { BUCKETS = 40 };
+
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    double sum_ns;
+    double max_ns;
+
+    LatencyHistogram();
+    void add(double latency_ns);
+    double mean() const;
+    /* Upper bound of the bucket containing the given quantile in ns */
+    double quantile(double q) const;
+};
+
+/* Position error of the filter with respect to the reference positions */
+struct TrajectoryError
+{
+    uint64_t count;
+    double sum_squared;
+    double sum_squared_horizontal;
+    double max;
+    double final;
+
+    TrajectoryError();
+    void add(const Eigen::Vector3d& error);
+    double rms() const;
+    double rmsHorizontal() const;
+};
+
+struct ReplayReport
+{
+    /* Time covered by the log in seconds */
+    double mission_duration;
+    /* Wall clock time of the replay in seconds */
+    double wall_time;
+    /* Mission duration divided by the wall clock time */
+    double speed_up;
+    uint64_t records;
+    uint64_t predictions;
+    /* Records older than the filter time, they are skipped */
+    uint64_t out_of_order;
+    /* Records of unknown type or dimension, they are skipped */
+    uint64_t invalid;
+    LatencyHistogram prediction_latency;
+    LatencyHistogram latency[LOG_RECORD_TYPE_COUNT];
+    TrajectoryError trajectory_error;
+
+    ReplayReport();
+    void print(FILE* stream) const;
+};
+
+/**
+ * Streams the records of a mission log in time order into a PoseUKF.
+ *
+ * Before each measurement the filter is predicted to the time of the measurement.
+ * The latency of each prediction and measurement update is measured separately.
+ */
+class MissionReplay
+{
+public:
+    MissionReplay(PoseUKF& filter);
+
+    /* Predictions longer than the given period in seconds are split into several steps (default 0.1s) */
+    void setMaxPredictionStep(double max_step);
+
+    /* Replays all records of the log, the filter time starts at the first record */
+    const ReplayReport& replay(const MissionLog& log);
+
+    const ReplayReport& getReport() const { return report; }
+
+protected:
+    void predict(int64_t time);
+    bool integrate(const MissionLogRecord& record);
+
+    PoseUKF& filter;
+    double max_prediction_step;
+    int64_t filter_time;
+    ReplayReport report;
+};
+
+}
+
+#endif
@@ -1,18 +1,52 @@
 #include "PoseUKF.hpp"
+#include "EffortModel.hpp"
+#include "ImuPreintegration.hpp"
+#include "PoseUKFSnapshot.hpp"
+#include "PoseUKFSmoother.hpp"
 #include <math.h>
+#include <stdexcept>
+#include <limits>
 #include <base/Float.hpp>
 #include <base-logging/Logging.hpp>
-#include <uwv_dynamic_model/DynamicModel.hpp>
 #include <pose_estimation/GravitationalModel.hpp>
 #include <pose_estimation/GeographicProjection.hpp>
 
 using namespace uwv_kalman_filters;
 
+template class uwv_kalman_filters::SigmaPointFilter<PoseUKF::WState>;
+
+/* WGS-84 meridian radius of curvature at the equator, the smallest along a meridian */
+static const double EARTH_MERIDIAN_RADIUS_MIN = 6335439.0;
+
+static Eigen::Vector3d earthRotation(const pose_estimation::GeographicProjection& projection, const Eigen::Vector3d& position)
+{
+    double latitude, longitude;
+    projection.navToWorld(position.x(), position.y(), latitude, longitude);
+    return Eigen::Vector3d(pose_estimation::EARTHW * cos(latitude), 0., pose_estimation::EARTHW * sin(latitude));
+}
+
+static Eigen::Matrix3d crossProductMatrix(const Eigen::Vector3d& v)
+{
+    Eigen::Matrix3d m;
+    m << 0., -v.z(), v.y(),
+         v.z(), 0., -v.x(),
+         -v.y(), v.x(), 0.;
+    return m;
+}
+
+// rotation input of the process model, either the latest rotation rate or the pre-integrated IMU samples
+struct RotationInput
+{
+    const Eigen::Vector3d* rotation_rate;
+    const ImuPreintegration* preintegration;
+};
+
 // process model
 template <typename FilterState>
 FilterState
-processModel(const FilterState &state, const Eigen::Vector3d& rotation_rate,
-             boost::shared_ptr<pose_estimation::GeographicProjection> projection,
+processModel(const FilterState &state, const RotationInput& rotation_input,
+             const Eigen::Vector3d& earth_rotation,
+             const pose_estimation::GeographicProjection* exact_projection,
              const InertiaType::vectorized_type& inertia_offset,
              const LinDampingType::vectorized_type& lin_damping_offset,
              const QuadDampingType::vectorized_type& quad_damping_offset,
@@ -24,11 +58,20 @@ processModel(const FilterState &state, const Eigen::Vector3d& rotation_rate,
     new_state.position.boxplus(state.velocity, delta_time);
 
     // apply angular velocity
-    double latitude, longitude;
-    projection->navToWorld(state.position.x(), state.position.y(), latitude, longitude);
-    Eigen::Vector3d earth_rotation = Eigen::Vector3d(pose_estimation::EARTHW * cos(latitude), 0., pose_estimation::EARTHW * sin(latitude));
-    Eigen::Vector3d angular_velocity = state.orientation * (rotation_rate - state.bias_gyro) - earth_rotation;
-    new_state.orientation.boxplus(angular_velocity, delta_time);
+    // the earth rotation is only evaluated at the position of the sigma point if an exact projection is given
+    const Eigen::Vector3d earth = exact_projection ? earthRotation(*exact_projection, state.position) : earth_rotation;
+    if(rotation_input.preintegration)
+    {
+        // delta rotation of the pre-integrated samples, corrected to first order for the gyro bias of the sigma point
+        Eigen::Vector3d delta_rotation = state.orientation * rotation_input.preintegration->correctedRotationVector(state.bias_gyro) -
+                                         earth * delta_time;
+        new_state.orientation.boxplus(delta_rotation);
+    }
+    else
+    {
+        Eigen::Vector3d angular_velocity = state.orientation * (*rotation_input.rotation_rate - state.bias_gyro) - earth;
+        new_state.orientation.boxplus(angular_velocity, delta_time);
+    }
 
     // apply acceleration
     new_state.velocity.boxplus(state.acceleration, delta_time);
@@ -124,22 +167,36 @@ measurementWaterCurrents(const FilterState &state, double cell_weighting)
     return expected_measurement;
 }
 
+typedef Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, 1, 0, PoseUKF::WaterVelocityProfile::MAX_CELLS, 1> CellWeighting;
+typedef Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, 1, 0, 2 * PoseUKF::WaterVelocityProfile::MAX_CELLS, 1> ProfileMeasurement;
+
+template <typename FilterState>
+ProfileMeasurement
+measurementWaterCurrentProfile(const FilterState &state, const CellWeighting& cell_weighting)
+{
+    // same model as measurementWaterCurrents, the IMU frame currents are computed once for all cells
+    Eigen::Vector3d water_velocity_below;
+    water_velocity_below << state.water_velocity_below[0], state.water_velocity_below[1], 0;
+    water_velocity_below = state.orientation.inverse() * ((Eigen::Vector3d)state.velocity - water_velocity_below);
+    const Eigen::Vector2d below = water_velocity_below.head<2>();
+
+    Eigen::Vector3d water_velocity;
+    water_velocity << state.water_velocity[0], state.water_velocity[1], 0;
+    water_velocity = state.orientation.inverse() * ((Eigen::Vector3d)state.velocity - water_velocity);
+    const Eigen::Vector2d at_vehicle = water_velocity.head<2>();
+
+    ProfileMeasurement expected_measurement(2 * cell_weighting.rows());
+    Eigen::Map< Eigen::Matrix<TranslationType::scalar, 2, Eigen::Dynamic> > cells(expected_measurement.data(), 2, cell_weighting.rows());
+    cells.noalias() = at_vehicle * (1. - cell_weighting.array()).matrix().transpose() + below * cell_weighting.transpose();
+    cells.colwise() += Eigen::Vector2d(state.bias_adcp[0], state.bias_adcp[1]);
+    return expected_measurement;
+}
+
 template <typename FilterState>
 Eigen::Matrix<TranslationType::scalar, 6, 1>
-measurementEfforts(const FilterState &state, boost::shared_ptr<uwv_dynamic_model::DynamicModel> dynamic_model,
+measurementEfforts(const FilterState &state, unsigned worker, const boost::shared_ptr<EffortModel>* effort_models,
                    const Eigen::Vector3d& imu_in_body, const Eigen::Vector3d& rotation_rate_body)
 {
-    // set damping parameters
-    uwv_dynamic_model::UWVParameters params = dynamic_model->getUWVParameters();
-    params.inertia_matrix.block(0,0,2,2) = state.inertia.block(0,0,2,2).cwiseAbs();
-    params.inertia_matrix.block(0,5,2,1) = state.inertia.block(0,2,2,1).cwiseAbs();
-    params.damping_matrices[0].block(0,0,2,2) = state.lin_damping.block(0,0,2,2).cwiseAbs();
-    params.damping_matrices[0].block(0,5,2,1) = state.lin_damping.block(0,2,2,1).cwiseAbs();
-    params.damping_matrices[1].block(0,0,2,2) = state.quad_damping.block(0,0,2,2).cwiseAbs();
-    params.damping_matrices[1].block(0,5,2,1) = state.quad_damping.block(0,2,2,1).cwiseAbs();
-       
-    dynamic_model->setUWVParameters(params);
-
     // assume center of rotation to be the body frame
     Eigen::Vector3d water_velocity;
     water_velocity[0] = state.water_velocity[0];
@@ -157,7 +214,9 @@ measurementEfforts(const FilterState &state, boost::shared_ptr<uwv_dynamic_model
     // assume the angular acceleration to be zero
     acceleration_6d << acceleration_body, base::Vector3d::Zero();
 
-    base::Vector6d efforts = dynamic_model->calcEfforts(acceleration_6d, velocity_6d, state.orientation);
+    // the damping parameters of the sigma point are applied to the effort model
+    base::Vector6d efforts = effort_models[worker]->calcEfforts(state.inertia, state.lin_damping, state.quad_damping,
+                                                                acceleration_6d, velocity_6d, state.orientation);
 
     // returns the expected forces and torques given the current state
     return efforts;
@@ -166,150 +225,1140 @@ measurementEfforts(const FilterState &state, boost::shared_ptr<uwv_dynamic_model
 /* This measurement model allows to constrain the velocity based on the motion model in the absence of effort measurements */
 template <typename FilterState>
 Eigen::Matrix<TranslationType::scalar, 6, 1>
-constrainVelocity(const FilterState &state, boost::shared_ptr<uwv_dynamic_model::DynamicModel> dynamic_model,
-                   const Eigen::Vector3d& imu_in_body, const Eigen::Vector3d& rotation_rate_body,
-                   const Eigen::Vector3d& water_velocity, const Eigen::Quaterniond& orientation,
-                   const Eigen::Vector3d& acceleration_body)
+constrainVelocity(const FilterState &state, unsigned worker, const boost::shared_ptr<EffortModel>* effort_models,
+                   const EffortContext& effort_context, const Eigen::Vector3d& imu_in_body,
+                   const Eigen::Vector3d& rotation_rate_body, const Eigen::Vector3d& water_velocity,
+                   const Eigen::Quaterniond& orientation)
 {
     Eigen::Vector3d velocity_body = orientation.inverse() * (state.velocity) - rotation_rate_body.cross(imu_in_body);
     velocity_body -= orientation.inverse() * water_velocity;
     base::Vector6d velocity_6d;
     velocity_6d << velocity_body, rotation_rate_body;
 
-    base::Vector6d acceleration_6d;
-    // assume the angular acceleration to be zero
-    acceleration_6d << acceleration_body, base::Vector3d::Zero();
-
-    base::Vector6d efforts = dynamic_model->calcEfforts(acceleration_6d, velocity_6d, orientation);
+    // the damping parameters, acceleration and orientation of the mean state are used for all sigma points
+    base::Vector6d efforts = effort_context.calcEfforts(*effort_models[worker], velocity_6d);
 
     // returns the expected forces and torques given the current state
     return efforts;
 }
 
-//functions for innovation gate test, using mahalanobis distance
-template <typename scalar_type>
-static bool d2p99(const scalar_type &mahalanobis2)
+/* Stacks the expected measurements of all queued measurements in the order velocity, acceleration, z and xy position */
+template <typename FilterState>
+Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, 1, 0, PoseUKF::MeasurementBatch::MAX_ROWS, 1>
+measurementBatch(const FilterState &state, const PoseUKF::MeasurementBatch& batch)
 {
-    if(mahalanobis2>9.21) // for 2 degrees of freedom, 99% likelihood = 9.21, https://www.uam.es/personal_pdi/ciencias/anabz/Prest/Trabajos/Critical_Values_of_the_Chi-Squared_Distribution.pdf
+    Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, 1, 0, PoseUKF::MeasurementBatch::MAX_ROWS, 1> expected_measurement;
+    expected_measurement.resize(PoseUKF::MeasurementBatch::MAX_ROWS);
+    int rows = 0;
+    if(batch.has_velocity)
     {
-        return false;
+        expected_measurement.segment<3>(rows) = measurementVelocity(state);
+        rows += 3;
     }
-    else
+    if(batch.has_acceleration)
     {
-        return true;
+        expected_measurement.segment<3>(rows) = measurementAcceleration(state);
+        rows += 3;
     }
-}
-
-template <typename scalar_type>
-static bool d2p95(const scalar_type &mahalanobis2)
-{
-    if(mahalanobis2>5.991) // for 2 degrees of freedom, 95% likelihood = 5.991, https://www.uam.es/personal_pdi/ciencias/anabz/Prest/Trabajos/Critical_Values_of_the_Chi-Squared_Distribution.pdf
+    if(batch.has_z_position)
     {
-        return false;
+        expected_measurement.segment<1>(rows) = measurementZPosition(state);
+        rows += 1;
     }
-    else
+    if(batch.has_xy_position)
     {
-        return true;
+        expected_measurement.segment<2>(rows) = measurementXYPosition(state);
+        rows += 2;
     }
+    expected_measurement.conservativeResize(rows);
+    return expected_measurement;
 }
 
+typedef FilterInstrumentation::CallScope< SigmaPointFilter<PoseUKF::WState>::Innovation > CallScope;
+
+static const char* const channel_names[PoseUKF::CHANNEL_COUNT] = {"prediction", "full_prediction", "measurement_batch",
+    "velocity", "acceleration", "z_position", "xy_position", "geographic_position", "body_efforts", "water_velocity"};
+
 PoseUKF::PoseUKF(const State& initial_state, const Covariance& state_cov,
                 const LocationConfiguration& location, const uwv_dynamic_model::UWVParameters& model_parameters,
-                const PoseUKFParameter& filter_parameter) : filter_parameter(filter_parameter)
+                const PoseUKFParameter& filter_parameter, unsigned sigma_point_threads) : effort_model_offset(0), filter_parameter(filter_parameter), location(location),
+                earth_rotation(Eigen::Vector3d::Zero()), earth_rotation_position(Eigen::Vector2d::Zero()), exact_earth_rotation(false), earth_rotation_update_distance(0.), batch_update(false),
+                has_water_current_cell(false), filter_time(0.), process_noise_cov_factored(false), has_process_noise_cov_factor(false), batched_noise_factor(NULL), propagation_precision(DOUBLE_PRECISION), structured_prediction(false), full_prediction_period(0.), adaptive_prediction(false), dynamic_model_min_depth(0.), effort_update_scheduling(false), effort_update_decimation(0),
+                time_since_velocity_update(std::numeric_limits<double>::infinity()), full_prediction_count(0), pending_delta_t(0.), pending_delta_t2(0.), state_revision(0), smoother(NULL)
 {
     initializeFilter(initial_state, state_cov);
 
     rotation_rate = RotationRate::Mu::Zero();
 
-    dynamic_model.reset(new uwv_dynamic_model::DynamicModel());
-    dynamic_model->setUWVParameters(model_parameters);
+    if(sigma_point_threads > 1)
+        thread_pool.reset(new ThreadPool(sigma_point_threads));
+    sigma_point_filter.reset(new SigmaPointFilter<WState>(thread_pool));
+    instrumentation.reset(new FilterInstrumentation(channel_names, CHANNEL_COUNT));
+    sigma_point_filter->setInstrumentation(instrumentation.get());
+
+    // each worker evaluates the motion model on its own instance
+    boost::shared_ptr<EffortModels> models(new EffortModels());
+    for(unsigned i = 0; i < sigma_point_filter->getWorkerCount(); i++)
+        models->push_back(boost::shared_ptr<EffortModel>(new EffortModel(model_parameters)));
+    effort_models = models;
+    velocity_effort_context.reset(new EffortContext());
+    imu_preintegration.reset(new ImuPreintegration());
+    pending_rotation.reset(new ImuPreintegration());
 
     inertia_offset = Eigen::Map< const InertiaType::vectorized_type >(initial_state.inertia.data());
     lin_damping_offset = Eigen::Map< const LinDampingType::vectorized_type >(initial_state.lin_damping.data());
     quad_damping_offset = Eigen::Map< const QuadDampingType::vectorized_type >(initial_state.quad_damping.data());
 
     projection.reset(new pose_estimation::GeographicProjection(location.latitude, location.longitude));
+    updateEarthRotation(true);
+
+    setInnovationGates(InnovationGateParameters());
+}
+
+PoseUKF::PoseUKF(const State& initial_state, const Covariance& state_cov, const PoseUKFConfig& config,
+                 const uwv_dynamic_model::UWVParameters& model_parameters, const Eigen::Vector3d& imu_in_body,
+                 double imu_delta_t, unsigned sigma_point_threads) :
+                 PoseUKF(initial_state, state_cov, config.location, model_parameters, filterParameter(config, imu_in_body), sigma_point_threads)
+{
+    setProcessNoiseCovariance(processNoise(config, imu_delta_t));
+    setInnovationGates(config.innovation_gates);
+    setSigmaPointScheme(config.sigma_points);
+    setDynamicModelMinDepth(config.dynamic_model_min_depth);
+}
+
+PoseUKF::PoseUKFParameter PoseUKF::filterParameter(const PoseUKFConfig& config, const Eigen::Vector3d& imu_in_body)
+{
+    PoseUKFParameter filter_parameter;
+    filter_parameter.imu_in_body = imu_in_body;
+    filter_parameter.gyro_bias_tau = config.rotation_rate.bias_tau;
+    filter_parameter.acc_bias_tau = config.acceleration.bias_tau;
+    filter_parameter.inertia_tau = config.model_noise_parameters.inertia_tau;
+    filter_parameter.lin_damping_tau = config.model_noise_parameters.lin_damping_tau;
+    filter_parameter.quad_damping_tau = config.model_noise_parameters.quad_damping_tau;
+    filter_parameter.water_velocity_tau = config.water_velocity.tau;
+    filter_parameter.water_velocity_limits = config.water_velocity.limits;
+    filter_parameter.water_velocity_scale = config.water_velocity.scale;
+    filter_parameter.adcp_bias_tau = config.water_velocity.adcp_bias_tau;
+    return filter_parameter;
+}
+
+PoseUKF::Covariance PoseUKF::processNoise(const PoseUKFConfig& config, double imu_delta_t)
+{
+    if(!(imu_delta_t > 0.))
+        throw std::invalid_argument("The period of the inertial measurements must be positive");
+
+    // the first order Markov processes are driven with the noise keeping their instability as steady state deviation
+    Covariance process_noise = Covariance::Zero();
+    MTK::subblock(process_noise, &State::position) = 0.0001 * Eigen::Matrix3d::Identity();
+    MTK::subblock(process_noise, &State::orientation) = config.rotation_rate.randomwalk.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::velocity) = config.acceleration.randomwalk.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::acceleration) = config.max_jerk.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::bias_gyro) = (2. / (config.rotation_rate.bias_tau * imu_delta_t)) *
+                                        config.rotation_rate.bias_instability.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::bias_acc) = (2. / (config.acceleration.bias_tau * imu_delta_t)) *
+                                        config.acceleration.bias_instability.cwiseAbs2().asDiagonal();
+    MTK::setDiagonal(process_noise, &State::gravity, 1e-12);
+    MTK::subblock(process_noise, &State::inertia) = (2. / (config.model_noise_parameters.inertia_tau * imu_delta_t)) *
+                                        config.model_noise_parameters.inertia_instability.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::lin_damping) = (2. / (config.model_noise_parameters.lin_damping_tau * imu_delta_t)) *
+                                        config.model_noise_parameters.lin_damping_instability.cwiseAbs2().asDiagonal();
+    MTK::subblock(process_noise, &State::quad_damping) = (2. / (config.model_noise_parameters.quad_damping_tau * imu_delta_t)) *
+                                        config.model_noise_parameters.quad_damping_instability.cwiseAbs2().asDiagonal();
+    MTK::setDiagonal(process_noise, &State::water_velocity, (2. / (config.water_velocity.tau * imu_delta_t)) *
+                                        config.water_velocity.limits * config.water_velocity.limits);
+    MTK::setDiagonal(process_noise, &State::water_velocity_below, (2. / (config.water_velocity.tau * imu_delta_t)) *
+                                        config.water_velocity.limits * config.water_velocity.limits);
+    MTK::setDiagonal(process_noise, &State::bias_adcp, (2. / (config.water_velocity.adcp_bias_tau * imu_delta_t)) *
+                                        config.water_velocity.adcp_bias_limits * config.water_velocity.adcp_bias_limits);
+    return process_noise;
+}
+
+void PoseUKF::setFilterBackend(FilterBackend backend)
+{
+    sigma_point_filter->setBackend(backend);
+}
+
+void PoseUKF::setSigmaPointScheme(const SigmaPointParameters& parameters)
+{
+    sigma_point_filter->setScheme(parameters);
+}
+
+FilterStatistics PoseUKF::getStatistics() const
+{
+    return instrumentation->getStatistics();
+}
+
+void PoseUKF::setInnovationGates(const InnovationGateParameters& parameters)
+{
+    gates.velocity = InnovationGate(Velocity::Mu::RowsAtCompileTime, parameters.velocity);
+    gates.acceleration = InnovationGate(Acceleration::Mu::RowsAtCompileTime, parameters.acceleration);
+    gates.z_position = InnovationGate(Z_Position::Mu::RowsAtCompileTime, parameters.z_position);
+    gates.xy_position = InnovationGate(XY_Position::Mu::RowsAtCompileTime, parameters.xy_position);
+    gates.geographic_position = InnovationGate(GeographicPosition::Mu::RowsAtCompileTime, parameters.geographic_position);
+    gates.body_efforts = InnovationGate(BodyEffortsMeasurement::Mu::RowsAtCompileTime, parameters.body_efforts);
+    gates.water_velocity = InnovationGate(WaterVelocityMeasurement::Mu::RowsAtCompileTime, parameters.water_velocity);
+}
+
+void PoseUKF::setEffortModelTolerance(double tolerance)
+{
+    velocity_effort_context->setTolerance(tolerance);
+}
+
+void PoseUKF::setEffortModels(const boost::shared_ptr<const EffortModels>& models, unsigned offset)
+{
+    if(!models || models->size() < offset + sigma_point_filter->getWorkerCount())
+        throw std::invalid_argument("There are less shared effort models than workers of the sigma points");
+    effort_models = models;
+    effort_model_offset = offset;
+}
+
+void PoseUKF::setEffortModelOffset(unsigned offset)
+{
+    if(effort_models->size() < offset + sigma_point_filter->getWorkerCount())
+        throw std::invalid_argument("There are less shared effort models than workers of the sigma points");
+    effort_model_offset = offset;
+}
+
+void PoseUKF::setExactEarthRotation(bool exact)
+{
+    exact_earth_rotation = exact;
+}
+
+void PoseUKF::setEarthRotationUpdateDistance(double distance)
+{
+    earth_rotation_update_distance = std::max(distance, 0.);
+    updateEarthRotation(true);
+}
+
+double PoseUKF::getEarthRotationErrorBound() const
+{
+    if(exact_earth_rotation)
+        return 0.;
+
+    // the sigma points are spread at most by the square root of the trace of the horizontal position covariance
+    double sigma_point_spread = sqrt(ukf->sigma().block(MTK::getStartIdx(&State::position), MTK::getStartIdx(&State::position), 2, 2).trace());
+    double distance = (ukf->mu().position.head<2>() - earth_rotation_position).norm() + sigma_point_spread;
+
+    // |w(lat_a) - w(lat_b)| = 2 * EARTHW * |sin((lat_a - lat_b)/2)| <= EARTHW * |lat_a - lat_b|
+    return pose_estimation::EARTHW * distance / EARTH_MERIDIAN_RADIUS_MIN;
+}
+
+void PoseUKF::setInnovationLikelihood(bool enabled)
+{
+    sigma_point_filter->setLikelihoodEnabled(enabled);
+}
+
+const SigmaPointFilter<PoseUKF::WState>::Innovation& PoseUKF::getLastInnovation() const
+{
+    return sigma_point_filter->getLastInnovation();
+}
+
+void PoseUKF::updateEarthRotation(bool force)
+{
+    Eigen::Vector2d position = ukf->mu().position.head<2>();
+    if(force || earth_rotation_update_distance <= 0. ||
+        (position - earth_rotation_position).norm() > earth_rotation_update_distance)
+    {
+        const Eigen::Vector3d rotation = earthRotation(*projection, ukf->mu().position);
+        if(rotation != earth_rotation)
+        {
+            earth_rotation = rotation;
+            state_revision++;
+        }
+        earth_rotation_position = position;
+    }
+}
+
+
+void PoseUKF::setSmoother(PoseUKFSmoother* smoother)
+{
+    this->smoother = smoother;
+    sigma_point_filter->setCrossCovarianceEnabled(smoother != NULL);
+}
+
+void PoseUKF::setStructuredPrediction(bool structured)
+{
+    structured_prediction = structured;
+}
+
+void PoseUKF::setWaterCurrentMap(const boost::shared_ptr<WaterCurrentMap>& map)
+{
+    water_current_map = map;
+    has_water_current_cell = false;
+}
+
+void PoseUKF::updateWaterCurrentCell()
+{
+    if(!water_current_map)
+        return;
+
+    const WaterCurrentMap::Key key = water_current_map->getKey(ukf->mu().position);
+    if(has_water_current_cell && key == water_current_cell)
+        return;
+
+    if(has_water_current_cell)
+    {
+        WaterCurrentCell cell;
+        cell.water_velocity = ukf->mu().water_velocity;
+        cell.water_velocity_below = ukf->mu().water_velocity_below;
+        cell.cov << MTK::subblock(ukf->sigma(), &State::water_velocity), MTK::subblock(ukf->sigma(), &State::water_velocity, &State::water_velocity_below),
+                    MTK::subblock(ukf->sigma(), &State::water_velocity_below, &State::water_velocity), MTK::subblock(ukf->sigma(), &State::water_velocity_below);
+        cell.time = filter_time;
+        water_current_map->store(water_current_cell, cell);
+    }
+    water_current_cell = key;
+    has_water_current_cell = true;
+
+    // estimates stored after the current time were discarded by restoring an older state
+    const WaterCurrentCell* cell = water_current_map->find(key);
+    if(!cell || cell->time > filter_time)
+        return;
+
+    // revisited cell, the stored estimate decays towards zero with the time since it was stored
+    const double decay = std::exp(-(filter_time - cell->time) / filter_parameter.water_velocity_tau);
+    const Eigen::Matrix4d cell_cov = decay * decay * cell->cov + (1. - decay * decay) *
+                                     filter_parameter.water_velocity_limits * filter_parameter.water_velocity_limits * Eigen::Matrix4d::Identity();
+    WState mu = ukf->mu();
+    Covariance sigma = ukf->sigma();
+    mu.water_velocity = decay * cell->water_velocity;
+    mu.water_velocity_below = decay * cell->water_velocity_below;
+    const int indices[2] = { MTK::getStartIdx(&State::water_velocity), MTK::getStartIdx(&State::water_velocity_below) };
+    for(unsigned i = 0; i < 2; i++)
+    {
+        sigma.middleRows<WaterVelocityType::DOF>(indices[i]).setZero();
+        sigma.middleCols<WaterVelocityType::DOF>(indices[i]).setZero();
+    }
+    MTK::subblock(sigma, &State::water_velocity) = cell_cov.topLeftCorner<2,2>();
+    MTK::subblock(sigma, &State::water_velocity, &State::water_velocity_below) = cell_cov.topRightCorner<2,2>();
+    MTK::subblock(sigma, &State::water_velocity_below, &State::water_velocity) = cell_cov.bottomLeftCorner<2,2>();
+    MTK::subblock(sigma, &State::water_velocity_below) = cell_cov.bottomRightCorner<2,2>();
+    *ukf = MTK_UKF(mu, sigma);
+    state_revision++;
+}
+
+void PoseUKF::setFullPredictionPeriod(double period)
+{
+    flushPrediction();
+    full_prediction_period = std::max(period, 0.);
 }
 
+void PoseUKF::setDynamicModelMinDepth(double min_depth)
+{
+    dynamic_model_min_depth = min_depth;
+}
+
+void PoseUKF::enableEffortUpdateScheduling(const EffortUpdateSchedulingParameters& parameters)
+{
+    if(parameters.velocity_timeout < 0. || parameters.max_velocity_std < 0.)
+        throw std::invalid_argument("The velocity timeout and standard deviation of the effort update scheduling must not be negative");
+    effort_update_scheduling = true;
+    effort_update_scheduling_parameters = parameters;
+    effort_update_decimation = 0;
+}
+
+void PoseUKF::disableEffortUpdateScheduling()
+{
+    effort_update_scheduling = false;
+}
+
+bool PoseUKF::scheduleEffortUpdate()
+{
+    if(effort_update_scheduling)
+    {
+        const EffortUpdateSchedulingParameters& parameters = effort_update_scheduling_parameters;
+
+        // the dynamic model is not applied near the surface
+        if(-ukf->mu().position.z() < dynamic_model_min_depth)
+        {
+            effort_update_statistics.skipped_surface++;
+            return false;
+        }
+
+        // the model aiding hardly improves a velocity constrained by the DVL,
+        // during drop-outs of the bottom lock every update is applied
+        const bool bottom_lock = time_since_velocity_update <= parameters.velocity_timeout;
+        const int velocity_index = MTK::getStartIdx(&State::velocity);
+        const double max_velocity_var = ukf->sigma().block<3,3>(velocity_index, velocity_index).diagonal().maxCoeff();
+        if(bottom_lock && max_velocity_var <= parameters.max_velocity_std * parameters.max_velocity_std)
+        {
+            if(parameters.decimation == 0 || ++effort_update_decimation < parameters.decimation)
+            {
+                effort_update_statistics.skipped_decimated++;
+                return false;
+            }
+        }
+        effort_update_decimation = 0;
+    }
+    effort_update_statistics.applied++;
+    return true;
+}
+
+void PoseUKF::enableAdaptivePrediction(const AdaptivePredictionParameters& parameters)
+{
+    if(!(parameters.min_period > 0.) || parameters.max_period < parameters.min_period)
+        throw std::invalid_argument("Adaptive prediction requires 0 < min_period <= max_period");
+    flushPrediction();
+    adaptive_prediction = true;
+    adaptive_prediction_parameters = parameters;
+}
+
+void PoseUKF::disableAdaptivePrediction()
+{
+    flushPrediction();
+    adaptive_prediction = false;
+}
+
+double PoseUKF::adaptivePredictionPeriod() const
+{
+    const AdaptivePredictionParameters& parameters = adaptive_prediction_parameters;
+    const State& mean = ukf->mu();
+    double period = parameters.max_period;
+    const double rotation = (rotation_rate - mean.bias_gyro).norm();
+    if(rotation * period > parameters.max_rotation_step)
+        period = parameters.max_rotation_step / rotation;
+    const double acceleration = Eigen::Vector3d(mean.acceleration).norm();
+    if(acceleration * period > parameters.max_velocity_step)
+        period = parameters.max_velocity_step / acceleration;
+    const double velocity = Eigen::Vector3d(mean.velocity).norm();
+    if(velocity * period > parameters.max_position_step)
+        period = parameters.max_position_step / velocity;
+    return std::max(period, parameters.min_period);
+}
 
 void PoseUKF::predictionStepImpl(double delta_t)
 {
-    Eigen::Matrix3d rot = ukf->mu().orientation.matrix();
-    Covariance process_noise = process_noise_cov;
+    CallScope scope(instrumentation.get(), PREDICTION_CHANNEL, sigma_point_filter->getLastInnovation());
+    time_since_velocity_update += delta_t;
+    const double period = adaptive_prediction ? adaptivePredictionPeriod() : full_prediction_period;
+    if(period <= 0.)
+    {
+        fullPredictionStep(delta_t, delta_t * delta_t);
+        return;
+    }
+
+    // aggressive motion, the step is split into sub-steps
+    // pre-integrated samples cover the whole step and are consumed at once
+    if(adaptive_prediction && delta_t > period && imu_preintegration->getSampleCount() == 0)
+    {
+        flushPrediction();
+        const int steps = int(std::ceil(delta_t / period));
+        const double step = delta_t / steps;
+        for(int i = 0; i < steps; i++)
+            fullPredictionStep(step, step * step);
+        return;
+    }
+
+    // the fast pose starts from the mean of the last full prediction or update
+    if(pending_delta_t <= 0.)
+    {
+        fast_pose = getFastPose();
+        pending_delta_t2 = 0.;
+        pending_rotation->reset(ukf->mu().bias_gyro);
+    }
+    propagateFastPose(fast_pose, delta_t);
+    pending_delta_t += delta_t;
+    pending_delta_t2 += delta_t * delta_t;
+    // the rotation rate of each merged step is kept, the specific force is not used
+    pending_rotation->integrate(rotation_rate, Eigen::Vector3d::Zero(), Eigen::Matrix3d::Zero(), delta_t);
+
+    if(pending_delta_t >= period)
+        flushPrediction();
+}
+
+void PoseUKF::flushPrediction()
+{
+    if(pending_delta_t <= 0.)
+        return;
+
+    const double delta_t = pending_delta_t;
+    pending_delta_t = 0.;
+    fullPredictionStep(delta_t, pending_delta_t2, pending_rotation.get());
+}
+
+PoseUKF::FastPose PoseUKF::getFastPose(double extrapolation) const
+{
+    FastPose pose;
+    if(pending_delta_t > 0.)
+        pose = fast_pose;
+    else
+    {
+        pose.position = ukf->mu().position;
+        pose.orientation = ukf->mu().orientation;
+        pose.velocity = ukf->mu().velocity;
+    }
+    if(extrapolation > 0.)
+        propagateFastPose(pose, extrapolation);
+    return pose;
+}
+
+void PoseUKF::propagateFastPose(FastPose& pose, double delta_t) const
+{
+    // same strapdown mechanization as the process model, using the estimated biases and acceleration
+    const State& mean = ukf->mu();
+    pose.position += delta_t * pose.velocity;
+    Eigen::Vector3d angular_velocity = pose.orientation * (rotation_rate - mean.bias_gyro) - earth_rotation;
+    pose.orientation = pose.orientation * Eigen::Quaterniond(Eigen::AngleAxisd(delta_t * angular_velocity.norm(),
+                            angular_velocity.norm() > 0. ? Eigen::Vector3d(angular_velocity.normalized()) : Eigen::Vector3d::UnitX()));
+    pose.velocity += delta_t * Eigen::Vector3d(mean.acceleration);
+}
+
+void PoseUKF::fullPredictionStep(double delta_t, double noise_delta_t2, const ImuPreintegration* merged_rotation)
+{
+    CallScope scope(instrumentation.get(), FULL_PREDICTION_CHANNEL, sigma_point_filter->getLastInnovation());
+    // the delta rotation is only valid for the interval covered by the samples, up to the resolution of a time stamp
+    const bool preintegrated = imu_preintegration->getSampleCount() > 0;
+    if(preintegrated && std::abs(imu_preintegration->getTime() - delta_t) > 1e-6)
+        throw std::runtime_error("The pre-integrated IMU samples don't cover the predicted interval");
+    const Covariance* noise_factor = prepareFullPrediction(delta_t, noise_delta_t2);
+
+    if(propagation_precision == SINGLE_PRECISION && !preintegrated && !merged_rotation &&
+       !structured_prediction && !exact_earth_rotation)
+    {
+        single_precision_batch.clear();
+        single_precision_batch.addSegment(getSigmaPointCount());
+        storeSigmaPoints(single_precision_batch, 0);
+        predictBatch(single_precision_batch, delta_t, 0, 1);
+        loadSigmaPoints(single_precision_batch, 0, noise_factor);
+        completeFullPrediction();
+        return;
+    }
+
+    // the model inputs are shared by reference between all sigma points
+    RotationInput rotation_input = { &rotation_rate, preintegrated ? imu_preintegration.get() : merged_rotation };
+    const auto process_model = boost::bind(processModel<WState>, _1, boost::cref(rotation_input), boost::cref(earth_rotation),
+                                           exact_earth_rotation ? projection.get() : NULL,
+                                           boost::cref(inertia_offset), boost::cref(lin_damping_offset),
+                                           boost::cref(quad_damping_offset), boost::cref(filter_parameter), delta_t);
+
+    if(structured_prediction)
+    {
+        // state transition factors of the first order Markov processes behind the navigation core
+        Eigen::Matrix<double, WState::DOF - NAVIGATION_CORE_DOF, 1> transition;
+        transition.segment<BiasType::DOF>(MTK::getStartIdx(&State::bias_acc) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.acc_bias_tau);
+        transition.segment<GravityType::DOF>(MTK::getStartIdx(&State::gravity) - NAVIGATION_CORE_DOF).setConstant(1.);
+        transition.segment<InertiaType::DOF>(MTK::getStartIdx(&State::inertia) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.inertia_tau);
+        transition.segment<LinDampingType::DOF>(MTK::getStartIdx(&State::lin_damping) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.lin_damping_tau);
+        transition.segment<QuadDampingType::DOF>(MTK::getStartIdx(&State::quad_damping) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.quad_damping_tau);
+        transition.segment<WaterVelocityType::DOF>(MTK::getStartIdx(&State::water_velocity) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.water_velocity_tau);
+        transition.segment<WaterVelocityType::DOF>(MTK::getStartIdx(&State::water_velocity_below) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.water_velocity_tau);
+        transition.segment<AdcpBiasType::DOF>(MTK::getStartIdx(&State::bias_adcp) - NAVIGATION_CORE_DOF).setConstant(1. - delta_t / filter_parameter.adcp_bias_tau);
+
+        sigma_point_filter->structuredPredict<NAVIGATION_CORE_DOF>(*ukf, process_model, transition, process_noise);
+    }
+    else
+        sigma_point_filter->predict(*ukf, process_model, process_noise, noise_factor);
+
+    completeFullPrediction();
+}
+
+const PoseUKF::Covariance* PoseUKF::prepareFullPrediction(double delta_t, double noise_delta_t2)
+{
+    full_prediction_count++;
+    filter_time += delta_t;
+
+    // queued measurements belong to the current epoch
+    integrateMeasurementBatch();
+
+    updateEarthRotation();
+
+    // the process noise is assembled in a pre-allocated buffer, the orientation noise
+    // is rotated to the navigation frame and the water current noise grows with the velocity.
+    // Merged steps add the noise of each step, which is linear in their number
+    process_noise.noalias() = noise_delta_t2 * process_noise_cov;
+
     // uncertainty matrix calculations
-    MTK::subblock(process_noise, &State::orientation) = rot * MTK::subblock(process_noise_cov, &State::orientation) * rot.transpose();
-    
+    const int orientation_index = MTK::getStartIdx(&State::orientation);
+    const Eigen::Matrix3d rot = ukf->mu().orientation.matrix();
+    process_noise.middleRows<3>(orientation_index) = (rot * process_noise.middleRows<3>(orientation_index)).eval();
+    process_noise.middleCols<3>(orientation_index) = (process_noise.middleCols<3>(orientation_index) * rot.transpose()).eval();
+
     Eigen::Vector3d scaled_velocity = ukf->mu().velocity;
     scaled_velocity[2] = 10*scaled_velocity[2]; // scale Z velocity to have 10x more impact
-    
-    MTK::subblock(process_noise, &State::water_velocity) = MTK::subblock(process_noise_cov, &State::water_velocity) 
-    + Eigen::Matrix<double,2,2>::Identity() * filter_parameter.water_velocity_scale * scaled_velocity.squaredNorm() * delta_t;
-    
-    MTK::subblock(process_noise, &State::water_velocity_below) = MTK::subblock(process_noise_cov, &State::water_velocity_below) 
-    + Eigen::Matrix<double,2,2>::Identity() * filter_parameter.water_velocity_scale * scaled_velocity.squaredNorm() * delta_t;
-        
-    process_noise = pow(delta_t, 2.) * process_noise;
-    
-    ukf->predict(boost::bind(processModel<WState>, _1, rotation_rate, projection,
-                            inertia_offset, lin_damping_offset, quad_damping_offset,
-                            filter_parameter, delta_t),
-                 MTK_UKF::cov(process_noise));
+    // noise_delta_t2 / delta_t is the mean interval of the merged steps
+    const double water_velocity_noise = noise_delta_t2 * filter_parameter.water_velocity_scale * scaled_velocity.squaredNorm() *
+                                        (noise_delta_t2 / delta_t);
+    MTK::subblock(process_noise, &State::water_velocity).diagonal().array() += water_velocity_noise;
+    MTK::subblock(process_noise, &State::water_velocity_below).diagonal().array() += water_velocity_noise;
+
+    // the factor of the square-root backend follows the same steps from the cached factor of the
+    // process noise covariance, rank one updates add the water current noise
+    const Covariance* noise_factor = NULL;
+    if(sigma_point_filter->getBackend() == SQUARE_ROOT_UKF && !structured_prediction)
+    {
+        if(!process_noise_cov_factored || process_noise_cov != factored_process_noise_cov)
+        {
+            has_process_noise_cov_factor = SigmaPointFilter<WState>::semidefiniteCholesky(process_noise_cov, process_noise_cov_factor);
+            factored_process_noise_cov = process_noise_cov;
+            process_noise_cov_factored = true;
+        }
+        if(has_process_noise_cov_factor)
+        {
+            process_noise_factor.noalias() = std::sqrt(noise_delta_t2) * process_noise_cov_factor;
+            const int water_indices[2] = { MTK::getStartIdx(&State::water_velocity), MTK::getStartIdx(&State::water_velocity_below) };
+            for(unsigned i = 0; i < 2 && water_velocity_noise > 0.; i++)
+            {
+                for(int j = 0; j < WaterVelocityType::DOF; j++)
+                {
+                    WState::vectorized_type x = WState::vectorized_type::Zero();
+                    x(water_indices[i] + j) = sqrt(water_velocity_noise);
+                    SigmaPointFilter<WState>::choleskyUpdate(process_noise_factor, x);
+                }
+            }
+            process_noise_factor.middleRows<3>(orientation_index) = (rot * process_noise_factor.middleRows<3>(orientation_index)).eval();
+            noise_factor = &process_noise_factor;
+        }
+    }
+
+    if(smoother)
+        smoother->beginEpoch(delta_t, ukf->mu(), ukf->sigma());
+    return noise_factor;
+}
+
+void PoseUKF::completeFullPrediction()
+{
+    if(smoother)
+        smoother->endEpoch(ukf->mu(), ukf->sigma(), sigma_point_filter->getPredictionCrossCovariance());
+
+    updateWaterCurrentCell();
+
+    if(imu_preintegration->getSampleCount() > 0)
+    {
+        // the averaged specific force is expressed in the IMU frame at the end of the interval
+        Acceleration acceleration;
+        acceleration.mu = imu_preintegration->getMeanSpecificForce();
+        acceleration.cov = imu_preintegration->getMeanSpecificForceCov();
+        imu_preintegration->reset(ukf->mu().bias_gyro);
+        integrateMeasurement(acceleration);
+    }
+}
+
+unsigned PoseUKF::getSigmaPointCount() const
+{
+    return sigma_point_filter->getSigmaPointCount();
+}
+
+template<typename Scalar>
+void PoseUKF::BasicSigmaPointBatch<Scalar>::clear()
+{
+    segments.clear();
+    columns = 0;
+}
+
+template<typename Scalar>
+unsigned PoseUKF::BasicSigmaPointBatch<Scalar>::addSegment(unsigned segment_columns)
+{
+    Segment segment;
+    segment.first_column = columns;
+    segment.columns = segment_columns;
+    segments.push_back(segment);
+    columns += segment_columns;
+    if(columns > position.cols())
+    {
+        // the capacity grows geometrically, the columns in use are kept
+        const unsigned capacity = std::max(columns, unsigned(2 * position.cols()));
+        position.conservativeResize(Eigen::NoChange, capacity);
+        orientation.conservativeResize(Eigen::NoChange, capacity);
+        velocity.conservativeResize(Eigen::NoChange, capacity);
+        acceleration.conservativeResize(Eigen::NoChange, capacity);
+        bias_gyro.conservativeResize(Eigen::NoChange, capacity);
+        bias_acc.conservativeResize(Eigen::NoChange, capacity);
+        gravity.conservativeResize(Eigen::NoChange, capacity);
+        inertia.conservativeResize(Eigen::NoChange, capacity);
+        lin_damping.conservativeResize(Eigen::NoChange, capacity);
+        quad_damping.conservativeResize(Eigen::NoChange, capacity);
+        water_velocity.conservativeResize(Eigen::NoChange, capacity);
+        water_velocity_below.conservativeResize(Eigen::NoChange, capacity);
+        bias_adcp.conservativeResize(Eigen::NoChange, capacity);
+        angular_velocity.resize(Eigen::NoChange, capacity);
+        rotated.resize(Eigen::NoChange, capacity);
+    }
+    return segments.size() - 1;
+}
+
+template<typename Scalar>
+void PoseUKF::BasicSigmaPointBatch<Scalar>::setColumn(const Segment& segment, unsigned column, const WState& state)
+{
+    const WState& o = segment.origin;
+    position.col(column) = (Eigen::Vector3d(state.position) - Eigen::Vector3d(o.position)).template cast<Scalar>();
+    orientation.col(column) = state.orientation.coeffs();
+    velocity.col(column) = (Eigen::Vector3d(state.velocity) - Eigen::Vector3d(o.velocity)).template cast<Scalar>();
+    acceleration.col(column) = (Eigen::Vector3d(state.acceleration) - Eigen::Vector3d(o.acceleration)).template cast<Scalar>();
+    bias_gyro.col(column) = (Eigen::Vector3d(state.bias_gyro) - Eigen::Vector3d(o.bias_gyro)).template cast<Scalar>();
+    bias_acc.col(column) = (Eigen::Vector3d(state.bias_acc) - Eigen::Vector3d(o.bias_acc)).template cast<Scalar>();
+    gravity.col(column) = (GravityType::vectorized_type(state.gravity) - GravityType::vectorized_type(o.gravity)).template cast<Scalar>();
+    inertia.col(column) = (Eigen::Map< const InertiaType::vectorized_type >(state.inertia.data()) -
+                           Eigen::Map< const InertiaType::vectorized_type >(o.inertia.data())).template cast<Scalar>();
+    lin_damping.col(column) = (Eigen::Map< const LinDampingType::vectorized_type >(state.lin_damping.data()) -
+                               Eigen::Map< const LinDampingType::vectorized_type >(o.lin_damping.data())).template cast<Scalar>();
+    quad_damping.col(column) = (Eigen::Map< const QuadDampingType::vectorized_type >(state.quad_damping.data()) -
+                                Eigen::Map< const QuadDampingType::vectorized_type >(o.quad_damping.data())).template cast<Scalar>();
+    water_velocity.col(column) = (Eigen::Vector2d(state.water_velocity) - Eigen::Vector2d(o.water_velocity)).template cast<Scalar>();
+    water_velocity_below.col(column) = (Eigen::Vector2d(state.water_velocity_below) - Eigen::Vector2d(o.water_velocity_below)).template cast<Scalar>();
+    bias_adcp.col(column) = (Eigen::Vector2d(state.bias_adcp) - Eigen::Vector2d(o.bias_adcp)).template cast<Scalar>();
+}
+
+template<typename Scalar>
+void PoseUKF::BasicSigmaPointBatch<Scalar>::getColumn(const Segment& segment, unsigned column, WState& state) const
+{
+    const WState& o = segment.origin;
+    state.position = Eigen::Vector3d(o.position) + position.col(column).template cast<double>();
+    state.orientation.coeffs() = orientation.col(column);
+    state.velocity = Eigen::Vector3d(o.velocity) + velocity.col(column).template cast<double>();
+    state.acceleration = Eigen::Vector3d(o.acceleration) + acceleration.col(column).template cast<double>();
+    state.bias_gyro = Eigen::Vector3d(o.bias_gyro) + bias_gyro.col(column).template cast<double>();
+    state.bias_acc = Eigen::Vector3d(o.bias_acc) + bias_acc.col(column).template cast<double>();
+    state.gravity = GravityType::vectorized_type(o.gravity) + gravity.col(column).template cast<double>();
+    Eigen::Map< InertiaType::vectorized_type >(state.inertia.data()) =
+            Eigen::Map< const InertiaType::vectorized_type >(o.inertia.data()) + inertia.col(column).template cast<double>();
+    Eigen::Map< LinDampingType::vectorized_type >(state.lin_damping.data()) =
+            Eigen::Map< const LinDampingType::vectorized_type >(o.lin_damping.data()) + lin_damping.col(column).template cast<double>();
+    Eigen::Map< QuadDampingType::vectorized_type >(state.quad_damping.data()) =
+            Eigen::Map< const QuadDampingType::vectorized_type >(o.quad_damping.data()) + quad_damping.col(column).template cast<double>();
+    state.water_velocity = Eigen::Vector2d(o.water_velocity) + water_velocity.col(column).template cast<double>();
+    state.water_velocity_below = Eigen::Vector2d(o.water_velocity_below) + water_velocity_below.col(column).template cast<double>();
+    state.bias_adcp = Eigen::Vector2d(o.bias_adcp) + bias_adcp.col(column).template cast<double>();
+}
+
+template<typename Scalar>
+bool PoseUKF::beginBatchedPrediction(double delta_t, BasicSigmaPointBatch<Scalar>& batch, unsigned segment)
+{
+    typename BasicSigmaPointBatch<Scalar>::Segment& s = batch.segments[segment];
+    if(full_prediction_period > 0. || adaptive_prediction || pending_delta_t > 0. || structured_prediction ||
+       exact_earth_rotation || imu_preintegration->getSampleCount() > 0 || s.columns != getSigmaPointCount())
+    {
+        s.columns = 0;
+        return false;
+    }
+
+    // the batched propagation is timed by the caller, the calls are counted here
+    CallScope scope(instrumentation.get(), PREDICTION_CHANNEL, sigma_point_filter->getLastInnovation());
+    CallScope full_scope(instrumentation.get(), FULL_PREDICTION_CHANNEL, sigma_point_filter->getLastInnovation());
+    time_since_velocity_update += delta_t;
+    batched_noise_factor = prepareFullPrediction(delta_t, delta_t * delta_t);
+    storeSigmaPoints(batch, segment);
+    return true;
+}
+
+template<typename Scalar>
+void PoseUKF::storeSigmaPoints(BasicSigmaPointBatch<Scalar>& batch, unsigned segment)
+{
+    typename BasicSigmaPointBatch<Scalar>::Segment& s = batch.segments[segment];
+    s.origin = ukf->mu();
+    const unsigned count = sigma_point_filter->beginPredict(*ukf);
+    const SigmaPointFilter<WState>::StateVector& X = sigma_point_filter->getSigmaPoints();
+    for(unsigned i = 0; i < count; i++)
+        batch.setColumn(s, s.first_column + i, X[i]);
+    s.rotation_rate = rotation_rate;
+    s.earth_rotation = earth_rotation;
+    s.inertia_offset = inertia_offset;
+    s.lin_damping_offset = lin_damping_offset;
+    s.quad_damping_offset = quad_damping_offset;
+    s.filter_parameter = filter_parameter;
+}
+
+/* First order Markov processes of the states, as in processModel */
+template<typename Matrix, typename Scalar>
+static void decay(Matrix&& x, Scalar delta_t, Scalar tau)
+{
+    x += delta_t * ((Scalar(-1.0)/tau) * x);
+}
+
+template<typename Matrix, typename Offset, typename Scalar>
+static void decay(Matrix&& x, const Offset& offset, Scalar delta_t, Scalar tau)
+{
+    x += delta_t * ((Scalar(-1.0)/tau) * (x.colwise() - offset));
+}
+
+template<typename Scalar>
+void PoseUKF::predictBatch(BasicSigmaPointBatch<Scalar>& batch, double delta_t, unsigned first_segment, unsigned end_segment)
+{
+    typedef typename BasicSigmaPointBatch<Scalar>::Segment Segment;
+    typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+    const Scalar dt = delta_t;
+
+    // the same steps as processModel. The deviations from the origin are propagated in the scalar type,
+    // the origin itself in double precision. The process model is linear in all states but the orientation,
+    // whose propagation only depends on the deviations through the angular velocity
+    for(unsigned k = first_segment; k < end_segment; k++)
+    {
+        Segment& s = batch.segments[k];
+        const unsigned f = s.first_column;
+        const unsigned n = s.columns;
+        if(n == 0)
+            continue;
+        const PoseUKFParameter& parameter = s.filter_parameter;
+        WState& o = s.origin;
+
+        // angular velocity q * (rotation_rate - bias_gyro) - earth_rotation, the rotation of the vector
+        // is the one of Eigen::Quaternion: v + w * uv + u x uv, with uv = 2 * u x v
+        const auto u = batch.orientation.block(0, f, 3, n).template cast<Scalar>();
+        const auto w = batch.orientation.block(3, f, 1, n).template cast<Scalar>();
+        auto v = batch.angular_velocity.middleCols(f, n);
+        auto uv = batch.rotated.middleCols(f, n);
+        const Vector3 unbiased_rotation_rate = (s.rotation_rate - Eigen::Vector3d(o.bias_gyro)).template cast<Scalar>();
+        v = unbiased_rotation_rate.replicate(1, n) - batch.bias_gyro.middleCols(f, n);
+        uv.row(0) = u.row(1).cwiseProduct(v.row(2)) - u.row(2).cwiseProduct(v.row(1));
+        uv.row(1) = u.row(2).cwiseProduct(v.row(0)) - u.row(0).cwiseProduct(v.row(2));
+        uv.row(2) = u.row(0).cwiseProduct(v.row(1)) - u.row(1).cwiseProduct(v.row(0));
+        uv += uv;
+        v.row(0) = (v.row(0) + w.cwiseProduct(uv.row(0))) + (u.row(1).cwiseProduct(uv.row(2)) - u.row(2).cwiseProduct(uv.row(1)));
+        v.row(1) = (v.row(1) + w.cwiseProduct(uv.row(1))) + (u.row(2).cwiseProduct(uv.row(0)) - u.row(0).cwiseProduct(uv.row(2)));
+        v.row(2) = (v.row(2) + w.cwiseProduct(uv.row(2))) + (u.row(0).cwiseProduct(uv.row(1)) - u.row(1).cwiseProduct(uv.row(0)));
+        v.colwise() -= s.earth_rotation.template cast<Scalar>();
+
+        // apply velocity
+        o.position = Eigen::Vector3d(o.position) + delta_t * Eigen::Vector3d(o.velocity);
+        batch.position.middleCols(f, n) += dt * batch.velocity.middleCols(f, n);
+
+        // apply angular velocity, the exponential map is the one of the rotation type
+        RotationType orientation;
+        for(unsigned i = f; i < f + n; i++)
+        {
+            orientation.coeffs() = batch.orientation.col(i);
+            const Eigen::Vector3d angular_velocity = batch.angular_velocity.col(i).template cast<double>();
+            orientation.boxplus(angular_velocity, delta_t);
+            batch.orientation.col(i) = orientation.coeffs();
+        }
+
+        // apply acceleration
+        o.velocity = Eigen::Vector3d(o.velocity) + delta_t * Eigen::Vector3d(o.acceleration);
+        batch.velocity.middleCols(f, n) += dt * batch.acceleration.middleCols(f, n);
+
+        // first order Markov processes of the biases, the model parameters and the water currents,
+        // the deviations decay without offset
+        decay(Eigen::Map<Eigen::Vector3d>(o.bias_gyro.data()), delta_t, parameter.gyro_bias_tau);
+        decay(Eigen::Map<Eigen::Vector3d>(o.bias_acc.data()), delta_t, parameter.acc_bias_tau);
+        decay(Eigen::Map<InertiaType::vectorized_type>(o.inertia.data()), s.inertia_offset, delta_t, parameter.inertia_tau);
+        decay(Eigen::Map<LinDampingType::vectorized_type>(o.lin_damping.data()), s.lin_damping_offset, delta_t, parameter.lin_damping_tau);
+        decay(Eigen::Map<QuadDampingType::vectorized_type>(o.quad_damping.data()), s.quad_damping_offset, delta_t, parameter.quad_damping_tau);
+        decay(Eigen::Map<Eigen::Vector2d>(o.water_velocity.data()), delta_t, parameter.water_velocity_tau);
+        decay(Eigen::Map<Eigen::Vector2d>(o.water_velocity_below.data()), delta_t, parameter.water_velocity_tau);
+        decay(Eigen::Map<Eigen::Vector2d>(o.bias_adcp.data()), delta_t, parameter.adcp_bias_tau);
+
+        decay(batch.bias_gyro.middleCols(f, n), dt, Scalar(parameter.gyro_bias_tau));
+        decay(batch.bias_acc.middleCols(f, n), dt, Scalar(parameter.acc_bias_tau));
+        decay(batch.inertia.middleCols(f, n), dt, Scalar(parameter.inertia_tau));
+        decay(batch.lin_damping.middleCols(f, n), dt, Scalar(parameter.lin_damping_tau));
+        decay(batch.quad_damping.middleCols(f, n), dt, Scalar(parameter.quad_damping_tau));
+        decay(batch.water_velocity.middleCols(f, n), dt, Scalar(parameter.water_velocity_tau));
+        decay(batch.water_velocity_below.middleCols(f, n), dt, Scalar(parameter.water_velocity_tau));
+        decay(batch.bias_adcp.middleCols(f, n), dt, Scalar(parameter.adcp_bias_tau));
+    }
+}
+
+template<typename Scalar>
+void PoseUKF::commitBatchedPrediction(const BasicSigmaPointBatch<Scalar>& batch, unsigned segment)
+{
+    loadSigmaPoints(batch, segment, batched_noise_factor);
+    completeFullPrediction();
+}
+
+template<typename Scalar>
+void PoseUKF::loadSigmaPoints(const BasicSigmaPointBatch<Scalar>& batch, unsigned segment, const Covariance* noise_factor)
+{
+    const typename BasicSigmaPointBatch<Scalar>::Segment& s = batch.segments[segment];
+    SigmaPointFilter<WState>::StateVector& X = sigma_point_filter->getSigmaPoints();
+    for(unsigned i = 0; i < s.columns; i++)
+        batch.getColumn(s, s.first_column + i, X[i]);
+    sigma_point_filter->endPredict(*ukf, process_noise, noise_factor);
+}
+
+template struct PoseUKF::BasicSigmaPointBatch<double>;
+template struct PoseUKF::BasicSigmaPointBatch<float>;
+template bool PoseUKF::beginBatchedPrediction(double, SigmaPointBatch&, unsigned);
+template bool PoseUKF::beginBatchedPrediction(double, SinglePrecisionSigmaPointBatch&, unsigned);
+template void PoseUKF::predictBatch(SigmaPointBatch&, double, unsigned, unsigned);
+template void PoseUKF::predictBatch(SinglePrecisionSigmaPointBatch&, double, unsigned, unsigned);
+template void PoseUKF::commitBatchedPrediction(const SigmaPointBatch&, unsigned);
+template void PoseUKF::commitBatchedPrediction(const SinglePrecisionSigmaPointBatch&, unsigned);
+
+void PoseUKF::setPropagationPrecision(PropagationPrecision precision)
+{
+    flushPrediction();
+    propagation_precision = precision;
+}
+
+void PoseUKF::saveCheckpoint(Checkpoint& checkpoint)
+{
+    flushPrediction();
+    checkpoint.mu = ukf->mu();
+    checkpoint.sigma = ukf->sigma();
+    checkpoint.rotation_rate = rotation_rate;
+    checkpoint.earth_rotation = earth_rotation;
+    checkpoint.earth_rotation_position = earth_rotation_position;
+    checkpoint.time_since_velocity_update = time_since_velocity_update;
+    checkpoint.effort_update_decimation = effort_update_decimation;
+    checkpoint.effort_update_statistics = effort_update_statistics;
+    checkpoint.water_current_cell = water_current_cell;
+    checkpoint.has_water_current_cell = has_water_current_cell;
+    checkpoint.filter_time = filter_time;
+}
+
+void PoseUKF::restoreCheckpoint(const Checkpoint& checkpoint)
+{
+    *ukf = MTK_UKF(checkpoint.mu, checkpoint.sigma);
+    rotation_rate = checkpoint.rotation_rate;
+    earth_rotation = checkpoint.earth_rotation;
+    earth_rotation_position = checkpoint.earth_rotation_position;
+    time_since_velocity_update = checkpoint.time_since_velocity_update;
+    effort_update_decimation = checkpoint.effort_update_decimation;
+    effort_update_statistics = checkpoint.effort_update_statistics;
+    water_current_cell = checkpoint.water_current_cell;
+    has_water_current_cell = checkpoint.has_water_current_cell;
+    filter_time = checkpoint.filter_time;
+    measurement_batch.clear();
+    pending_delta_t = 0.;
+    imu_preintegration->reset(ukf->mu().bias_gyro);
+    state_revision++;
+    if(smoother)
+        smoother->restart();
+}
+
+void PoseUKF::saveSnapshot(PoseUKFSnapshot& snapshot, const base::Time& time)
+{
+    Checkpoint checkpoint;
+    saveCheckpoint(checkpoint);
+
+    snapshot.time = time.toMicroseconds();
+    Eigen::Map<WState::vectorized_type>(snapshot.state) = checkpoint.mu - WState();
+    Eigen::Map< Eigen::Matrix<double, WState::DOF, WState::DOF, Eigen::RowMajor> >(snapshot.cov) = checkpoint.sigma;
+    Eigen::Map<InertiaType::vectorized_type>(snapshot.inertia_offset) = inertia_offset;
+    Eigen::Map<LinDampingType::vectorized_type>(snapshot.lin_damping_offset) = lin_damping_offset;
+    Eigen::Map<QuadDampingType::vectorized_type>(snapshot.quad_damping_offset) = quad_damping_offset;
+    Eigen::Map<Eigen::Vector3d>(snapshot.rotation_rate) = checkpoint.rotation_rate;
+    Eigen::Map<Eigen::Vector3d>(snapshot.earth_rotation) = checkpoint.earth_rotation;
+    Eigen::Map<Eigen::Vector2d>(snapshot.earth_rotation_position) = checkpoint.earth_rotation_position;
+    snapshot.location = location;
+    snapshot.seal();
+}
+
+void PoseUKF::restoreSnapshot(const PoseUKFSnapshot& snapshot)
+{
+    if(!snapshot.isValid())
+        throw std::invalid_argument("Invalid PoseUKF snapshot");
+
+    Checkpoint checkpoint;
+    checkpoint.mu = WState() + WState::vectorized_type(Eigen::Map<const WState::vectorized_type>(snapshot.state));
+    checkpoint.sigma = Eigen::Map< const Eigen::Matrix<double, WState::DOF, WState::DOF, Eigen::RowMajor> >(snapshot.cov);
+    checkpoint.rotation_rate = Eigen::Map<const Eigen::Vector3d>(snapshot.rotation_rate);
+    checkpoint.earth_rotation = Eigen::Map<const Eigen::Vector3d>(snapshot.earth_rotation);
+    checkpoint.earth_rotation_position = Eigen::Map<const Eigen::Vector2d>(snapshot.earth_rotation_position);
+    // the snapshot resumes without bottom lock and water current cell, the statistics are continued
+    checkpoint.effort_update_statistics = effort_update_statistics;
+    checkpoint.filter_time = filter_time;
+    inertia_offset = Eigen::Map<const InertiaType::vectorized_type>(snapshot.inertia_offset);
+    lin_damping_offset = Eigen::Map<const LinDampingType::vectorized_type>(snapshot.lin_damping_offset);
+    quad_damping_offset = Eigen::Map<const QuadDampingType::vectorized_type>(snapshot.quad_damping_offset);
+
+    location = snapshot.location;
+    projection.reset(new pose_estimation::GeographicProjection(location.latitude, location.longitude));
+    restoreCheckpoint(checkpoint);
+}
+
+void PoseUKF::beginUpdate()
+{
+    batch_update = true;
+}
+
+void PoseUKF::commitUpdate()
+{
+    integrateMeasurementBatch();
+    batch_update = false;
+}
+
+void PoseUKF::integrateMeasurementBatch()
+{
+    CallScope scope(instrumentation.get(), MEASUREMENT_BATCH_CHANNEL, sigma_point_filter->getLastInnovation());
+    if(measurement_batch.empty())
+        return;
+
+    typedef SigmaPointFilter<WState>::MeasurementBlock MeasurementBlock;
+    Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, 1, 0, MeasurementBatch::MAX_ROWS, 1> z(int(MeasurementBatch::MAX_ROWS));
+    Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, Eigen::Dynamic, 0, MeasurementBatch::MAX_ROWS, MeasurementBatch::MAX_ROWS> R;
+    R.setZero(MeasurementBatch::MAX_ROWS, MeasurementBatch::MAX_ROWS);
+    MeasurementBlock blocks[4];
+    bool block_accepted[4];
+    unsigned block_count = 0;
+    int rows = 0;
+    if(measurement_batch.has_velocity)
+    {
+        z.segment<3>(rows) = measurement_batch.velocity.mu;
+        R.block<3,3>(rows, rows) = measurement_batch.velocity.cov;
+        MeasurementBlock block = {3, gates.velocity.getThreshold()};
+        blocks[block_count++] = block;
+        rows += 3;
+    }
+    if(measurement_batch.has_acceleration)
+    {
+        z.segment<3>(rows) = measurement_batch.acceleration.mu;
+        R.block<3,3>(rows, rows) = measurement_batch.acceleration.cov;
+        MeasurementBlock block = {3, gates.acceleration.getThreshold()};
+        blocks[block_count++] = block;
+        rows += 3;
+    }
+    if(measurement_batch.has_z_position)
+    {
+        z.segment<1>(rows) = measurement_batch.z_position.mu;
+        R.block<1,1>(rows, rows) = measurement_batch.z_position.cov;
+        MeasurementBlock block = {1, gates.z_position.getThreshold()};
+        blocks[block_count++] = block;
+        rows += 1;
+    }
+    if(measurement_batch.has_xy_position)
+    {
+        z.segment<2>(rows) = measurement_batch.xy_position.mu;
+        R.block<2,2>(rows, rows) = measurement_batch.xy_position.cov;
+        MeasurementBlock block = {2, gates.xy_position.getThreshold()};
+        blocks[block_count++] = block;
+        rows += 2;
+    }
+    z.conservativeResize(rows);
+    R.conservativeResize(rows, rows);
+
+    sigma_point_filter->stackedUpdate(*ukf, z, boost::bind(measurementBatch<State>, _1, boost::cref(measurement_batch)),
+                                      R, blocks, block_count, false, block_accepted);
+    // the velocity is the first block of the stack
+    if(measurement_batch.has_velocity && block_accepted[0])
+        time_since_velocity_update = 0.;
+    measurement_batch.clear();
 }
 
 void PoseUKF::integrateMeasurement(const Velocity& velocity)
 {
+    CallScope scope(instrumentation.get(), VELOCITY_CHANNEL, sigma_point_filter->getLastInnovation());
+    flushPrediction();
     checkMeasurment(velocity.mu, velocity.cov);
-    ukf->update(velocity.mu, boost::bind(measurementVelocity<State>, _1),
-        boost::bind(ukfom::id< Velocity::Cov >, velocity.cov),
-        ukfom::accept_any_mahalanobis_distance<State::scalar>);
+    if(batch_update)
+    {
+        if(measurement_batch.has_velocity)
+            integrateMeasurementBatch();
+        measurement_batch.velocity = velocity;
+        measurement_batch.has_velocity = true;
+        return;
+    }
+    if(sigma_point_filter->update(*ukf, velocity.mu, boost::bind(measurementVelocity<State>, _1),
+                                  velocity.cov, gates.velocity))
+        time_since_velocity_update = 0.;
 }
 
 void PoseUKF::integrateMeasurement(const Acceleration& acceleration)
 {
+    CallScope scope(instrumentation.get(), ACCELERATION_CHANNEL, sigma_point_filter->getLastInnovation());
+    flushPrediction();
     checkMeasurment(acceleration.mu, acceleration.cov);
-    ukf->update(acceleration.mu, boost::bind(measurementAcceleration<State>, _1),
-                boost::bind(ukfom::id< Acceleration::Cov >, acceleration.cov),
-                ukfom::accept_any_mahalanobis_distance<State::scalar>);
+    if(batch_update)
+    {
+        if(measurement_batch.has_acceleration)
+            integrateMeasurementBatch();
+        measurement_batch.acceleration = acceleration;
+        measurement_batch.has_acceleration = true;
+        return;
+    }
+    sigma_point_filter->update(*ukf, acceleration.mu, boost::bind(measurementAcceleration<State>, _1),
+                               acceleration.cov, gates.acceleration);
 }
 
 void PoseUKF::integrateMeasurement(const RotationRate& rotation_rate)
 {
     checkMeasurment(rotation_rate.mu, rotation_rate.cov);
     this->rotation_rate = rotation_rate.mu;
+    state_revision++;
+}
+
+void PoseUKF::preintegrateImuSample(const RotationRate& rotation_rate, const Acceleration& acceleration, double delta_t)
+{
+    checkMeasurment(rotation_rate.mu, rotation_rate.cov);
+    checkMeasurment(acceleration.mu, acceleration.cov);
+    if(!(delta_t > 0.))
+        throw std::invalid_argument("Time delta of IMU sample must be positive");
+
+    // the interval starts with the gyro bias of the current mean
+    if(imu_preintegration->getSampleCount() == 0)
+        imu_preintegration->reset(ukf->mu().bias_gyro);
+    imu_preintegration->integrate(rotation_rate.mu, acceleration.mu, acceleration.cov, delta_t);
+
+    // the fast pose and the rotation rate output follow the latest sample
+    this->rotation_rate = rotation_rate.mu;
+    state_revision++;
 }
 
 void PoseUKF::integrateMeasurement(const Z_Position& z_position)
 {
+    CallScope scope(instrumentation.get(), Z_POSITION_CHANNEL, sigma_point_filter->getLastInnovation());
+    flushPrediction();
     checkMeasurment(z_position.mu, z_position.cov);
-    ukf->update(z_position.mu, boost::bind(measurementZPosition<State>, _1),
-                boost::bind(ukfom::id< Z_Position::Cov >, z_position.cov),
-                ukfom::accept_any_mahalanobis_distance<State::scalar>);
+    if(batch_update)
+    {
+        if(measurement_batch.has_z_position)
+            integrateMeasurementBatch();
+        measurement_batch.z_position = z_position;
+        measurement_batch.has_z_position = true;
+        return;
+    }
+    // the measurement is linear in the position, which allows a closed-form update
+    sigma_point_filter->linearUpdate(*ukf, z_position.mu, boost::bind(measurementZPosition<State>, _1),
+                                     MTK::getStartIdx(&State::position) + 2, z_position.cov, gates.z_position);
 }
 
 void PoseUKF::integrateMeasurement(const XY_Position& xy_position)
 {
+    CallScope scope(instrumentation.get(), XY_POSITION_CHANNEL, sigma_point_filter->getLastInnovation());
+    flushPrediction();
     checkMeasurment(xy_position.mu, xy_position.cov);
-    ukf->update(xy_position.mu, boost::bind(measurementXYPosition<State>, _1),
-                boost::bind(ukfom::id< XY_Position::Cov >, xy_position.cov),
-                d2p95<State::scalar>);
+    if(batch_update)
+    {
+        if(measurement_batch.has_xy_position)
+            integrateMeasurementBatch();
+        measurement_batch.xy_position = xy_position;
+        measurement_batch.has_xy_position = true;
+        return;
+    }
+    // the measurement is linear in the position, which allows a closed-form update
+    sigma_point_filter->linearUpdate(*ukf, xy_position.mu, boost::bind(measurementXYPosition<State>, _1),
+                                     MTK::getStartIdx(&State::position), xy_position.cov, gates.xy_position);
 }
 
 void PoseUKF::integrateMeasurement(const GeographicPosition& geo_position, const Eigen::Vector3d& gps_in_body)
 {
+    CallScope scope(instrumentation.get(), GEOGRAPHIC_POSITION_CHANNEL, sigma_point_filter->getLastInnovation());
+    // queued measurements precede this one
+    integrateMeasurementBatch();
+    flushPrediction();
     checkMeasurment(geo_position.mu, geo_position.cov);
 
     // project geographic position to local NWU plane
-    Eigen::Matrix<TranslationType::scalar, 2, 1> projected_position;
-    projection->worldToNav(geo_position.mu.x(), geo_position.mu.y(), projected_position.x(), projected_position.y());
-    projected_position = projected_position - (ukf->mu().orientation * gps_in_body).head<2>();
+    XY_Position projected_position;
+    projection->worldToNav(geo_position.mu.x(), geo_position.mu.y(), projected_position.mu.x(), projected_position.mu.y());
+    projected_position.cov = geo_position.cov;
+    integrateProjectedPositionImpl(projected_position, gps_in_body);
+}
+
+void PoseUKF::integrateProjectedPosition(const XY_Position& projected_position, const Eigen::Vector3d& gps_in_body)
+{
+    CallScope scope(instrumentation.get(), GEOGRAPHIC_POSITION_CHANNEL, sigma_point_filter->getLastInnovation());
+    // queued measurements precede this one
+    integrateMeasurementBatch();
+    flushPrediction();
+    checkMeasurment(projected_position.mu, projected_position.cov);
+    integrateProjectedPositionImpl(projected_position, gps_in_body);
+}
 
-    ukf->update(projected_position, boost::bind(measurementXYPosition<State>, _1),
-                boost::bind(ukfom::id< XY_Position::Cov >, geo_position.cov),
-                d2p95<State::scalar>);
+void PoseUKF::integrateProjectedPositionImpl(const XY_Position& projected_position, const Eigen::Vector3d& gps_in_body)
+{
+    const Eigen::Matrix<TranslationType::scalar, 2, 1> position = projected_position.mu - (ukf->mu().orientation * gps_in_body).head<2>();
+    sigma_point_filter->linearUpdate(*ukf, position, boost::bind(measurementXYPosition<State>, _1),
+                                     MTK::getStartIdx(&State::position), projected_position.cov, gates.geographic_position);
 }
 
 void PoseUKF::integrateMeasurement(const BodyEffortsMeasurement& body_efforts, bool only_affect_velocity)
 {
+    CallScope scope(instrumentation.get(), BODY_EFFORTS_CHANNEL, sigma_point_filter->getLastInnovation());
+    // queued measurements precede this one, they might restore the bottom lock
+    integrateMeasurementBatch();
+    // decided on the state of the last full prediction, so a skipped update doesn't force the pending one
+    if(!scheduleEffortUpdate())
+        return;
+    flushPrediction();
     checkMeasurment(body_efforts.mu, body_efforts.cov);
 
     if(only_affect_velocity)
@@ -319,34 +1368,138 @@ void PoseUKF::integrateMeasurement(const BodyEffortsMeasurement& body_efforts, b
         Eigen::Vector3d rotation_rate_body = getRotationRate();
         // assume center of rotation to be the body frame
         Eigen::Vector3d acceleration_body = ukf->mu().orientation.inverse() * ukf->mu().acceleration - rotation_rate_body.cross(rotation_rate_body.cross(filter_parameter.imu_in_body));
-        ukf->update(body_efforts.mu, boost::bind(constrainVelocity<State>, _1, dynamic_model,
-                                        filter_parameter.imu_in_body, rotation_rate_body, water_velocity,
-                                        ukf->mu().orientation, acceleration_body),
-                    boost::bind(ukfom::id< BodyEffortsMeasurement::Cov >, body_efforts.cov),
-                    ukfom::accept_any_mahalanobis_distance<State::scalar>);
+        base::Vector6d acceleration_6d;
+        // assume the angular acceleration to be zero
+        acceleration_6d << acceleration_body, base::Vector3d::Zero();
+
+        // the motion model is the same for all sigma points
+        velocity_effort_context->update(*(*effort_models)[effort_model_offset], ukf->mu().inertia, ukf->mu().lin_damping, ukf->mu().quad_damping,
+                                        acceleration_6d, ukf->mu().orientation);
+        sigma_point_filter->update(*ukf, body_efforts.mu, boost::bind(constrainVelocity<State>, _1, _2, &(*effort_models)[effort_model_offset],
+                                                   boost::cref(*velocity_effort_context), filter_parameter.imu_in_body,
+                                                   rotation_rate_body, water_velocity, ukf->mu().orientation),
+                                   body_efforts.cov, gates.body_efforts, true);
     }
     else
     {
-        ukf->update(body_efforts.mu, boost::bind(measurementEfforts<State>, _1, dynamic_model, filter_parameter.imu_in_body,
-                                                 getRotationRate()),
-                    boost::bind(ukfom::id< BodyEffortsMeasurement::Cov >, body_efforts.cov),
-                    ukfom::accept_any_mahalanobis_distance<State::scalar>);
+        sigma_point_filter->update(*ukf, body_efforts.mu, boost::bind(measurementEfforts<State>, _1, _2, &(*effort_models)[effort_model_offset],
+                                                   filter_parameter.imu_in_body, getRotationRate()),
+                                   body_efforts.cov, gates.body_efforts, true);
     }
 }
 
 void PoseUKF::integrateMeasurement(const WaterVelocityMeasurement& adcp_measurements, double cell_weighting)
 {
+    CallScope scope(instrumentation.get(), WATER_VELOCITY_CHANNEL, sigma_point_filter->getLastInnovation());
+    // queued measurements precede this one
+    integrateMeasurementBatch();
+    flushPrediction();
     checkMeasurment(adcp_measurements.mu, adcp_measurements.cov);
     
-    ukf->update(adcp_measurements.mu, boost::bind(measurementWaterCurrents<State>, _1, cell_weighting),
-        boost::bind(ukfom::id< WaterVelocityMeasurement::Cov >, adcp_measurements.cov),
-        d2p95<State::scalar>);
+    sigma_point_filter->update(*ukf, adcp_measurements.mu, boost::bind(measurementWaterCurrents<State>, _1, cell_weighting),
+                               adcp_measurements.cov, gates.water_velocity, true);
+}
+
+void PoseUKF::integrateMeasurement(const WaterVelocityProfile& adcp_profile, double minimum_correlation)
+{
+    CallScope scope(instrumentation.get(), WATER_VELOCITY_CHANNEL, sigma_point_filter->getLastInnovation());
+    // queued measurements precede this one
+    integrateMeasurementBatch();
+    flushPrediction();
+
+    typedef SigmaPointFilter<WState>::MeasurementBlock MeasurementBlock;
+    ProfileMeasurement z(2 * WaterVelocityProfile::MAX_CELLS);
+    Eigen::Matrix<TranslationType::scalar, Eigen::Dynamic, Eigen::Dynamic, 0, 2 * WaterVelocityProfile::MAX_CELLS, 2 * WaterVelocityProfile::MAX_CELLS> R;
+    R.setZero(2 * WaterVelocityProfile::MAX_CELLS, 2 * WaterVelocityProfile::MAX_CELLS);
+    CellWeighting cell_weighting(int(WaterVelocityProfile::MAX_CELLS));
+    MeasurementBlock blocks[WaterVelocityProfile::MAX_CELLS];
+    int cells = 0;
+    for(unsigned i = 0; i < adcp_profile.cell_count && i < WaterVelocityProfile::MAX_CELLS; i++)
+    {
+        if(adcp_profile.correlation[i] < minimum_correlation)
+            continue;
+        checkMeasurment(WaterVelocityMeasurement::Mu(adcp_profile.mu.col(i)), adcp_profile.cov[i]);
+        z.segment<2>(2 * cells) = adcp_profile.mu.col(i);
+        R.block<2,2>(2 * cells, 2 * cells) = adcp_profile.cov[i];
+        cell_weighting(cells) = adcp_profile.cell_weighting[i];
+        MeasurementBlock block = {2, gates.water_velocity.getThreshold()};
+        blocks[cells] = block;
+        cells++;
+    }
+    if(cells == 0)
+        return;
+    z.conservativeResize(2 * cells);
+    R.conservativeResize(2 * cells, 2 * cells);
+    cell_weighting.conservativeResize(cells);
+
+    sigma_point_filter->stackedUpdate(*ukf, z, boost::bind(measurementWaterCurrentProfile<State>, _1, boost::cref(cell_weighting)),
+                                      R, blocks, cells, true);
 }
 
 PoseUKF::RotationRate::Mu PoseUKF::getRotationRate()
 {
-    double latitude, longitude;
-    projection->navToWorld(ukf->mu().position.x(), ukf->mu().position.y(), latitude, longitude);
-    Eigen::Vector3d earth_rotation = Eigen::Vector3d(pose_estimation::EARTHW * cos(latitude), 0., pose_estimation::EARTHW * sin(latitude));
-    return rotation_rate - ukf->mu().bias_gyro - ukf->mu().orientation.inverse() * earth_rotation;
+    updateEarthRotation(exact_earth_rotation);
+    return rotation_rate_output.get(getStateRevision(), [this](RotationRate::Mu& output)
+    {
+        output = rotation_rate - ukf->mu().bias_gyro - ukf->mu().orientation.inverse() * earth_rotation;
+    });
+}
+
+unsigned long PoseUKF::getStateRevision() const
+{
+    return sigma_point_filter->getRevision() + state_revision;
+}
+
+const Eigen::Matrix<double, 6, 6>& PoseUKF::getPoseCovariance(OutputFrame frame) const
+{
+    if(frame != NAVIGATION_FRAME && frame != IMU_FRAME)
+        throw std::invalid_argument("Unknown output frame");
+
+    return pose_cov_output[frame].get(getStateRevision(), [this, frame](Eigen::Matrix<double, 6, 6>& output)
+    {
+        const Covariance& sigma = ukf->sigma();
+        output << MTK::subblock(sigma, &State::position), MTK::subblock(sigma, &State::position, &State::orientation),
+                  MTK::subblock(sigma, &State::orientation, &State::position), MTK::subblock(sigma, &State::orientation);
+        if(frame == IMU_FRAME)
+        {
+            // the orientation error is applied in the navigation frame
+            Eigen::Matrix<double, 6, 6> J = Eigen::Matrix<double, 6, 6>::Zero();
+            J.topLeftCorner<3,3>() = J.bottomRightCorner<3,3>() = ukf->mu().orientation.toRotationMatrix().transpose();
+            output = J * output * J.transpose();
+        }
+    });
+}
+
+const Eigen::Vector3d& PoseUKF::getGeographicPosition() const
+{
+    return geographic_position_output.get(getStateRevision(), [this](Eigen::Vector3d& output)
+    {
+        const Eigen::Vector3d& position = ukf->mu().position;
+        projection->navToWorld(position.x(), position.y(), output.x(), output.y());
+        output.z() = location.altitude + position.z();
+    });
+}
+
+const Eigen::Vector3d& PoseUKF::getBodyVelocity() const
+{
+    return body_velocity_output.get(getStateRevision(), [this](Eigen::Vector3d& output)
+    {
+        output = measurementVelocity(ukf->mu());
+    });
+}
+
+const Eigen::Matrix3d& PoseUKF::getBodyVelocityCovariance() const
+{
+    return body_velocity_cov_output.get(getStateRevision(), [this](Eigen::Matrix3d& output)
+    {
+        // Jacobian of R^T * v with respect to the orientation and velocity errors
+        const Eigen::Matrix3d R_t = ukf->mu().orientation.toRotationMatrix().transpose();
+        Eigen::Matrix<double, 3, 6> J;
+        J << R_t * crossProductMatrix(ukf->mu().velocity), R_t;
+        const Covariance& sigma = ukf->sigma();
+        Eigen::Matrix<double, 6, 6> cov;
+        cov << MTK::subblock(sigma, &State::orientation), MTK::subblock(sigma, &State::orientation, &State::velocity),
+               MTK::subblock(sigma, &State::velocity, &State::orientation), MTK::subblock(sigma, &State::velocity);
+        output = J * cov * J.transpose();
+    });
 }
\ No newline at end of file
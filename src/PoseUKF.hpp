@@ -1,17 +1,17 @@
 #ifndef _UWV_KALMAN_FILTERS_POSE_UKF_HPP_
 #define _UWV_KALMAN_FILTERS_POSE_UKF_HPP_
 
+#include <limits>
 #include <base/Time.hpp>
 #include <pose_estimation/UnscentedKalmanFilter.hpp>
 #include <pose_estimation/Measurement.hpp>
 #include <uwv_dynamic_model/DataTypes.hpp>
 #include "PoseState.hpp"
 #include "PoseUKFConfig.hpp"
-
-namespace uwv_dynamic_model
-{
-    class DynamicModel;
-}
+#include "SigmaPointFilter.hpp"
+#include "InnovationGate.hpp"
+#include "WaterCurrentMap.hpp"
+#include "LazyOutput.hpp"
 
 namespace pose_estimation
 {
@@ -21,6 +21,12 @@ namespace pose_estimation
 namespace uwv_kalman_filters
 {
 
+class EffortModel;
+class EffortContext;
+class ImuPreintegration;
+struct PoseUKFSnapshot;
+class PoseUKFSmoother;
+
 /**
  * This implements a full model aided inertial localization solution for autonomous underwater vehicles.
  *
@@ -61,17 +67,244 @@ public:
     MEASUREMENT(BodyEffortsMeasurement, 6)
     MEASUREMENT(WaterVelocityMeasurement, 2)
 
+    typedef std::vector< boost::shared_ptr<EffortModel> > EffortModels;
+
+    /* DOFs of position, orientation, velocity, acceleration and gyro bias, the leading sub-manifolds of the PoseState */
+    enum { NAVIGATION_CORE_DOF = TranslationType::DOF + RotationType::DOF + VelocityType::DOF +
+                                 AccelerationType::DOF + BiasType::DOF };
+
+    /* Instrumented calls, see getStatistics */
+    enum StatisticsChannel
+    {
+        PREDICTION_CHANNEL,
+        FULL_PREDICTION_CHANNEL,
+        MEASUREMENT_BATCH_CHANNEL,
+        VELOCITY_CHANNEL,
+        ACCELERATION_CHANNEL,
+        Z_POSITION_CHANNEL,
+        XY_POSITION_CHANNEL,
+        GEOGRAPHIC_POSITION_CHANNEL,
+        BODY_EFFORTS_CHANNEL,
+        WATER_VELOCITY_CHANNEL,
+        CHANNEL_COUNT
+    };
+
+    /* Frame in which the pose outputs are expressed, see getPoseCovariance */
+    enum OutputFrame
+    {
+        NAVIGATION_FRAME,
+        IMU_FRAME
+    };
+
+    /* Mean-only strapdown propagation of the navigation states */
+    struct FastPose
+    {
+        Eigen::Vector3d position;
+        Eigen::Quaterniond orientation;
+        Eigen::Vector3d velocity;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    struct EffortUpdateStatistics
+    {
+        unsigned long applied;
+        /* Skipped above the minimum depth of the dynamic model */
+        unsigned long skipped_surface;
+        /* Skipped by the decimation with a healthy bottom lock */
+        unsigned long skipped_decimated;
+
+        EffortUpdateStatistics() : applied(0), skipped_surface(0), skipped_decimated(0) {}
+    };
+
+    /* Filter state and the inputs in effect, which allows to resume the filter from this point */
+    struct Checkpoint
+    {
+        WState mu;
+        Covariance sigma;
+        RotationRate::Mu rotation_rate;
+        Eigen::Vector3d earth_rotation;
+        Eigen::Vector2d earth_rotation_position;
+        /* State of the body effort update scheduling */
+        double time_since_velocity_update;
+        unsigned effort_update_decimation;
+        EffortUpdateStatistics effort_update_statistics;
+        /* Cell of the water current map the water current states belong to */
+        WaterCurrentMap::Key water_current_cell;
+        bool has_water_current_cell;
+        double filter_time;
+
+        Checkpoint() : time_since_velocity_update(std::numeric_limits<double>::infinity()),
+                       effort_update_decimation(0), has_water_current_cell(false), filter_time(0.) {}
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /* Chi-square gates of the measurement types, see InnovationGateParameters */
+    struct InnovationGates
+    {
+        InnovationGate velocity;
+        InnovationGate acceleration;
+        InnovationGate z_position;
+        InnovationGate xy_position;
+        InnovationGate geographic_position;
+        InnovationGate body_efforts;
+        InnovationGate water_velocity;
+    };
+
+    /* Cells of one ADCP ping, stored in contiguous fixed-size buffers */
+    struct WaterVelocityProfile
+    {
+        enum { MAX_CELLS = 32 };
+        unsigned cell_count;
+        /* Water velocities of the cells expressed in the IMU frame */
+        Eigen::Matrix<double, 2, MAX_CELLS> mu;
+        WaterVelocityMeasurement::Cov cov[MAX_CELLS];
+        /* Weighting between the current at the vehicle (0) and below it (1) */
+        double cell_weighting[MAX_CELLS];
+        double correlation[MAX_CELLS];
+
+        WaterVelocityProfile() : cell_count(0) {}
+        /* Appends a cell, returns false if the profile is full */
+        bool addCell(const WaterVelocityMeasurement::Mu& cell_mu, const WaterVelocityMeasurement::Cov& cell_cov,
+                     double weighting, double cell_correlation = 1.)
+        {
+            if(cell_count >= MAX_CELLS)
+                return false;
+            mu.col(cell_count) = cell_mu;
+            cov[cell_count] = cell_cov;
+            cell_weighting[cell_count] = weighting;
+            correlation[cell_count] = cell_correlation;
+            cell_count++;
+            return true;
+        }
+        void clear() { cell_count = 0; }
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /* Measurements queued between beginUpdate and commitUpdate */
+    struct MeasurementBatch
+    {
+        enum { MAX_ROWS = Velocity::Mu::RowsAtCompileTime + Acceleration::Mu::RowsAtCompileTime +
+                          Z_Position::Mu::RowsAtCompileTime + XY_Position::Mu::RowsAtCompileTime };
+        bool has_velocity;
+        bool has_acceleration;
+        bool has_z_position;
+        bool has_xy_position;
+        Velocity velocity;
+        Acceleration acceleration;
+        Z_Position z_position;
+        XY_Position xy_position;
+
+        MeasurementBatch() : has_velocity(false), has_acceleration(false), has_z_position(false), has_xy_position(false) {}
+        bool empty() const { return !(has_velocity || has_acceleration || has_z_position || has_xy_position); }
+        void clear() { has_velocity = has_acceleration = has_z_position = has_xy_position = false; }
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /* Precision of the propagation of the sigma points in the full prediction, see setPropagationPrecision */
+    enum PropagationPrecision
+    {
+        DOUBLE_PRECISION,
+        SINGLE_PRECISION
+    };
+
+    /* Sigma points of several filters in a structure of arrays, see beginBatchedPrediction.
+     * Each row holds one component of the state for all sigma points, the points of a filter
+     * occupy the consecutive columns of its segment. The components are stored in the given scalar type as deviations
+     * from the mean of each filter, which is propagated in double precision. The orientations are kept in double */
+    template<typename Scalar>
+    struct BasicSigmaPointBatch
+    {
+        typedef Eigen::Matrix<Scalar, 1, Eigen::Dynamic, Eigen::RowMajor> Components1;
+        typedef Eigen::Matrix<Scalar, 2, Eigen::Dynamic, Eigen::RowMajor> Components2;
+        typedef Eigen::Matrix<Scalar, 3, Eigen::Dynamic, Eigen::RowMajor> Components3;
+        typedef Eigen::Matrix<Scalar, 6, Eigen::Dynamic, Eigen::RowMajor> Components6;
+        typedef Eigen::Matrix<double, 4, Eigen::Dynamic, Eigen::RowMajor> Orientations;
+
+        /* Columns of one filter and the inputs of its process model */
+        struct Segment
+        {
+            unsigned first_column;
+            /* Zero if the filter is not predicted in the batch */
+            unsigned columns;
+            /* Mean of the filter, the origin of the stored deviations */
+            WState origin;
+            RotationRate::Mu rotation_rate;
+            Eigen::Vector3d earth_rotation;
+            InertiaType::vectorized_type inertia_offset;
+            LinDampingType::vectorized_type lin_damping_offset;
+            QuadDampingType::vectorized_type quad_damping_offset;
+            PoseUKFParameter filter_parameter;
+            EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        };
+
+        Components3 position;
+        /* Coefficients x, y, z, w of the quaternions */
+        Orientations orientation;
+        Components3 velocity;
+        Components3 acceleration;
+        Components3 bias_gyro;
+        Components3 bias_acc;
+        Components1 gravity;
+        Components6 inertia;
+        Components6 lin_damping;
+        Components6 quad_damping;
+        Components2 water_velocity;
+        Components2 water_velocity_below;
+        Components2 bias_adcp;
+        /* Angular velocity in the navigation frame and a temporary of the process model */
+        Components3 angular_velocity;
+        Components3 rotated;
+        std::vector< Segment, Eigen::aligned_allocator<Segment> > segments;
+        /* Number of columns of all segments */
+        unsigned columns;
+
+        BasicSigmaPointBatch() : columns(0) {}
+
+        /* Removes all segments, the storage is kept */
+        void clear();
+
+        /* Appends a segment of the given number of columns and returns its index.
+         * Only allocates memory if the batch grows beyond all previous sizes */
+        unsigned addSegment(unsigned segment_columns);
+
+        /* Converts a sigma point from and to the column of a segment */
+        void setColumn(const Segment& segment, unsigned column, const WState& state);
+        void getColumn(const Segment& segment, unsigned column, WState& state) const;
+    };
+    typedef BasicSigmaPointBatch<double> SigmaPointBatch;
+    typedef BasicSigmaPointBatch<float> SinglePrecisionSigmaPointBatch;
+
 public:
     PoseUKF(const State& initial_state, const Covariance& state_cov,
             const LocationConfiguration& location, const uwv_dynamic_model::UWVParameters& model_parameters,
-            const PoseUKFParameter& filter_parameter);
+            const PoseUKFParameter& filter_parameter, unsigned sigma_point_threads = 1);
+
+    /* Derives the filter parameters, the process noise, the innovation gates, the sigma point scheme
+     * and the minimum depth of the dynamic model from the configuration.
+     * imu_delta_t is the period of the inertial measurements in seconds, which relates the
+     * bias instabilities to the process noise. Throws std::invalid_argument if it is not positive
+     * or the sigma point parameters are invalid */
+    PoseUKF(const State& initial_state, const Covariance& state_cov, const PoseUKFConfig& config,
+            const uwv_dynamic_model::UWVParameters& model_parameters, const Eigen::Vector3d& imu_in_body,
+            double imu_delta_t, unsigned sigma_point_threads = 1);
     virtual ~PoseUKF() {}
 
+    /* Filter parameters given by the configuration */
+    static PoseUKFParameter filterParameter(const PoseUKFConfig& config, const Eigen::Vector3d& imu_in_body);
+
+    /* Process noise covariance given by the configuration, see the constructor */
+    static Covariance processNoise(const PoseUKFConfig& config, double imu_delta_t);
+
     /* Latitude and Longitude in WGS 84 in radian.
      * Uncertainty expressed in m on earth surface */
     void integrateMeasurement(const GeographicPosition& geo_position,
                               const Eigen::Vector3d& gps_in_body = Eigen::Vector3d::Zero());
 
+    /* Geographic position already projected to the navigation frame of this filter, e.g. once for
+     * several filters sharing the location. Integrated and gated as a GeographicPosition */
+    void integrateProjectedPosition(const XY_Position& projected_position,
+                                    const Eigen::Vector3d& gps_in_body = Eigen::Vector3d::Zero());
+
     /* 2D Position expressed in the navigation frame */
     void integrateMeasurement(const XY_Position& xy_position);
 
@@ -84,6 +317,14 @@ public:
     /* Accelerations of IMU expressed in the IMU frame */
     void integrateMeasurement(const Acceleration& acceleration);
 
+    /* Accumulates a high-rate IMU sample measured over the period delta_t in seconds.
+     * The next full prediction applies the delta rotation of all accumulated samples, corrected
+     * for the gyro bias of each sigma point, and afterwards integrates the averaged specific force
+     * as one Acceleration measurement. The velocity is driven by the acceleration state, so there is
+     * no delta velocity input; the accelerometer bias enters the Acceleration measurement linearly.
+     * The samples have to cover the predicted interval, otherwise the full prediction throws std::runtime_error */
+    void preintegrateImuSample(const RotationRate& rotation_rate, const Acceleration& acceleration, double delta_t);
+
     /* Velocities expressed in the IMU frame */
     void integrateMeasurement(const Velocity& velocity);
 
@@ -93,22 +334,304 @@ public:
     /* Water Velocities from ADCP expressed in the IMU frame */
     void integrateMeasurement(const WaterVelocityMeasurement& adcp_measurements, double cell_weighting);
 
+    /* All cells of an ADCP ping with a correlation of at least minimum_correlation, integrated in one
+     * stacked update from a single set of sigma points. Each cell is gated on its own */
+    void integrateMeasurement(const WaterVelocityProfile& adcp_profile, double minimum_correlation = 0.);
+
+    /* Computes the gate thresholds of all measurement types from the given confidences.
+     * Rejected measurements are not integrated, by default only the XY position, geographic
+     * position and water velocity measurements are gated with a confidence of 95%, or as given
+     * by PoseUKFConfig::innovation_gates */
+    void setInnovationGates(const InnovationGateParameters& parameters);
+
+    /* Selects the covariance representation, see FilterBackend */
+    void setFilterBackend(FilterBackend backend);
+
+    /* Selects the sigma point set of the predictions and updates, see PoseUKFConfig::sigma_points.
+     * The default SYMMETRIC_SIGMA_POINTS evaluate the models on 2n + 1 points, SPHERICAL_SIMPLEX on n + 2.
+     * Throws std::invalid_argument if the parameters are invalid */
+    void setSigmaPointScheme(const SigmaPointParameters& parameters);
+
+    /* Starts queueing Velocity, Acceleration, Z_Position and XY_Position measurements.
+     * The queued measurements are integrated in commitUpdate in one stacked update using a single
+     * set of sigma points. A second measurement of an already queued type commits the pending ones first,
+     * as does any other measurement type, which keeps the measurements in order */
+    void beginUpdate();
+
+    /* Integrates all measurements queued since beginUpdate and stops queueing */
+    void commitUpdate();
+
+    /* Period in seconds in which the full sigma point prediction is executed, the default is 0.
+     * With a positive period the prediction steps in between only propagate the FastPose, the
+     * full prediction then integrates the accumulated time with the rotation of all merged steps.
+     * The process noise grows linearly with the number of merged steps, as it does for single steps.
+     * Pending predictions are always completed before a measurement update. */
+    void setFullPredictionPeriod(double period);
+
+    /* Chooses the full prediction interval from the current rotation rate, acceleration and velocity,
+     * such that each step integrates at most the configured rotation, velocity change and distance.
+     * Quasi-static phases merge several prediction steps, aggressive motion splits a step into sub-steps.
+     * This replaces the fixed full prediction period until disableAdaptivePrediction is called. */
+    void enableAdaptivePrediction(const AdaptivePredictionParameters& parameters = AdaptivePredictionParameters());
+    void disableAdaptivePrediction();
+
+    /* Number of sigma point predictions executed so far */
+    unsigned long getFullPredictionCount() const { return full_prediction_count; }
+
+    /* Depth in meters above which the scheduled body effort updates are skipped, the default is 0.
+     * See PoseUKFConfig::dynamic_model_min_depth */
+    void setDynamicModelMinDepth(double min_depth);
+
+    /* Schedules the body effort updates by the operating regime. Above the minimum depth of the
+     * dynamic model (see setDynamicModelMinDepth) they are skipped,
+     * while the DVL has bottom lock and the velocity is tight they are decimated. During DVL drop-outs
+     * every update is applied. Without scheduling, which is the default, all updates are applied */
+    void enableEffortUpdateScheduling(const EffortUpdateSchedulingParameters& parameters = EffortUpdateSchedulingParameters());
+    void disableEffortUpdateScheduling();
+
+    /* Number of applied and skipped body effort updates so far */
+    const EffortUpdateStatistics& getEffortUpdateStatistics() const { return effort_update_statistics; }
+
+    /* If enabled the full prediction only samples the navigation core (NAVIGATION_CORE_DOF),
+     * the remaining states are first order Markov processes which are propagated in closed form,
+     * see SigmaPointFilter::structuredPredict. This is disabled by default */
+    void setStructuredPrediction(bool structured);
+
+    /* Keeps the water current states of each visited cell of the map. When the estimated position
+     * enters another cell, the current estimate is stored in the map and, if the new cell was visited
+     * before, its stored estimate replaces the water current states. The stored estimate is propagated
+     * as first order Markov process (water_velocity_tau, water_velocity_limits) over the time since it was
+     * stored, estimates stored after the current filter time (e.g. before a restoreCheckpoint) are ignored.
+     * The restored states are assumed to be uncorrelated with the remaining states.
+     * NULL disables the map, which is the default */
+    void setWaterCurrentMap(const boost::shared_ptr<WaterCurrentMap>& map);
+
+    /* The smoother records the moments of each full prediction, it is not owned and NULL detaches it.
+     * Called by the constructor and destructor of the PoseUKFSmoother */
+    void setSmoother(PoseUKFSmoother* smoother);
+
+    /* Executes the pending full prediction, if any */
+    void flushPrediction();
+
+    /* Number of sigma points of a full prediction */
+    unsigned getSigmaPointCount() const;
+
+    /* First half of a prediction of several filters with a single evaluation of the process model, see VehicleFleet.
+     * Does everything predictionStep does up to the propagation of the sigma points, which are stored in the segment
+     * of the batch together with the inputs of the process model. The segment has to provide getSigmaPointCount() columns.
+     * Merged, adaptive and structured predictions, pre-integrated IMU samples and the exact earth rotation require
+     * the process model of the filter, in these cases the segment is emptied, the filter is not changed and false is
+     * returned; predictionStep has to be used instead.
+     * The filter must not be used until commitBatchedPrediction was called */
+    template<typename Scalar>
+    bool beginBatchedPrediction(double delta_t, BasicSigmaPointBatch<Scalar>& batch, unsigned segment);
+
+    /* Propagates the sigma points of the segments [first_segment, end_segment) in place, the same as the process
+     * model of each filter would. Each component is evaluated for all columns of a segment at once */
+    template<typename Scalar>
+    static void predictBatch(BasicSigmaPointBatch<Scalar>& batch, double delta_t, unsigned first_segment, unsigned end_segment);
+
+    /* Completes a prediction started by beginBatchedPrediction from the propagated sigma points of the segment */
+    template<typename Scalar>
+    void commitBatchedPrediction(const BasicSigmaPointBatch<Scalar>& batch, unsigned segment);
+
+    /* With SINGLE_PRECISION the full predictions propagate the deviations of the sigma points from the mean in a
+     * SinglePrecisionSigmaPointBatch, the mean itself and the orientations in double precision. The sigma points
+     * are generated from and the mean and covariance accumulated in double precision. Merged, structured and pre-integrated predictions and the exact earth
+     * rotation are always propagated in double precision. A VehicleFleet batches the filter in its precision.
+     * The default is DOUBLE_PRECISION */
+    void setPropagationPrecision(PropagationPrecision precision);
+    PropagationPrecision getPropagationPrecision() const { return propagation_precision; }
+
+    /* Shares the effort models with other filters of the same vehicle type, e.g. the vehicles of a VehicleFleet.
+     * The worker w of the sigma points evaluates the motion model on models[offset + w], see setEffortModelOffset.
+     * An effort model must not be used concurrently, filters running at the same time need distinct offsets.
+     * The nominal parameters of the models replace the ones given to the constructor.
+     * Throws std::invalid_argument if there are less than offset + sigma point workers models */
+    void setEffortModels(const boost::shared_ptr<const EffortModels>& models, unsigned offset = 0);
+
+    /* Selects the first of the shared effort models, see setEffortModels */
+    void setEffortModelOffset(unsigned offset);
+
+    /* Returns the pose propagated with every prediction step, extrapolated by the given time in seconds.
+     * It is reset to the filter mean after each full prediction and measurement update. */
+    FastPose getFastPose(double extrapolation = 0.) const;
+
+    /* Stores the current state and inputs of the filter, pending predictions are completed first */
+    void saveCheckpoint(Checkpoint& checkpoint);
+
+    /* Resumes the filter from a checkpoint, queued measurements and pending predictions are discarded */
+    void restoreCheckpoint(const Checkpoint& checkpoint);
+
+    /* Stores the checkpoint together with the parameter offsets and the origin of the navigation frame
+     * in the preallocated snapshot, without allocating memory. Pending predictions are completed first */
+    void saveSnapshot(PoseUKFSnapshot& snapshot, const base::Time& time = base::Time());
+
+    /* Resumes the filter from a snapshot, including the origin of the navigation frame.
+     * Throws std::invalid_argument if the snapshot is not valid */
+    void restoreSnapshot(const PoseUKFSnapshot& snapshot);
+
     /* Returns rotation rate in IMU frame */
     RotationRate::Mu getRotationRate();
 
+    /* Changes with every full prediction, measurement update, restore and new rotation rate.
+     * The outputs below are computed at most once per revision, they refer to the state of the last
+     * full prediction or update, flushPrediction includes pending predictions.
+     * The outputs are cached in the filter and therefore not thread-safe */
+    unsigned long getStateRevision() const;
+
+    /* Covariance of the position and orientation (in this order) of the IMU,
+     * expressed in the navigation frame or rotated to the IMU frame */
+    const Eigen::Matrix<double, 6, 6>& getPoseCovariance(OutputFrame frame = NAVIGATION_FRAME) const;
+
+    /* Latitude and longitude in radians and altitude in meters of the IMU */
+    const Eigen::Vector3d& getGeographicPosition() const;
+
+    /* Velocity of the IMU in the IMU frame */
+    const Eigen::Vector3d& getBodyVelocity() const;
+
+    /* Covariance of the velocity in the IMU frame, including the uncertainty of the orientation */
+    const Eigen::Matrix3d& getBodyVelocityCovariance() const;
+
+    /* If enabled the earth rotation is evaluated at the position of each sigma point.
+     * This is meant for validation, by default it is evaluated once per prediction and measurement epoch */
+    void setExactEarthRotation(bool exact);
+
+    /* Distance in meters the estimated position can move before the earth rotation is evaluated again.
+     * With a distance of zero (default) it is evaluated in every prediction and measurement epoch */
+    void setEarthRotationUpdateDistance(double distance);
+
+    /* Relative change of the estimated inertia and damping parameters after which the precomputed
+     * motion model of the velocity constraint (only_affect_velocity) is assembled again, see EffortContext */
+    void setEffortModelTolerance(double tolerance);
+
+    /* Snapshot of the call counts, timings, gate rejections and NIS values per StatisticsChannel.
+     * Can be called from any thread, all counters are zero unless built with ENABLE_INSTRUMENTATION */
+    FilterStatistics getStatistics() const;
+
+    /* If enabled the log-likelihood of the innovations is computed, see SigmaPointFilter::setLikelihoodEnabled */
+    void setInnovationLikelihood(bool enabled);
+
+    /* Innovation statistics of the last measurement update */
+    const SigmaPointFilter<WState>::Innovation& getLastInnovation() const;
+
+    /* Upper bound of the error of the cached earth rotation vector in rad/s,
+     * given the distance moved since its evaluation and the spread of the sigma points */
+    double getEarthRotationErrorBound() const;
+
 protected:
     void predictionStepImpl(double delta_t);
 
+    /* Sigma point prediction of the full state. The process noise is scaled by noise_delta_t2, the sum of
+     * the squared intervals of the merged prediction steps. merged_rotation is the rotation of the merged
+     * steps, NULL rotates with the current rotation rate */
+    void fullPredictionStep(double delta_t, double noise_delta_t2, const ImuPreintegration* merged_rotation = NULL);
 
-    boost::shared_ptr<uwv_dynamic_model::DynamicModel> dynamic_model;
+    /* Full prediction interval given the motion of the mean state */
+    double adaptivePredictionPeriod() const;
+
+    /* Decides whether the next body effort update is applied and counts it */
+    bool scheduleEffortUpdate();
+
+    /* Mean-only propagation of the fast pose */
+    void propagateFastPose(FastPose& pose, double delta_t) const;
+
+    /* Evaluates the earth rotation at the current position if the update distance was exceeded */
+    void updateEarthRotation(bool force = false);
+
+    /* Swaps the water current states if the estimated position entered another cell of the map */
+    void updateWaterCurrentCell();
+
+    /* Update with a geographic position in the navigation frame */
+    void integrateProjectedPositionImpl(const XY_Position& projected_position, const Eigen::Vector3d& gps_in_body);
+
+    /* Integrates all queued measurements in one stacked update */
+    void integrateMeasurementBatch();
+
+    /* Steps of a full prediction before and after the propagation of the sigma points,
+     * prepareFullPrediction returns the factor of the process noise for the square-root backend, if any */
+    const Covariance* prepareFullPrediction(double delta_t, double noise_delta_t2);
+    void completeFullPrediction();
+
+    /* Generates the sigma points into a segment of the batch with the inputs of the process model,
+     * and completes the prediction from the propagated sigma points */
+    template<typename Scalar>
+    void storeSigmaPoints(BasicSigmaPointBatch<Scalar>& batch, unsigned segment);
+    template<typename Scalar>
+    void loadSigmaPoints(const BasicSigmaPointBatch<Scalar>& batch, unsigned segment, const Covariance* noise_factor);
+
+    boost::shared_ptr<ThreadPool> thread_pool;
+    boost::shared_ptr< SigmaPointFilter<WState> > sigma_point_filter;
+    boost::shared_ptr<FilterInstrumentation> instrumentation;
+    /* Motion models of the workers, starting at effort_model_offset */
+    boost::shared_ptr<const EffortModels> effort_models;
+    unsigned effort_model_offset;
+    boost::shared_ptr<EffortContext> velocity_effort_context;
+    boost::shared_ptr<ImuPreintegration> imu_preintegration;
     boost::shared_ptr<pose_estimation::GeographicProjection> projection;
     RotationRate::Mu rotation_rate;
     PoseUKFParameter filter_parameter;
+    LocationConfiguration location;
     InertiaType::vectorized_type inertia_offset;
     LinDampingType::vectorized_type lin_damping_offset;
     QuadDampingType::vectorized_type quad_damping_offset;
+    Eigen::Vector3d earth_rotation;
+    Eigen::Vector2d earth_rotation_position;
+    bool exact_earth_rotation;
+    double earth_rotation_update_distance;
+    InnovationGates gates;
+    MeasurementBatch measurement_batch;
+    bool batch_update;
+    boost::shared_ptr<WaterCurrentMap> water_current_map;
+    WaterCurrentMap::Key water_current_cell;
+    bool has_water_current_cell;
+    /* Sum of the full prediction intervals, the time base of the water current map */
+    double filter_time;
+    Covariance process_noise;
+    /* Factor of the process noise covariance and the covariance it was computed of */
+    Covariance factored_process_noise_cov;
+    Covariance process_noise_cov_factor;
+    bool process_noise_cov_factored;
+    bool has_process_noise_cov_factor;
+    Covariance process_noise_factor;
+    /* Process noise factor of the prediction between beginBatchedPrediction and commitBatchedPrediction */
+    const Covariance* batched_noise_factor;
+    PropagationPrecision propagation_precision;
+    SinglePrecisionSigmaPointBatch single_precision_batch;
+    bool structured_prediction;
+    double full_prediction_period;
+    bool adaptive_prediction;
+    AdaptivePredictionParameters adaptive_prediction_parameters;
+    double dynamic_model_min_depth;
+    bool effort_update_scheduling;
+    EffortUpdateSchedulingParameters effort_update_scheduling_parameters;
+    EffortUpdateStatistics effort_update_statistics;
+    unsigned effort_update_decimation;
+    double time_since_velocity_update;
+    unsigned long full_prediction_count;
+    double pending_delta_t;
+    /* Sum of the squared intervals and the rotation of the merged prediction steps */
+    double pending_delta_t2;
+    boost::shared_ptr<ImuPreintegration> pending_rotation;
+    FastPose fast_pose;
+    unsigned long state_revision;
+    LazyOutput<RotationRate::Mu> rotation_rate_output;
+    mutable LazyOutput< Eigen::Matrix<double, 6, 6> > pose_cov_output[2];
+    mutable LazyOutput<Eigen::Vector3d> geographic_position_output;
+    mutable LazyOutput<Eigen::Vector3d> body_velocity_output;
+    mutable LazyOutput<Eigen::Matrix3d> body_velocity_cov_output;
+    PoseUKFSmoother* smoother;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+/* The non-template members of the filter for the PoseState are instantiated once in PoseUKF.cpp.
+ * This does not cover the member templates (predict, structuredPredict, update, stackedUpdate and
+ * linearUpdate), they are instantiated implicitly with the models bound in PoseUKF.cpp, which is
+ * the only translation unit calling them */
+extern template class SigmaPointFilter<PoseUKF::WState>;
+
 }
 
 #endif
\ No newline at end of file
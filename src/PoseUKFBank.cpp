@@ -0,0 +1,174 @@
+#include "PoseUKFBank.hpp"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <Eigen/Cholesky>
+#include <pose_estimation/GeographicProjection.hpp>
+
+using namespace uwv_kalman_filters;
+
+PoseUKFBank::PoseUKFBank(const LocationConfiguration& location, unsigned threads)
+{
+    if(threads > 1)
+        thread_pool.reset(new ThreadPool(threads));
+    projection.reset(new pose_estimation::GeographicProjection(location.latitude, location.longitude));
+}
+
+unsigned PoseUKFBank::addHypothesis(const boost::shared_ptr<PoseUKF>& filter, double prior)
+{
+    if(!filter || !(prior > 0.))
+        throw std::invalid_argument("A hypothesis requires a filter and a positive prior");
+    filter->setInnovationLikelihood(true);
+    hypotheses.push_back(filter);
+    log_likelihoods.push_back(std::log(prior));
+    log_likelihood_sums.push_back(filter->getLastInnovation().log_likelihood_sum);
+    return hypotheses.size() - 1;
+}
+
+double PoseUKFBank::getProbability(unsigned index) const
+{
+    const double max_log_likelihood = log_likelihoods[getMostLikely()];
+    double sum = 0.;
+    for(std::size_t i = 0; i < log_likelihoods.size(); i++)
+        sum += std::exp(log_likelihoods[i] - max_log_likelihood);
+    return std::exp(log_likelihoods[index] - max_log_likelihood) / sum;
+}
+
+unsigned PoseUKFBank::getMostLikely() const
+{
+    if(log_likelihoods.empty())
+        throw std::out_of_range("The filter bank has no hypotheses");
+    return std::max_element(log_likelihoods.begin(), log_likelihoods.end()) - log_likelihoods.begin();
+}
+
+void PoseUKFBank::accumulateInnovation(std::size_t index)
+{
+    // a single call can evaluate several innovations, e.g. the acceleration of a pre-integrated prediction
+    const double log_likelihood_sum = hypotheses[index]->getLastInnovation().log_likelihood_sum;
+    log_likelihoods[index] += log_likelihood_sum - log_likelihood_sums[index];
+    log_likelihood_sums[index] = log_likelihood_sum;
+}
+
+void PoseUKFBank::predictionStep(double delta_t)
+{
+    auto update = [delta_t](PoseUKF& filter) { filter.predictionStep(delta_t); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::GeographicPosition& geo_position, const Eigen::Vector3d& gps_in_body)
+{
+    // project geographic position to local NWU plane once for all hypotheses
+    PoseUKF::XY_Position projected_position;
+    projection->worldToNav(geo_position.mu.x(), geo_position.mu.y(), projected_position.mu.x(), projected_position.mu.y());
+    projected_position.cov = geo_position.cov;
+
+    auto update = [&projected_position, &gps_in_body](PoseUKF& filter) { filter.integrateProjectedPosition(projected_position, gps_in_body); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::XY_Position& xy_position)
+{
+    auto update = [&xy_position](PoseUKF& filter) { filter.integrateMeasurement(xy_position); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::Z_Position& z_position)
+{
+    auto update = [&z_position](PoseUKF& filter) { filter.integrateMeasurement(z_position); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::RotationRate& rotation_rate)
+{
+    // only stored for the next prediction, not worth a fan out
+    for(std::size_t i = 0; i < hypotheses.size(); i++)
+        hypotheses[i]->integrateMeasurement(rotation_rate);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::Acceleration& acceleration)
+{
+    auto update = [&acceleration](PoseUKF& filter) { filter.integrateMeasurement(acceleration); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::Velocity& velocity)
+{
+    auto update = [&velocity](PoseUKF& filter) { filter.integrateMeasurement(velocity); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::BodyEffortsMeasurement& body_efforts, bool only_affect_velocity)
+{
+    auto update = [&body_efforts, only_affect_velocity](PoseUKF& filter) { filter.integrateMeasurement(body_efforts, only_affect_velocity); };
+    fanOut(update);
+}
+
+void PoseUKFBank::integrateMeasurement(const PoseUKF::WaterVelocityMeasurement& adcp_measurements, double cell_weighting)
+{
+    auto update = [&adcp_measurements, cell_weighting](PoseUKF& filter) { filter.integrateMeasurement(adcp_measurements, cell_weighting); };
+    fanOut(update);
+}
+
+void PoseUKFBank::remove(unsigned index)
+{
+    hypotheses.erase(hypotheses.begin() + index);
+    log_likelihoods.erase(log_likelihoods.begin() + index);
+    log_likelihood_sums.erase(log_likelihood_sums.begin() + index);
+}
+
+unsigned PoseUKFBank::prune(double min_likelihood_ratio)
+{
+    if(hypotheses.empty())
+        return 0;
+
+    const double threshold = log_likelihoods[getMostLikely()] + std::log(min_likelihood_ratio);
+    unsigned removed = 0;
+    for(unsigned i = hypotheses.size(); i-- > 0;)
+    {
+        if(log_likelihoods[i] < threshold)
+        {
+            remove(i);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+unsigned PoseUKFBank::merge(double max_mahalanobis2)
+{
+    unsigned removed = 0;
+    for(unsigned i = 0; i < hypotheses.size(); i++)
+    {
+        PoseUKF::State state_i;
+        PoseUKF::Covariance cov_i;
+        hypotheses[i]->getCurrentState(state_i, cov_i);
+        for(unsigned j = hypotheses.size(); j-- > i + 1;)
+        {
+            PoseUKF::State state_j;
+            PoseUKF::Covariance cov_j;
+            hypotheses[j]->getCurrentState(state_j, cov_j);
+
+            const PoseUKF::WState::vectorized_type delta = PoseUKF::WState(state_j) - PoseUKF::WState(state_i);
+            const PoseUKF::Covariance cov_sum = cov_i + cov_j;
+            const double mahalanobis2 = delta.dot(cov_sum.ldlt().solve(delta));
+            if(!(mahalanobis2 < max_mahalanobis2))
+                continue;
+
+            // the survivor carries the summed probability of both
+            const double max_log_likelihood = std::max(log_likelihoods[i], log_likelihoods[j]);
+            const double merged = max_log_likelihood + std::log(std::exp(log_likelihoods[i] - max_log_likelihood) +
+                                                                std::exp(log_likelihoods[j] - max_log_likelihood));
+            if(log_likelihoods[j] > log_likelihoods[i])
+            {
+                hypotheses[i] = hypotheses[j];
+                log_likelihood_sums[i] = log_likelihood_sums[j];
+                state_i = state_j;
+                cov_i = cov_j;
+            }
+            log_likelihoods[i] = merged;
+            remove(j);
+            removed++;
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,108 @@
+#ifndef _UWV_KALMAN_FILTERS_POSE_UKF_BANK_HPP_
+#define _UWV_KALMAN_FILTERS_POSE_UKF_BANK_HPP_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "PoseUKF.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Bank of PoseUKF hypotheses sharing one sensor stream.
+ *
+ * Each prediction and measurement is fanned out to all hypotheses on a thread pool,
+ * one hypothesis per task. Geographic positions are projected once for the whole bank,
+ * this requires all hypotheses to share the location given at construction.
+ * The log-likelihood of every evaluated innovation is accumulated per hypothesis,
+ * including the ones rejected by a gate, which allows to prune and merge
+ * hypotheses by their posterior probability.
+ *
+ * The per hypothesis data is stored as structure of arrays.
+ */
+class PoseUKFBank
+{
+public:
+    PoseUKFBank(const LocationConfiguration& location, unsigned threads = 1);
+
+    /* Adds a hypothesis with the given prior probability, returns its index.
+     * The hypothesis must not be integrated in batch mode, the bank enables its innovation likelihood */
+    unsigned addHypothesis(const boost::shared_ptr<PoseUKF>& filter, double prior = 1.);
+
+    /* Number of hypotheses */
+    unsigned size() const { return hypotheses.size(); }
+
+    const boost::shared_ptr<PoseUKF>& getHypothesis(unsigned index) const { return hypotheses[index]; }
+
+    /* Accumulated log-likelihood of the hypothesis including its prior */
+    double getLogLikelihood(unsigned index) const { return log_likelihoods[index]; }
+
+    /* Posterior probability of the hypothesis, normalized over the bank */
+    double getProbability(unsigned index) const;
+
+    /* Index of the hypothesis with the highest posterior probability */
+    unsigned getMostLikely() const;
+
+    void predictionStep(double delta_t);
+
+    void integrateMeasurement(const PoseUKF::GeographicPosition& geo_position,
+                              const Eigen::Vector3d& gps_in_body = Eigen::Vector3d::Zero());
+    void integrateMeasurement(const PoseUKF::XY_Position& xy_position);
+    void integrateMeasurement(const PoseUKF::Z_Position& z_position);
+    void integrateMeasurement(const PoseUKF::RotationRate& rotation_rate);
+    void integrateMeasurement(const PoseUKF::Acceleration& acceleration);
+    void integrateMeasurement(const PoseUKF::Velocity& velocity);
+    void integrateMeasurement(const PoseUKF::BodyEffortsMeasurement& body_efforts, bool only_affect_velocity = false);
+    void integrateMeasurement(const PoseUKF::WaterVelocityMeasurement& adcp_measurements, double cell_weighting);
+
+    /* Removes all hypotheses with a likelihood below min_likelihood_ratio times the one of the most likely.
+     * Returns the number of removed hypotheses */
+    unsigned prune(double min_likelihood_ratio);
+
+    /* Merges hypotheses with a squared Mahalanobis distance of their means below max_mahalanobis2,
+     * given the sum of their covariances. The more likely one is kept and receives the probability
+     * of the other one. Returns the number of removed hypotheses */
+    unsigned merge(double max_mahalanobis2);
+
+protected:
+    template<typename Update>
+    struct UpdateTask
+    {
+        PoseUKFBank& bank;
+        Update& update;
+        UpdateTask(PoseUKFBank& bank, Update& update) : bank(bank), update(update) {}
+        void operator()(std::size_t index, unsigned)
+        {
+            update(*bank.hypotheses[index]);
+            bank.accumulateInnovation(index);
+        }
+    };
+
+    /* Calls update(filter) for every hypothesis and accumulates all the innovations it evaluated */
+    template<typename Update>
+    void fanOut(Update& update)
+    {
+        UpdateTask<Update> task(*this, update);
+        if(thread_pool)
+            thread_pool->parallelFor(hypotheses.size(), task);
+        else
+        {
+            for(std::size_t i = 0; i < hypotheses.size(); i++)
+                task(i, 0);
+        }
+    }
+
+    void accumulateInnovation(std::size_t index);
+    void remove(unsigned index);
+
+    boost::shared_ptr<ThreadPool> thread_pool;
+    boost::shared_ptr<pose_estimation::GeographicProjection> projection;
+    std::vector< boost::shared_ptr<PoseUKF> > hypotheses;
+    std::vector<double> log_likelihoods;
+    /* Sum of the innovation log-likelihoods of the hypothesis at its last accumulation */
+    std::vector<double> log_likelihood_sums;
+};
+
+}
+
+#endif
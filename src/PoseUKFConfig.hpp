@@ -85,6 +85,84 @@ struct DynamicModelNoiseParameters
     double quad_damping_tau;
 };
 
+struct AdaptivePredictionParameters
+{
+    /* Max rotation in radians integrated in one prediction step */
+    double max_rotation_step;
+
+    /* Max change of velocity in m/s integrated in one prediction step */
+    double max_velocity_step;
+
+    /* Max distance in meters integrated in one prediction step */
+    double max_position_step;
+
+    /* Bounds of the prediction interval in seconds */
+    double min_period;
+    double max_period;
+
+    AdaptivePredictionParameters() : max_rotation_step(0.005), max_velocity_step(0.01), max_position_step(0.05),
+                                     min_period(0.002), max_period(0.2) {}
+};
+
+struct EffortUpdateSchedulingParameters
+{
+    /* A velocity measurement within this period in seconds indicates a healthy DVL bottom lock */
+    double velocity_timeout;
+
+    /* Largest standard deviation of the velocity states in m/s which is considered as tight */
+    double max_velocity_std;
+
+    /* With a healthy bottom lock and a tight velocity only every n-th effort update is applied.
+     * Zero skips all of them */
+    unsigned decimation;
+
+    EffortUpdateSchedulingParameters() : velocity_timeout(1.), max_velocity_std(0.05), decimation(10) {}
+};
+
+struct InnovationGateParameters
+{
+    /* Confidence of the chi-square gate of each measurement type.
+     * A value outside of (0, 1) accepts any innovation */
+    double velocity;
+    double acceleration;
+    double z_position;
+    double xy_position;
+    double geographic_position;
+    double body_efforts;
+    double water_velocity;
+
+    InnovationGateParameters() : velocity(0.), acceleration(0.), z_position(0.), xy_position(0.95),
+                                 geographic_position(0.95), body_efforts(0.), water_velocity(0.95) {}
+};
+
+/* Sets of sigma points of the unscented transformation, n is the dimension of the state */
+enum SigmaPointScheme
+{
+    /* 2n + 1 points at mu and mu +- the columns of the Cholesky factor, all of equal weight */
+    SYMMETRIC_SIGMA_POINTS,
+    /* 2n + 1 points of the scaled unscented transformation, see SigmaPointParameters */
+    SCALED_UNSCENTED,
+    /* n + 2 points of the spherical simplex set */
+    SPHERICAL_SIMPLEX,
+    /* 2n points of the third degree spherical radial cubature rule */
+    CUBATURE
+};
+
+struct SigmaPointParameters
+{
+    SigmaPointScheme scheme;
+
+    /* Spread, prior distribution and secondary scaling parameter of SCALED_UNSCENTED */
+    double alpha;
+    double beta;
+    double kappa;
+
+    /* Weight of the central point of SPHERICAL_SIMPLEX in [0, 1) */
+    double center_weight;
+
+    SigmaPointParameters() : scheme(SYMMETRIC_SIGMA_POINTS), alpha(1.), beta(2.), kappa(0.), center_weight(0.) {}
+};
+
 struct LocationConfiguration
 {
     /* Latitude in radians */
@@ -126,6 +204,12 @@ struct PoseUKFConfig
 
     /* Minimum depth of the AUV to apply the dynamic model  */
     double dynamic_model_min_depth;
+
+    /* Outlier rejection of the measurement updates */
+    InnovationGateParameters innovation_gates;
+
+    /* Sigma point set of the unscented transformations */
+    SigmaPointParameters sigma_points;
 };
 
 }
@@ -0,0 +1,154 @@
+#include "PoseUKFHistory.hpp"
+#include "MissionReplay.hpp"
+
+using namespace uwv_kalman_filters;
+
+PoseUKFHistory::PoseUKFHistory(PoseUKF& filter, const base::Time& time, unsigned max_epochs, unsigned max_measurements) :
+    filter(filter), epochs(max_epochs), measurements(max_measurements), delayed_count(0), dropped_count(0)
+{
+    Epoch epoch;
+    epoch.time = time.toMicroseconds();
+    epoch.delta_t = 0.;
+    filter.saveCheckpoint(epoch.checkpoint);
+    epochs.push_back(epoch);
+}
+
+base::Time PoseUKFHistory::getTime() const
+{
+    return base::Time::fromMicroseconds(epochs.back().time);
+}
+
+void PoseUKFHistory::predictionStep(const base::Time& time)
+{
+    const int64_t current_time = epochs.back().time;
+    if(time.toMicroseconds() <= current_time)
+        return;
+
+    const double delta_t = double(time.toMicroseconds() - current_time) * 1e-6;
+    filter.predictionStep(delta_t);
+
+    // the checkpoint is saved directly into the slot of the new epoch, which replaces the oldest one if full
+    Epoch& epoch = epochs.extend_back();
+    epoch.time = time.toMicroseconds();
+    epoch.delta_t = delta_t;
+    filter.saveCheckpoint(epoch.checkpoint);
+
+    // measurements before the oldest epoch are never integrated again
+    while(!measurements.empty() && measurements.front().time < epochs.front().time)
+        measurements.pop_front();
+}
+
+bool PoseUKFHistory::integrateMeasurement(const MissionLogRecord& record)
+{
+    if(measurements.full())
+        dropOldestMeasurement();
+
+    if(record.time < epochs.front().time)
+    {
+        dropped_count++;
+        return false;
+    }
+
+    // in sequence measurements are integrated directly
+    if(measurements.empty() || record.time >= measurements.back().time)
+    {
+        if(record.time >= epochs.back().time)
+        {
+            measurements.push_back(record);
+            return integrateRecord(filter, record);
+        }
+    }
+
+    // insert behind all measurements of the same time
+    std::size_t index = measurements.size();
+    while(index > 0 && measurements[index - 1].time > record.time)
+        index--;
+    measurements.insert(index, record);
+
+    std::size_t epoch = epochs.size() - 1;
+    while(epoch > 0 && epochs[epoch].time > record.time)
+        epoch--;
+    repropagate(epoch);
+    delayed_count++;
+    return true;
+}
+
+void PoseUKFHistory::repropagate(std::size_t epoch)
+{
+    filter.restoreCheckpoint(epochs[epoch].checkpoint);
+
+    std::size_t measurement = 0;
+    while(measurement < measurements.size() && measurements[measurement].time < epochs[epoch].time)
+        measurement++;
+
+    for(std::size_t i = epoch; i < epochs.size(); i++)
+    {
+        if(i > epoch)
+        {
+            filter.predictionStep(epochs[i].delta_t);
+            filter.saveCheckpoint(epochs[i].checkpoint);
+        }
+
+        const bool last_epoch = i + 1 == epochs.size();
+        while(measurement < measurements.size() && (last_epoch || measurements[measurement].time < epochs[i + 1].time))
+        {
+            integrateRecord(filter, measurements[measurement]);
+            measurement++;
+        }
+    }
+}
+
+void PoseUKFHistory::dropOldestMeasurement()
+{
+    const int64_t dropped_time = measurements.front().time;
+    measurements.pop_front();
+
+    // epochs the measurement belongs to can't be re-propagated anymore
+    while(epochs.size() > 1 && epochs.front().time <= dropped_time)
+        epochs.pop_front();
+    while(!measurements.empty() && measurements.front().time < epochs.front().time)
+        measurements.pop_front();
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::GeographicPosition& geo_position,
+                                          const Eigen::Vector3d& gps_in_body)
+{
+    return integrate(LOG_GEOGRAPHIC_POSITION, time, geo_position, gps_in_body);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::XY_Position& xy_position)
+{
+    return integrate(LOG_XY_POSITION, time, xy_position);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::Z_Position& z_position)
+{
+    return integrate(LOG_Z_POSITION, time, z_position);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::RotationRate& rotation_rate)
+{
+    return integrate(LOG_ROTATION_RATE, time, rotation_rate);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::Acceleration& acceleration)
+{
+    return integrate(LOG_ACCELERATION, time, acceleration);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::Velocity& velocity)
+{
+    return integrate(LOG_VELOCITY, time, velocity);
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::BodyEffortsMeasurement& body_efforts,
+                                          bool only_affect_velocity)
+{
+    return integrate(LOG_BODY_EFFORTS, time, body_efforts, Eigen::Vector3d(only_affect_velocity ? 1. : 0., 0., 0.));
+}
+
+bool PoseUKFHistory::integrateMeasurement(const base::Time& time, const PoseUKF::WaterVelocityMeasurement& adcp_measurements,
+                                          double cell_weighting)
+{
+    return integrate(LOG_WATER_VELOCITY, time, adcp_measurements, Eigen::Vector3d(cell_weighting, 0., 0.));
+}
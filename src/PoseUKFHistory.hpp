@@ -0,0 +1,97 @@
+#ifndef _UWV_KALMAN_FILTERS_POSE_UKF_HISTORY_HPP_
+#define _UWV_KALMAN_FILTERS_POSE_UKF_HISTORY_HPP_
+
+#include <base/Time.hpp>
+#include <Eigen/StdVector>
+#include "PoseUKF.hpp"
+#include "MissionLog.hpp"
+#include "RingBuffer.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Bounded history of a PoseUKF, which allows to integrate delayed measurements at their true time.
+ *
+ * Each prediction step starts a new epoch, for which the filter state and inputs after the
+ * prediction are stored. All measurements are stored in time order as well.
+ * A measurement older than the newest one is inserted at its time stamp, the filter is
+ * restored to the epoch it belongs to and re-propagated to the current time, integrating
+ * all following measurements again. The stored epochs are updated on the way.
+ * Measurements older than the oldest epoch are dropped.
+ *
+ * Epochs and measurements are kept in ring buffers allocated at construction, the
+ * measurement capacity should cover all measurements within the epoch capacity.
+ * The filter must not be used in batch mode (beginUpdate) together with the history.
+ */
+class PoseUKFHistory
+{
+public:
+    PoseUKFHistory(PoseUKF& filter, const base::Time& time, unsigned max_epochs = 50, unsigned max_measurements = 500);
+
+    /* Time of the filter state */
+    base::Time getTime() const;
+
+    /* Predicts the filter to the given time, older time stamps are ignored */
+    void predictionStep(const base::Time& time);
+
+    /* The measurements are integrated at the given time stamp.
+     * Returns false if the measurement is older than the history and was dropped */
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::GeographicPosition& geo_position,
+                              const Eigen::Vector3d& gps_in_body = Eigen::Vector3d::Zero());
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::XY_Position& xy_position);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::Z_Position& z_position);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::RotationRate& rotation_rate);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::Acceleration& acceleration);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::Velocity& velocity);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::BodyEffortsMeasurement& body_efforts,
+                              bool only_affect_velocity = false);
+    bool integrateMeasurement(const base::Time& time, const PoseUKF::WaterVelocityMeasurement& adcp_measurements,
+                              double cell_weighting);
+
+    /* Integrates the measurement of a record at its time stamp */
+    bool integrateMeasurement(const MissionLogRecord& record);
+
+    /* Number of measurements which were integrated by re-propagation */
+    unsigned long getDelayedCount() const { return delayed_count; }
+
+    /* Number of measurements which were older than the history */
+    unsigned long getDroppedCount() const { return dropped_count; }
+
+protected:
+    struct Epoch
+    {
+        int64_t time;
+        /* Prediction from the previous epoch */
+        double delta_t;
+        PoseUKF::Checkpoint checkpoint;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    template<typename Measurement>
+    bool integrate(MissionLogRecordType type, const base::Time& time, const Measurement& measurement,
+                   const Eigen::Vector3d& aux = Eigen::Vector3d::Zero())
+    {
+        record.setMeasurement(type, time.toMicroseconds(), measurement.mu, measurement.cov);
+        for(unsigned i = 0; i < 3; i++)
+            record.aux[i] = aux[i];
+        return integrateMeasurement(record);
+    }
+
+    /* Restores the filter to the given epoch and integrates all following predictions and measurements */
+    void repropagate(std::size_t epoch);
+
+    /* Removes the measurement of the oldest time and all epochs it belongs to */
+    void dropOldestMeasurement();
+
+    PoseUKF& filter;
+    RingBuffer< Epoch, Eigen::aligned_allocator<Epoch> > epochs;
+    RingBuffer<MissionLogRecord> measurements;
+    MissionLogRecord record;
+    unsigned long delayed_count;
+    unsigned long dropped_count;
+};
+
+}
+
+#endif
@@ -0,0 +1,326 @@
+#include "PoseUKFSmoother.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace uwv_kalman_filters;
+
+typedef PoseUKF::WState::vectorized_type VectorizedState;
+
+static void packCovariance(const PoseUKF::Covariance& cov, double* packed)
+{
+    for(unsigned j = 0, k = 0; j < PoseUKF::WState::DOF; j++)
+        for(unsigned i = j; i < PoseUKF::WState::DOF; i++)
+            packed[k++] = cov(i, j);
+}
+
+static void unpackCovariance(const double* packed, PoseUKF::Covariance& cov)
+{
+    for(unsigned j = 0, k = 0; j < PoseUKF::WState::DOF; j++)
+        for(unsigned i = j; i < PoseUKF::WState::DOF; i++, k++)
+            cov(i, j) = cov(j, i) = packed[k];
+}
+
+static void initializeHeader(PoseUKFSmootherLogHeader& header, uint32_t magic, uint32_t record_size, uint64_t record_count)
+{
+    std::memset(&header, 0, sizeof(PoseUKFSmootherLogHeader));
+    header.magic = magic;
+    header.version = PoseUKFSmootherLogHeader::VERSION;
+    header.record_size = record_size;
+    header.dof = PoseUKF::WState::DOF;
+    header.record_count = record_count;
+}
+
+/* Maps a smoother or smoothed log and validates its header, returns the first record */
+static const void* mapLog(const std::string& path, uint32_t magic, uint32_t record_size,
+                          void*& data, std::size_t& data_size, std::size_t& record_count)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open smoother log " + path);
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || std::size_t(file_stat.st_size) < sizeof(PoseUKFSmootherLogHeader))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid smoother log " + path);
+    }
+    data_size = file_stat.st_size;
+    data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        data = NULL;
+        throw std::runtime_error("Failed to map smoother log " + path);
+    }
+
+    const PoseUKFSmootherLogHeader* header = static_cast<const PoseUKFSmootherLogHeader*>(data);
+    if(header->magic != magic || header->version != PoseUKFSmootherLogHeader::VERSION ||
+        header->record_size != record_size || header->dof != PoseUKF::WState::DOF ||
+        header->record_count > (data_size - sizeof(PoseUKFSmootherLogHeader)) / record_size)
+    {
+        munmap(data, data_size);
+        data = NULL;
+        throw std::runtime_error("Invalid smoother log " + path);
+    }
+    record_count = header->record_count;
+    return static_cast<const char*>(data) + sizeof(PoseUKFSmootherLogHeader);
+}
+
+PoseUKFSmoother::PoseUKFSmoother(PoseUKF& filter, unsigned max_epochs, const std::string& log_path) :
+    filter(filter), epochs(max_epochs), current_epoch(NULL), epoch_count(0), time(0.), restarted(true),
+    log(NULL), log_failed(false)
+{
+    if(!log_path.empty())
+    {
+        log = std::fopen(log_path.c_str(), "wb");
+        if(!log)
+            throw std::runtime_error("Failed to open smoother log " + log_path);
+        // the header is completed in closeLog
+        PoseUKFSmootherLogHeader header;
+        initializeHeader(header, PoseUKFSmootherLogHeader::SMOOTHER_MAGIC, sizeof(PoseUKFSmootherRecord), 0);
+        if(std::fwrite(&header, sizeof(PoseUKFSmootherLogHeader), 1, log) != 1)
+        {
+            std::fclose(log);
+            throw std::runtime_error("Failed to write smoother log " + log_path);
+        }
+        record.reset(new PoseUKFSmootherRecord());
+    }
+    filter.setSmoother(this);
+}
+
+PoseUKFSmoother::~PoseUKFSmoother()
+{
+    filter.setSmoother(NULL);
+    try
+    {
+        closeLog();
+    }
+    catch(const std::runtime_error&)
+    {
+        // a destructor must not throw, closeLog reports the error if called explicitly
+    }
+}
+
+void PoseUKFSmoother::closeLog()
+{
+    if(!log)
+        return;
+
+    PoseUKFSmootherLogHeader header;
+    initializeHeader(header, PoseUKFSmootherLogHeader::SMOOTHER_MAGIC, sizeof(PoseUKFSmootherRecord), epoch_count);
+    bool success = !log_failed && std::fseek(log, 0, SEEK_SET) == 0 &&
+                   std::fwrite(&header, sizeof(PoseUKFSmootherLogHeader), 1, log) == 1;
+    success = std::fclose(log) == 0 && success;
+    log = NULL;
+    if(!success)
+        throw std::runtime_error("Failed to write smoother log");
+}
+
+void PoseUKFSmoother::beginEpoch(double delta_t, const PoseUKF::WState& mu, const PoseUKF::Covariance& sigma)
+{
+    // an epoch whose prediction failed is reused
+    if(!current_epoch)
+        current_epoch = &epochs.extend_back();
+    current_epoch->time = time;
+    current_epoch->restart = restarted;
+    current_epoch->filtered_mu = mu;
+    current_epoch->filtered_sigma = sigma;
+    time += delta_t;
+}
+
+void PoseUKFSmoother::endEpoch(const PoseUKF::WState& mu, const PoseUKF::Covariance& sigma, const PoseUKF::Covariance& cross_sigma)
+{
+    if(!current_epoch)
+        return;
+    current_epoch->predicted_mu = mu;
+    current_epoch->predicted_sigma = sigma;
+    current_epoch->cross_sigma = cross_sigma;
+
+    if(log && !log_failed)
+    {
+        encode(*current_epoch, *record);
+        log_failed = std::fwrite(record.get(), sizeof(PoseUKFSmootherRecord), 1, log) != 1;
+    }
+    epoch_count++;
+
+    current_epoch = NULL;
+    restarted = false;
+}
+
+void PoseUKFSmoother::restart()
+{
+    epochs.clear();
+    current_epoch = NULL;
+    restarted = true;
+}
+
+bool PoseUKFSmoother::getSmoothedState(unsigned lag, SmoothedPoseState& smoothed) const
+{
+    // an epoch whose prediction failed is not complete
+    const std::size_t count = epochs.size() - (current_epoch ? 1 : 0);
+    if(lag > count)
+        return false;
+
+    // the backward pass starts from the current filter state
+    PoseUKF::State state;
+    filter.getCurrentState(state, smoothed.sigma);
+    smoothed.mu = state;
+    smoothed.time = time;
+    for(std::size_t k = count; k > count - lag; k--)
+        smoothEpoch(epochs[k - 1], smoothed);
+    return true;
+}
+
+void PoseUKFSmoother::smoothEpoch(const Epoch& epoch, SmoothedPoseState& smoothed)
+{
+    // smoother gain G = C * P'^-1
+    Eigen::LLT<PoseUKF::Covariance> llt(epoch.predicted_sigma);
+    if(llt.info() != Eigen::Success)
+        throw std::runtime_error("Cholesky decomposition of the predicted covariance failed");
+    const PoseUKF::Covariance gain = llt.solve(epoch.cross_sigma.transpose()).transpose();
+
+    const VectorizedState correction = gain * VectorizedState(smoothed.mu - epoch.predicted_mu);
+    smoothed.mu = epoch.filtered_mu + correction;
+    const PoseUKF::Covariance sigma = epoch.filtered_sigma + gain * (smoothed.sigma - epoch.predicted_sigma) * gain.transpose();
+    smoothed.sigma = 0.5 * (sigma + sigma.transpose());
+    smoothed.time = epoch.time;
+}
+
+void PoseUKFSmoother::encode(const Epoch& epoch, PoseUKFSmootherRecord& record)
+{
+    record.time = epoch.time;
+    record.flags = epoch.restart ? PoseUKFSmootherRecord::RESTART : 0;
+    Eigen::Map<VectorizedState>(record.filtered_mu) = epoch.filtered_mu - PoseUKF::WState();
+    packCovariance(epoch.filtered_sigma, record.filtered_sigma);
+    Eigen::Map<VectorizedState>(record.predicted_mu) = epoch.predicted_mu - PoseUKF::WState();
+    packCovariance(epoch.predicted_sigma, record.predicted_sigma);
+    Eigen::Map<PoseUKF::Covariance>(record.cross_sigma) = epoch.cross_sigma;
+}
+
+void PoseUKFSmoother::decode(const PoseUKFSmootherRecord& record, Epoch& epoch)
+{
+    epoch.time = record.time;
+    epoch.restart = record.flags & PoseUKFSmootherRecord::RESTART;
+    epoch.filtered_mu = PoseUKF::WState() + VectorizedState(Eigen::Map<const VectorizedState>(record.filtered_mu));
+    unpackCovariance(record.filtered_sigma, epoch.filtered_sigma);
+    epoch.predicted_mu = PoseUKF::WState() + VectorizedState(Eigen::Map<const VectorizedState>(record.predicted_mu));
+    unpackCovariance(record.predicted_sigma, epoch.predicted_sigma);
+    epoch.cross_sigma = Eigen::Map<const PoseUKF::Covariance>(record.cross_sigma);
+}
+
+std::size_t PoseUKFSmoother::smoothLog(const std::string& log_path, const std::string& output_path,
+                                       unsigned segment_length, unsigned overlap,
+                                       const boost::shared_ptr<ThreadPool>& thread_pool)
+{
+    if(segment_length == 0)
+        throw std::invalid_argument("The segment length must be positive");
+
+    void* data = NULL;
+    std::size_t data_size = 0;
+    std::size_t count = 0;
+    const PoseUKFSmootherRecord* records = static_cast<const PoseUKFSmootherRecord*>(
+            mapLog(log_path, PoseUKFSmootherLogHeader::SMOOTHER_MAGIC, sizeof(PoseUKFSmootherRecord), data, data_size, count));
+    // the segments are read backwards
+    madvise(data, data_size, MADV_RANDOM);
+
+    int fd = open(output_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        munmap(data, data_size);
+        throw std::runtime_error("Failed to open smoothed log " + output_path);
+    }
+    PoseUKFSmootherLogHeader header;
+    initializeHeader(header, PoseUKFSmootherLogHeader::SMOOTHED_MAGIC, sizeof(PoseUKFSmoothedRecord), count);
+    bool success = ::write(fd, &header, sizeof(PoseUKFSmootherLogHeader)) == ssize_t(sizeof(PoseUKFSmootherLogHeader)) &&
+                   ftruncate(fd, sizeof(PoseUKFSmootherLogHeader) + count * sizeof(PoseUKFSmoothedRecord)) == 0;
+
+    // scratch data of each worker
+    const unsigned workers = thread_pool ? thread_pool->size() : 1;
+    std::vector< Epoch, Eigen::aligned_allocator<Epoch> > epochs(workers);
+    std::vector< SmoothedPoseState, Eigen::aligned_allocator<SmoothedPoseState> > smoothed(workers);
+    std::vector<PoseUKFSmoothedRecord> output(workers);
+
+    auto smooth_segment = [&](std::size_t segment, unsigned worker)
+    {
+        const std::size_t begin = segment * segment_length;
+        const std::size_t end = std::min<std::size_t>(begin + segment_length, count);
+        const std::size_t start = std::min<std::size_t>(end + overlap, count) - 1;
+        Epoch& epoch = epochs[worker];
+        SmoothedPoseState& state = smoothed[worker];
+        PoseUKFSmoothedRecord& record = output[worker];
+        for(std::size_t k = start + 1; k-- > begin;)
+        {
+            decode(records[k], epoch);
+            if(k == start || (records[k + 1].flags & PoseUKFSmootherRecord::RESTART))
+            {
+                // the last epoch of a chain is smoothed by its filtered moments
+                state.time = epoch.time;
+                state.mu = epoch.filtered_mu;
+                state.sigma = epoch.filtered_sigma;
+            }
+            else
+                smoothEpoch(epoch, state);
+
+            if(k < end)
+            {
+                record.time = state.time;
+                Eigen::Map<VectorizedState>(record.mu) = state.mu - PoseUKF::WState();
+                packCovariance(state.sigma, record.sigma);
+                const off_t offset = sizeof(PoseUKFSmootherLogHeader) + k * sizeof(PoseUKFSmoothedRecord);
+                if(pwrite(fd, &record, sizeof(PoseUKFSmoothedRecord), offset) != ssize_t(sizeof(PoseUKFSmoothedRecord)))
+                    throw std::runtime_error("Failed to write smoothed log " + output_path);
+            }
+        }
+    };
+
+    try
+    {
+        const std::size_t segments = (count + segment_length - 1) / segment_length;
+        if(success && thread_pool)
+            thread_pool->parallelFor(segments, smooth_segment);
+        else if(success)
+        {
+            for(std::size_t i = 0; i < segments; i++)
+                smooth_segment(i, 0);
+        }
+    }
+    catch(...)
+    {
+        close(fd);
+        munmap(data, data_size);
+        throw;
+    }
+
+    success = close(fd) == 0 && success;
+    munmap(data, data_size);
+    if(!success)
+        throw std::runtime_error("Failed to write smoothed log " + output_path);
+    return count;
+}
+
+SmoothedPoseLog::SmoothedPoseLog(const std::string& path) : data(NULL), data_size(0), records(NULL), record_count(0)
+{
+    records = static_cast<const PoseUKFSmoothedRecord*>(
+            mapLog(path, PoseUKFSmootherLogHeader::SMOOTHED_MAGIC, sizeof(PoseUKFSmoothedRecord), data, data_size, record_count));
+}
+
+SmoothedPoseLog::~SmoothedPoseLog()
+{
+    if(data)
+        munmap(data, data_size);
+}
+
+void SmoothedPoseLog::get(std::size_t index, SmoothedPoseState& smoothed) const
+{
+    if(index >= record_count)
+        throw std::out_of_range("Index exceeds the smoothed log");
+    const PoseUKFSmoothedRecord& record = records[index];
+    smoothed.time = record.time;
+    smoothed.mu = PoseUKF::WState() + VectorizedState(Eigen::Map<const VectorizedState>(record.mu));
+    unpackCovariance(record.sigma, smoothed.sigma);
+}
@@ -0,0 +1,183 @@
+#ifndef _UWV_KALMAN_FILTERS_POSE_UKF_SMOOTHER_HPP_
+#define _UWV_KALMAN_FILTERS_POSE_UKF_SMOOTHER_HPP_
+
+#include <cstdio>
+#include <string>
+#include <Eigen/StdVector>
+#include "PoseUKF.hpp"
+#include "RingBuffer.hpp"
+
+namespace uwv_kalman_filters
+{
+
+class ThreadPool;
+
+/* Smoothed moments of the state, the time is given in seconds since the smoother was attached */
+struct SmoothedPoseState
+{
+    double time;
+    PoseUKF::WState mu;
+    PoseUKF::Covariance sigma;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/* Record of one forward epoch in a smoother log.
+ * The states are stored as boxminus of the state and WState(), the symmetric
+ * covariances as their lower triangle in column-major order */
+struct PoseUKFSmootherRecord
+{
+    enum { DOF = PoseUKF::WState::DOF, PACKED_COV = DOF * (DOF + 1) / 2 };
+    enum Flags { RESTART = 1 };
+
+    /* Time of the filtered moments */
+    double time;
+    /* RESTART if the filtered moments don't follow the prediction of the previous epoch */
+    uint64_t flags;
+    double filtered_mu[DOF];
+    double filtered_sigma[PACKED_COV];
+    double predicted_mu[DOF];
+    double predicted_sigma[PACKED_COV];
+    /* Cross covariance of the filtered and predicted state in column-major order */
+    double cross_sigma[DOF * DOF];
+};
+
+/* Record of a smoothed log, the covariance is stored as in the PoseUKFSmootherRecord */
+struct PoseUKFSmoothedRecord
+{
+    enum { DOF = PoseUKF::WState::DOF, PACKED_COV = DOF * (DOF + 1) / 2 };
+
+    double time;
+    double mu[DOF];
+    double sigma[PACKED_COV];
+};
+
+/* File header of the smoother and smoothed logs, followed by record_count records */
+struct PoseUKFSmootherLogHeader
+{
+    enum { SMOOTHER_MAGIC = 0x52565755, SMOOTHED_MAGIC = 0x53525755, VERSION = 1 }; // "UWVR", "UWRS"
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t dof;
+    uint64_t record_count;
+};
+
+/**
+ * Unscented Rauch-Tung-Striebel smoother on top of a PoseUKF.
+ *
+ * Once attached, the moments of the state before and after each full prediction of the filter
+ * are recorded together with the cross covariance of both, see SigmaPointFilter::setCrossCovarianceEnabled.
+ * The last max_epochs epochs are kept in a ring buffer allocated at construction, which allows
+ * fixed-lag smoothing with getSmoothedState. For the full batch smoothing of long missions all
+ * epochs can additionally be streamed to a log file, which is smoothed backwards by smoothLog.
+ *
+ * The backward pass is evaluated on the manifold: the correction G * (x_s' [-] x') of the predicted
+ * state is applied to the filtered state with [+]. The covariances are expressed in the tangent spaces
+ * of the respective means, the transport between them is neglected as in the forward filter.
+ * Restoring a checkpoint starts a new chain, the epochs in memory are discarded. Swaps of the
+ * water current states (see PoseUKF::setWaterCurrentMap) are treated as a measurement update.
+ * The smoother has to be used from the thread which updates the filter.
+ */
+class PoseUKFSmoother
+{
+public:
+    /* Attaches the smoother to the filter, an existing log file at log_path is replaced.
+     * Throws std::runtime_error if the log file can't be created */
+    PoseUKFSmoother(PoseUKF& filter, unsigned max_epochs = 100, const std::string& log_path = std::string());
+
+    /* Detaches from the filter and completes the log file */
+    ~PoseUKFSmoother();
+
+    /* Number of epochs in memory */
+    std::size_t size() const { return epochs.size(); }
+
+    /* Number of epochs recorded since construction */
+    unsigned long getEpochCount() const { return epoch_count; }
+
+    /* Smoothes the state at the beginning of the lag-th newest epoch in memory, given the current filter state.
+     * Returns false if less than lag epochs are in memory. A lag of size() smoothes the whole buffer */
+    bool getSmoothedState(unsigned lag, SmoothedPoseState& smoothed) const;
+
+    /* Writes the header of the log file and closes it, the following epochs are only kept in memory.
+     * Throws std::runtime_error if the log can't be written */
+    void closeLog();
+
+    /* Called by the filter before and after each full prediction */
+    void beginEpoch(double delta_t, const PoseUKF::WState& mu, const PoseUKF::Covariance& sigma);
+    void endEpoch(const PoseUKF::WState& mu, const PoseUKF::Covariance& sigma, const PoseUKF::Covariance& cross_sigma);
+
+    /* Called by the filter if its state was restored */
+    void restart();
+
+    /* Smoothes all epochs of a smoother log and writes one PoseUKFSmoothedRecord per epoch to output_path.
+     * The log is split into segments of segment_length epochs, which are smoothed concurrently by the thread pool,
+     * if given. The backward pass of a segment starts overlap epochs after its end from the filtered moments,
+     * as a fixed-lag smoother would. The last segment and all segments with an overlap reaching the end of
+     * the log are exact. Returns the number of smoothed epochs, throws std::runtime_error on I/O errors */
+    static std::size_t smoothLog(const std::string& log_path, const std::string& output_path,
+                                 unsigned segment_length = 1000, unsigned overlap = 200,
+                                 const boost::shared_ptr<ThreadPool>& thread_pool = boost::shared_ptr<ThreadPool>());
+
+protected:
+    struct Epoch
+    {
+        double time;
+        bool restart;
+        PoseUKF::WState filtered_mu;
+        PoseUKF::Covariance filtered_sigma;
+        PoseUKF::WState predicted_mu;
+        PoseUKF::Covariance predicted_sigma;
+        PoseUKF::Covariance cross_sigma;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /* Smoothed moments of the epoch given the smoothed moments of the following one */
+    static void smoothEpoch(const Epoch& epoch, SmoothedPoseState& smoothed);
+
+    static void encode(const Epoch& epoch, PoseUKFSmootherRecord& record);
+    static void decode(const PoseUKFSmootherRecord& record, Epoch& epoch);
+
+    PoseUKF& filter;
+    RingBuffer< Epoch, Eigen::aligned_allocator<Epoch> > epochs;
+    Epoch* current_epoch;
+    unsigned long epoch_count;
+    double time;
+    bool restarted;
+    std::FILE* log;
+    bool log_failed;
+    boost::shared_ptr<PoseUKFSmootherRecord> record;
+
+private:
+    PoseUKFSmoother(const PoseUKFSmoother&);
+    PoseUKFSmoother& operator=(const PoseUKFSmoother&);
+};
+
+/**
+ * Read-only memory mapped view of a smoothed log written by PoseUKFSmoother::smoothLog.
+ */
+class SmoothedPoseLog
+{
+public:
+    /* Throws std::runtime_error if the file can't be mapped or is not a valid smoothed log */
+    explicit SmoothedPoseLog(const std::string& path);
+    ~SmoothedPoseLog();
+
+    std::size_t size() const { return record_count; }
+
+    /* Decodes the smoothed moments of the given epoch */
+    void get(std::size_t index, SmoothedPoseState& smoothed) const;
+
+private:
+    SmoothedPoseLog(const SmoothedPoseLog&);
+    SmoothedPoseLog& operator=(const SmoothedPoseLog&);
+
+    void* data;
+    std::size_t data_size;
+    const PoseUKFSmoothedRecord* records;
+    std::size_t record_count;
+};
+
+}
+
+#endif
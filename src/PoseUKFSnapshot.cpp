@@ -0,0 +1,98 @@
+#include "PoseUKFSnapshot.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace uwv_kalman_filters;
+
+static uint64_t snapshotChecksum(const PoseUKFSnapshot& snapshot)
+{
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(&snapshot.checksum + 1);
+    const unsigned char* end = reinterpret_cast<const unsigned char*>(&snapshot) + sizeof(PoseUKFSnapshot);
+    uint64_t hash = 14695981039346656037ull;
+    for(const unsigned char* it = begin; it != end; it++)
+    {
+        hash ^= *it;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+PoseUKFSnapshot::PoseUKFSnapshot()
+{
+    std::memset(this, 0, sizeof(PoseUKFSnapshot));
+    magic = MAGIC;
+    version = VERSION;
+    dof = DOF;
+    size = sizeof(PoseUKFSnapshot);
+}
+
+void PoseUKFSnapshot::seal()
+{
+    checksum = snapshotChecksum(*this);
+}
+
+bool PoseUKFSnapshot::isValid() const
+{
+    return magic == MAGIC && version == VERSION && dof == DOF && size == sizeof(PoseUKFSnapshot) &&
+           checksum == snapshotChecksum(*this);
+}
+
+void uwv_kalman_filters::writeSnapshot(const std::string& path, const PoseUKFSnapshot& snapshot)
+{
+    char temporary_path[PATH_MAX];
+    if(std::snprintf(temporary_path, sizeof(temporary_path), "%s.tmp", path.c_str()) >= int(sizeof(temporary_path)))
+        throw std::runtime_error("Snapshot path is too long");
+
+    int fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open snapshot file");
+    bool success = ::write(fd, &snapshot, sizeof(PoseUKFSnapshot)) == ssize_t(sizeof(PoseUKFSnapshot));
+    success = fsync(fd) == 0 && success;
+    success = close(fd) == 0 && success;
+    if(!success || rename(temporary_path, path.c_str()) != 0)
+    {
+        unlink(temporary_path);
+        throw std::runtime_error("Failed to write snapshot file");
+    }
+}
+
+MappedPoseUKFSnapshot::MappedPoseUKFSnapshot(const std::string& path) : data(NULL), data_size(0), snapshot(NULL)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Failed to open snapshot " + path);
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || std::size_t(file_stat.st_size) != sizeof(PoseUKFSnapshot))
+    {
+        close(fd);
+        throw std::runtime_error("Invalid snapshot " + path);
+    }
+    data_size = file_stat.st_size;
+    data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+    {
+        data = NULL;
+        throw std::runtime_error("Failed to map snapshot " + path);
+    }
+
+    snapshot = static_cast<const PoseUKFSnapshot*>(data);
+    if(!snapshot->isValid())
+    {
+        munmap(data, data_size);
+        data = NULL;
+        throw std::runtime_error("Invalid snapshot " + path);
+    }
+}
+
+MappedPoseUKFSnapshot::~MappedPoseUKFSnapshot()
+{
+    if(data)
+        munmap(data, data_size);
+}
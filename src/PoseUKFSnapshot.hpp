@@ -0,0 +1,81 @@
+#ifndef _UWV_KALMAN_FILTERS_POSE_UKF_SNAPSHOT_HPP_
+#define _UWV_KALMAN_FILTERS_POSE_UKF_SNAPSHOT_HPP_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include "PoseState.hpp"
+#include "PoseUKFConfig.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Fixed binary layout of the complete state of a PoseUKF, see PoseUKF::saveSnapshot.
+ *
+ * The mean is stored as the difference to the default constructed PoseState,
+ * the covariance as full matrix in row-major order. The layout only depends on
+ * the version, a snapshot can therefore be written and mapped as is.
+ */
+struct PoseUKFSnapshot
+{
+    enum { MAGIC = 0x53565755, VERSION = 1 }; // "UWVS"
+    enum { DOF = PoseState::DOF, PARAMETER_DOF = InertiaType::DOF };
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dof;
+    uint32_t size;
+    /* Microseconds since the unix epoch, same as base::Time */
+    int64_t time;
+    /* FNV-1a hash of all following bytes */
+    uint64_t checksum;
+    double state[DOF];
+    double cov[DOF * DOF];
+    /* Mean values of the inertia and damping parameter states */
+    double inertia_offset[PARAMETER_DOF];
+    double lin_damping_offset[PARAMETER_DOF];
+    double quad_damping_offset[PARAMETER_DOF];
+    double rotation_rate[3];
+    double earth_rotation[3];
+    double earth_rotation_position[2];
+    /* Origin of the navigation frame */
+    LocationConfiguration location;
+
+    PoseUKFSnapshot();
+
+    /* Computes the checksum, called by PoseUKF::saveSnapshot */
+    void seal();
+
+    /* Checks magic, version, size and checksum */
+    bool isValid() const;
+};
+
+/* Writes the snapshot to a temporary file which then replaces path, a reader never sees a partial snapshot.
+ * Doesn't allocate memory. Throws std::runtime_error if the file can't be written */
+void writeSnapshot(const std::string& path, const PoseUKFSnapshot& snapshot);
+
+/**
+ * Read-only memory mapped snapshot file.
+ */
+class MappedPoseUKFSnapshot
+{
+public:
+    /* Throws std::runtime_error if the file can't be mapped or is not a valid snapshot */
+    explicit MappedPoseUKFSnapshot(const std::string& path);
+    ~MappedPoseUKFSnapshot();
+
+    const PoseUKFSnapshot& get() const { return *snapshot; }
+
+private:
+    MappedPoseUKFSnapshot(const MappedPoseUKFSnapshot&);
+    MappedPoseUKFSnapshot& operator=(const MappedPoseUKFSnapshot&);
+
+    void* data;
+    std::size_t data_size;
+    const PoseUKFSnapshot* snapshot;
+};
+
+}
+
+#endif
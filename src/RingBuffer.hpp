@@ -0,0 +1,99 @@
+#ifndef _UWV_KALMAN_FILTERS_RING_BUFFER_HPP_
+#define _UWV_KALMAN_FILTERS_RING_BUFFER_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Fixed-capacity ring buffer, the storage is allocated once at construction.
+ *
+ * Elements are indexed from the oldest (0) to the newest (size() - 1).
+ * When the buffer is full, adding an element overwrites the oldest one.
+ */
+template<typename T, typename Allocator = std::allocator<T> >
+class RingBuffer
+{
+public:
+    explicit RingBuffer(std::size_t capacity) : elements(capacity), head(0), count(0)
+    {
+        if(capacity == 0)
+            throw std::invalid_argument("The capacity of a ring buffer must be positive");
+    }
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return elements.size(); }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == elements.size(); }
+
+    T& operator[](std::size_t index) { return elements[(head + index) % elements.size()]; }
+    const T& operator[](std::size_t index) const { return elements[(head + index) % elements.size()]; }
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+    T& back() { return (*this)[count - 1]; }
+    const T& back() const { return (*this)[count - 1]; }
+
+    void push_back(const T& element)
+    {
+        if(full())
+            pop_front();
+        elements[(head + count) % elements.size()] = element;
+        count++;
+    }
+
+    /* Appends an element without assigning it, the returned element keeps the content of the reused storage */
+    T& extend_back()
+    {
+        if(full())
+            pop_front();
+        count++;
+        return back();
+    }
+
+    void pop_front()
+    {
+        head = (head + 1) % elements.size();
+        count--;
+    }
+
+    /* Inserts the element before the given index, the oldest element is dropped if the buffer is full */
+    void insert(std::size_t index, const T& element)
+    {
+        if(full())
+        {
+            if(index == 0)
+                return;
+            pop_front();
+            index--;
+        }
+        count++;
+        for(std::size_t i = count - 1; i > index; i--)
+            (*this)[i] = (*this)[i - 1];
+        (*this)[index] = element;
+    }
+
+    /* Removes all elements from the given index to the newest one */
+    void truncate(std::size_t index)
+    {
+        if(index < count)
+            count = index;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<T, Allocator> elements;
+    std::size_t head;
+    std::size_t count;
+};
+
+}
+
+#endif
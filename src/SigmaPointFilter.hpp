@@ -0,0 +1,995 @@
+#ifndef _UWV_KALMAN_FILTERS_SIGMA_POINT_FILTER_HPP_
+#define _UWV_KALMAN_FILTERS_SIGMA_POINT_FILTER_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/LU>
+#include <Eigen/QR>
+#include <Eigen/StdVector>
+#include <ukfom/ukf.hpp>
+#include "ThreadPool.hpp"
+#include "FilterInstrumentation.hpp"
+#include "PoseUKFConfig.hpp"
+
+namespace uwv_kalman_filters
+{
+
+enum FilterBackend
+{
+    /* Factorizes the full covariance in every step */
+    STANDARD_UKF,
+    /* Propagates a Cholesky factor of the covariance using QR decompositions and rank-1 downdates */
+    SQUARE_ROOT_UKF
+};
+
+/**
+ * Sigma point propagation of the prediction and update steps of an unscented Kalman filter.
+ *
+ * This implements the same algorithm as ukfom::ukf on the mean and covariance of a
+ * given ukfom::ukf instance, but evaluates the process and measurement models of
+ * the sigma points optionally in parallel on a thread pool.
+ * The models are called as model(sigma_point, worker), where worker is the id of the
+ * thread evaluating it, in the range [0, getWorkerCount()).
+ * All reductions are done serially in a fixed order, the results of a parallel
+ * evaluation are therefore identical to a serial one.
+ *
+ * In the SQUARE_ROOT_UKF backend a lower triangular factor of the covariance is carried
+ * from step to step. The prediction computes it from a QR decomposition of the weighted
+ * sigma point deviations and the process noise factor, the updates apply one rank-1
+ * Cholesky downdate per measurement row. The full covariance is still written back to
+ * the ukfom::ukf instance. If it was changed from outside, or a downdate fails because
+ * the covariance lost positive definiteness, the factor is computed again from the covariance.
+ *
+ * All buffers are fixed-size Eigen types with the dimension of the state, the sigma points
+ * are stored in aligned memory allocated once at construction.
+ * Symmetric weighted sums only evaluate one triangle.
+ *
+ * The set of sigma points is selected with setScheme, see SigmaPointScheme. Each point is given by
+ * mu [+] L * u_i, where L is the lower triangular factor of the covariance and the unit points u_i
+ * with their mean and covariance weights match the first two moments of a standard normal distribution.
+ * The default SYMMETRIC_SIGMA_POINTS reproduce the points and weights of ukfom::ukf.
+ *
+ * structuredPredict exploits a state whose leading DOFs evolve independently of the others, while
+ * the remaining DOFs are decoupled linear processes. Only the leading block is sampled, the
+ * remaining covariance blocks are propagated in closed form.
+ *
+ * If an instrumentation is set, the time spent in the model evaluations and the
+ * decompositions of the covariance is recorded, see FilterInstrumentation.
+ */
+template<typename FilterState>
+class SigmaPointFilter
+{
+public:
+    enum { DOF = FilterState::DOF, SIGMA_POINTS = 2 * DOF + 1 };
+    typedef typename FilterState::scalar_type scalar_type;
+    typedef typename FilterState::vectorized_type VectorizedState;
+    typedef Eigen::Matrix<scalar_type, DOF, DOF> Covariance;
+    typedef ukfom::ukf<FilterState> UKF;
+    typedef std::vector<FilterState, Eigen::aligned_allocator<FilterState> > StateVector;
+
+    /* Consecutive rows of a stacked measurement, which are gated together */
+    struct MeasurementBlock
+    {
+        unsigned rows;
+        /* Largest accepted squared Mahalanobis distance of the block */
+        scalar_type max_mahalanobis2;
+    };
+
+    /* Innovation of the last evaluated measurement update */
+    struct Innovation
+    {
+        /* Incremented with every evaluated update, accepted or not */
+        unsigned long sequence;
+        /* Number of measurement rows the statistics refer to */
+        unsigned dof;
+        scalar_type mahalanobis2;
+        /* Logarithm of the likelihood of the innovation given its covariance,
+         * zero unless enabled by setLikelihoodEnabled */
+        scalar_type log_likelihood;
+        /* Sum of the log-likelihoods of all innovations so far, the difference between two
+         * observations of it covers every update in between, e.g. of a batch or a stacked update */
+        scalar_type log_likelihood_sum;
+        bool accepted;
+
+        Innovation() : sequence(0), dof(0), mahalanobis2(0), log_likelihood(0), log_likelihood_sum(0), accepted(false) {}
+    };
+
+    SigmaPointFilter(const boost::shared_ptr<ThreadPool>& thread_pool = boost::shared_ptr<ThreadPool>()) :
+        thread_pool(thread_pool), sigma_points(SIGMA_POINTS), backend(STANDARD_UKF), factor_valid(false), noise_factor_valid(false), instrumentation(NULL), revision(0),
+        cross_covariance_enabled(false), likelihood_enabled(false)
+    {
+        setScheme(SigmaPointParameters());
+    }
+
+    /* Selects the set of sigma points used by all following steps.
+     * Throws std::invalid_argument if the parameters don't define a valid set */
+    void setScheme(const SigmaPointParameters& parameters)
+    {
+        computePointSet(DOF, parameters, point_set);
+        scheme = parameters;
+        core_point_set.unit_points.resize(0, 0);
+    }
+
+    const SigmaPointParameters& getScheme() const
+    {
+        return scheme;
+    }
+
+    /* Number of sigma points of the full state */
+    unsigned getSigmaPointCount() const
+    {
+        return point_set.size();
+    }
+
+    /* Sigma points of the last prediction or update, the first getSigmaPointCount() are in use */
+    StateVector& getSigmaPoints()
+    {
+        return sigma_points;
+    }
+
+    const Innovation& getLastInnovation() const
+    {
+        return last_innovation;
+    }
+
+    /* Incremented whenever predict, structuredPredict or update changed the filter state */
+    unsigned long getRevision() const
+    {
+        return revision;
+    }
+
+    /* Number of workers which might evaluate the models concurrently */
+    unsigned getWorkerCount() const
+    {
+        return thread_pool ? thread_pool->size() : 1;
+    }
+
+    void setBackend(FilterBackend backend)
+    {
+        this->backend = backend;
+        factor_valid = false;
+    }
+
+    FilterBackend getBackend() const
+    {
+        return backend;
+    }
+
+    /* The instrumentation is not owned and must outlive the filter, NULL disables it */
+    void setInstrumentation(FilterInstrumentation* instrumentation)
+    {
+        this->instrumentation = instrumentation;
+    }
+
+    /* If enabled predict and structuredPredict keep the cross covariance of the prior and the
+     * propagated state, as required by a Rauch-Tung-Striebel smoother. Disabled by default */
+    void setCrossCovarianceEnabled(bool enabled)
+    {
+        cross_covariance_enabled = enabled;
+    }
+
+    /* If enabled the log-likelihood of each innovation is computed, which requires a decomposition
+     * of the innovation covariance. Disabled by default */
+    void setLikelihoodEnabled(bool enabled)
+    {
+        likelihood_enabled = enabled;
+    }
+
+    /* Cross covariance E[(x - mu) (x' - mu')^T] of the prior x and the propagated state x' of the last prediction */
+    const Covariance& getPredictionCrossCovariance() const
+    {
+        return prediction_cross_covariance;
+    }
+
+    /* Propagates the sigma points through the process model.
+     * The square-root backend requires a factor G of the process noise with G * G^T = process_noise,
+     * which is either given or computed from the process noise. The computed factor is reused
+     * as long as the process noise doesn't change */
+    template<typename ProcessModel>
+    void predict(UKF& ukf, const ProcessModel& process_model, const Covariance& process_noise,
+                 const Covariance* process_noise_factor = NULL)
+    {
+        const unsigned count = beginPredict(ukf);
+
+        ProcessTask<ProcessModel> task(sigma_points, process_model);
+        execute(task, true, count);
+
+        endPredict(ukf, process_noise, process_noise_factor);
+    }
+
+    /* Prediction with a process model evaluated by the caller, e.g. on the sigma points of several filters at once.
+     * beginPredict samples the sigma points of the filter and returns their number, the caller propagates them
+     * in place (see getSigmaPoints) and endPredict computes the predicted moments in the same way as predict */
+    unsigned beginPredict(const UKF& ukf)
+    {
+        generateSigmaPoints(ukf.mu(), ukf.sigma());
+        return point_set.size();
+    }
+
+    void endPredict(UKF& ukf, const Covariance& process_noise, const Covariance* process_noise_factor = NULL)
+    {
+        const unsigned count = point_set.size();
+        mean = meanSigmaPoints(sigma_points, point_set);
+        for(unsigned i = 0; i < count; i++)
+            deviations.col(i) = sigma_points[i] - mean;
+
+        if(cross_covariance_enabled)
+        {
+            // with the sigma points mu + L * u_i the cross covariance is L * D^T, where D = sum_i w_i * d_i * u_i^T
+            Covariance D;
+            crossDeviations(deviations, point_set, D);
+            prediction_cross_covariance.noalias() = factor.template triangularView<Eigen::Lower>() * D.transpose();
+        }
+
+        bool factorized = false;
+        if(backend == SQUARE_ROOT_UKF)
+        {
+            // the transposed factor is the triangular part of the QR decomposition of the compound matrix,
+            // sigma points of negative weight are removed by downdates of the factor
+            compound.template topRows<SIGMA_POINTS>().setZero();
+            for(unsigned i = 0; i < count; i++)
+            {
+                if(point_set.covariance_weights(i) > scalar_type(0))
+                    compound.row(i) = std::sqrt(point_set.covariance_weights(i)) * deviations.col(i).transpose();
+            }
+            compound.template bottomRows<DOF>() = (process_noise_factor ? *process_noise_factor : squareRoot(process_noise)).transpose();
+            {
+                FilterInstrumentation::ScopedTimer timer(instrumentation, FilterInstrumentation::FACTORIZATION);
+                qr.compute(compound);
+            }
+            factor = qr.matrixQR().template topRows<DOF>().template triangularView<Eigen::Upper>().transpose();
+            for(unsigned j = 0; j < DOF; j++)
+            {
+                if(factor(j,j) < scalar_type(0))
+                    factor.col(j) *= scalar_type(-1);
+            }
+            factorized = true;
+            for(unsigned i = 0; i < count && factorized; i++)
+            {
+                if(point_set.covariance_weights(i) < scalar_type(0))
+                    factorized = choleskyDowndate(factor, VectorizedState(std::sqrt(-point_set.covariance_weights(i)) * deviations.col(i)));
+            }
+            if(factorized)
+            {
+                covariance.noalias() = factor * factor.transpose();
+                factor_of_covariance = covariance;
+                factor_valid = true;
+            }
+            else
+                factor_valid = false;
+        }
+        if(!factorized)
+        {
+            weightedProduct(deviations, point_set.covariance_weights, point_set.uniform_covariance_weights, covariance);
+            covariance += process_noise;
+        }
+
+        ukf = UKF(mean, covariance);
+        revision++;
+    }
+
+    /* Prediction of a state whose CoreDOF leading DOFs evolve independently of the remaining ones,
+     * while each remaining DOF i follows x_i' = transition(i) * x_i + b_i.
+     * The process model is evaluated on the sigma points of the scheme spanning the core only.
+     * The cross covariance is propagated with the statistical linearization A = P_xy^T * P_core^-1
+     * of the core, i.e. P_core,rest' = A * P_core,rest * diag(transition), and the covariance of the
+     * remaining DOFs with diag(transition) * P_rest * diag(transition). */
+    template<int CoreDOF, typename ProcessModel>
+    void structuredPredict(UKF& ukf, const ProcessModel& process_model,
+                           const Eigen::Matrix<scalar_type, DOF - CoreDOF, 1>& transition, const Covariance& process_noise)
+    {
+        enum { REST_DOF = DOF - CoreDOF, CORE_SIGMA_POINTS = 2 * CoreDOF + 1 };
+        typedef Eigen::Matrix<scalar_type, CoreDOF, CoreDOF> CoreCovariance;
+
+        if(core_point_set.unit_points.rows() != CoreDOF)
+            computePointSet(CoreDOF, scheme, core_point_set);
+        const unsigned count = core_point_set.size();
+
+        const FilterState mu = ukf.mu();
+        covariance = ukf.sigma();
+
+        Eigen::LLT<CoreCovariance> core_llt;
+        {
+            FilterInstrumentation::ScopedTimer timer(instrumentation, FilterInstrumentation::FACTORIZATION);
+            core_llt.compute(covariance.template topLeftCorner<CoreDOF, CoreDOF>());
+        }
+        if(core_llt.info() != Eigen::Success)
+            throw std::runtime_error("Cholesky decomposition of the state covariance failed");
+        const CoreCovariance L = core_llt.matrixL();
+
+        samplePoints(mu, L, core_point_set);
+
+        ProcessTask<ProcessModel> task(sigma_points, process_model);
+        execute(task, true, count);
+
+        // the remaining DOFs of all sigma points are equal, they are propagated exactly
+        mean = meanSigmaPoints(sigma_points, core_point_set);
+        Eigen::Matrix<scalar_type, CoreDOF, Eigen::Dynamic, 0, CoreDOF, CORE_SIGMA_POINTS> core_deviations(static_cast<int>(CoreDOF), count);
+        for(unsigned i = 0; i < count; i++)
+            core_deviations.col(i) = VectorizedState(sigma_points[i] - mean).template head<CoreDOF>();
+
+        // with the sigma points mu + L * u_i the cross covariance of the propagated and the prior core is
+        // D * L^T, where D = sum_i w_i * d_i * u_i^T, which gives A = D * L^-1
+        CoreCovariance D;
+        crossDeviations(core_deviations, core_point_set, D);
+        const CoreCovariance A = L.transpose().template triangularView<Eigen::Upper>().solve(D.transpose()).transpose();
+
+        if(cross_covariance_enabled)
+        {
+            // the statistical linearization of the whole state is diag(A, diag(transition))
+            prediction_cross_covariance.template leftCols<CoreDOF>().noalias() = covariance.template leftCols<CoreDOF>() * A.transpose();
+            prediction_cross_covariance.template rightCols<REST_DOF>().noalias() = covariance.template rightCols<REST_DOF>() * transition.asDiagonal();
+        }
+
+        CoreCovariance core_covariance;
+        weightedProduct(core_deviations, core_point_set.covariance_weights, core_point_set.uniform_covariance_weights, core_covariance);
+        covariance.template topLeftCorner<CoreDOF, CoreDOF>() = core_covariance;
+        const Eigen::Matrix<scalar_type, CoreDOF, REST_DOF> cross_covariance =
+                A * covariance.template topRightCorner<CoreDOF, REST_DOF>() * transition.asDiagonal();
+        covariance.template topRightCorner<CoreDOF, REST_DOF>() = cross_covariance;
+        covariance.template bottomLeftCorner<REST_DOF, CoreDOF>() = cross_covariance.transpose();
+        covariance.template bottomRightCorner<REST_DOF, REST_DOF>().array() *= (transition * transition.transpose()).array();
+        covariance += process_noise;
+
+        ukf = UKF(mean, covariance);
+        revision++;
+    }
+
+    /* Integrates the measurement z with the noise covariance R, returns false if it was rejected by the test.
+     * The test is evaluated on the predicted measurement covariance, rejected measurements skip the
+     * cross covariance, the gain and the correction.
+     * Only the process model and measurement models marked as parallel are evaluated on the thread pool. */
+    template<int M, typename MeasurementModel, typename SignificanceTest>
+    bool update(UKF& ukf, const Eigen::Matrix<scalar_type, M, 1>& z, const MeasurementModel& measurement_model,
+                const Eigen::Matrix<scalar_type, M, M>& R, SignificanceTest mahalanobis_test, bool parallel = false)
+    {
+        typedef Eigen::Matrix<scalar_type, M, 1> Measurement;
+        typedef Eigen::Matrix<scalar_type, M, Eigen::Dynamic, M == 1 ? Eigen::RowMajor : Eigen::ColMajor, M, SIGMA_POINTS> MeasurementSigmaPoints;
+        typedef Eigen::Matrix<scalar_type, M, M> MeasurementCov;
+        typedef Eigen::Matrix<scalar_type, DOF, M> CrossCov;
+
+        const unsigned count = point_set.size();
+        generateSigmaPoints(ukf.mu(), ukf.sigma());
+
+        MeasurementSigmaPoints Z(static_cast<int>(M), count);
+        MeasurementTask<MeasurementModel, MeasurementSigmaPoints> task(sigma_points, measurement_model, Z);
+        execute(task, parallel, count);
+
+        const Measurement mean_z = weightedMean(Z, point_set);
+        Z.colwise() -= mean_z;
+
+        MeasurementCov S;
+        weightedProduct(Z, point_set.covariance_weights, point_set.uniform_covariance_weights, S);
+        S += R;
+
+        const MeasurementCov S_inverse = S.inverse();
+        const Measurement innovation = z - mean_z;
+        const scalar_type mahalanobis2 = (innovation.transpose() * S_inverse * innovation)(0);
+
+        const bool accepted = mahalanobis_test(mahalanobis2);
+        recordInnovation(S, mahalanobis2, accepted);
+        if(!accepted)
+            return false;
+
+        for(unsigned i = 0; i < count; i++)
+            deviations.col(i) = sigma_points[i] - ukf.mu();
+        CrossCov cov_xz;
+        if(point_set.uniform_covariance_weights)
+            cov_xz.noalias() = point_set.covariance_weights(0) * deviations.leftCols(count) * Z.transpose();
+        else
+            cov_xz.noalias() = deviations.leftCols(count) * point_set.covariance_weights.asDiagonal() * Z.transpose();
+        const CrossCov K = cov_xz * S_inverse;
+
+        applyCorrection(ukf, K, S, innovation);
+        return true;
+    }
+
+    /* Integrates a stack of measurements of at most MaxM rows using a single set of sigma points.
+     * The measurement model returns all rows of the stack, the blocks partition them in order.
+     * Each block is gated on its marginal innovation, rejected blocks are removed from the stack
+     * before the gain is computed. Returns the number of accepted blocks.
+     * If given, block_accepted receives the result of the test of each block. */
+    template<int MaxM, typename MeasurementModel>
+    unsigned stackedUpdate(UKF& ukf, const Eigen::Matrix<scalar_type, Eigen::Dynamic, 1, 0, MaxM, 1>& z,
+                           const MeasurementModel& measurement_model,
+                           const Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic, 0, MaxM, MaxM>& R,
+                           const MeasurementBlock* blocks, unsigned block_count, bool parallel = false,
+                           bool* block_accepted = NULL)
+    {
+        typedef Eigen::Matrix<scalar_type, Eigen::Dynamic, 1, 0, MaxM, 1> Measurement;
+        typedef Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic, 0, MaxM, SIGMA_POINTS> MeasurementSigmaPoints;
+        typedef Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic, 0, MaxM, MaxM> MeasurementCov;
+        typedef Eigen::Matrix<scalar_type, DOF, Eigen::Dynamic, 0, DOF, MaxM> CrossCov;
+
+        if(block_accepted)
+            std::fill(block_accepted, block_accepted + block_count, false);
+        const int rows = z.rows();
+        if(rows == 0)
+            return 0;
+
+        const unsigned count = point_set.size();
+        generateSigmaPoints(ukf.mu(), ukf.sigma());
+
+        MeasurementSigmaPoints Z(rows, count);
+        MeasurementTask<MeasurementModel, MeasurementSigmaPoints> task(sigma_points, measurement_model, Z);
+        execute(task, parallel, count);
+
+        const Measurement mean_z = weightedMean(Z, point_set);
+        Z.colwise() -= mean_z;
+        const Measurement full_innovation = z - mean_z;
+        MeasurementCov full_S(rows, rows);
+        weightedProduct(Z, point_set.covariance_weights, point_set.uniform_covariance_weights, full_S);
+        full_S += R;
+
+        // gate each block on its marginal and keep the rows of the accepted ones
+        int accepted_rows[MaxM];
+        int accepted_count = 0;
+        unsigned accepted_blocks = 0;
+        for(unsigned b = 0, offset = 0; b < block_count; offset += blocks[b].rows, b++)
+        {
+            const MeasurementCov block_S = full_S.block(offset, offset, blocks[b].rows, blocks[b].rows);
+            const Measurement block_innovation = full_innovation.segment(offset, blocks[b].rows);
+            const scalar_type mahalanobis2 = block_innovation.dot(block_S.llt().solve(block_innovation));
+            if(!(mahalanobis2 <= blocks[b].max_mahalanobis2))
+                continue;
+            for(unsigned r = 0; r < blocks[b].rows; r++)
+                accepted_rows[accepted_count++] = offset + r;
+            accepted_blocks++;
+            if(block_accepted)
+                block_accepted[b] = true;
+        }
+        if(accepted_count == 0)
+        {
+            const Eigen::LLT<MeasurementCov> full_llt(full_S);
+            recordInnovation(full_llt, full_innovation.dot(full_llt.solve(full_innovation)), false);
+            return 0;
+        }
+
+        for(unsigned i = 0; i < count; i++)
+            deviations.col(i) = sigma_points[i] - ukf.mu();
+
+        MeasurementCov S(accepted_count, accepted_count);
+        Measurement innovation(accepted_count);
+        CrossCov cov_xz(int(DOF), accepted_count);
+        for(int i = 0; i < accepted_count; i++)
+        {
+            innovation(i) = full_innovation(accepted_rows[i]);
+            for(int j = 0; j < accepted_count; j++)
+                S(i, j) = full_S(accepted_rows[i], accepted_rows[j]);
+            if(point_set.uniform_covariance_weights)
+                cov_xz.col(i).noalias() = point_set.covariance_weights(0) * deviations.leftCols(count) * Z.row(accepted_rows[i]).transpose();
+            else
+                cov_xz.col(i).noalias() = deviations.leftCols(count) * point_set.covariance_weights.cwiseProduct(Z.row(accepted_rows[i]).transpose());
+        }
+
+        const Eigen::LLT<MeasurementCov> S_llt(S);
+        const MeasurementCov S_inverse = S_llt.solve(MeasurementCov::Identity(accepted_count, accepted_count));
+        const CrossCov K = cov_xz * S_inverse;
+        recordInnovation(S_llt, innovation.dot(S_inverse * innovation), true);
+        applyCorrection(ukf, K, S, innovation);
+        return accepted_blocks;
+    }
+
+    /* Integrates a measurement which directly observes the M consecutive DOFs of the state starting at index,
+     * i.e. the measurement model is linear in a vector space sub-manifold of the state.
+     * Since the unscented transformation is exact in this case it is replaced by the closed-form
+     * Kalman update on the marginal, which requires neither sigma points nor a decomposition
+     * of the full covariance. The measurement model is only evaluated at the mean. */
+    template<int M, typename MeasurementModel, typename SignificanceTest>
+    bool linearUpdate(UKF& ukf, const Eigen::Matrix<scalar_type, M, 1>& z, const MeasurementModel& measurement_model,
+                      int index, const Eigen::Matrix<scalar_type, M, M>& R, SignificanceTest mahalanobis_test)
+    {
+        typedef Eigen::Matrix<scalar_type, M, 1> Measurement;
+        typedef Eigen::Matrix<scalar_type, M, M> MeasurementCov;
+        typedef Eigen::Matrix<scalar_type, DOF, M> CrossCov;
+
+        const Covariance& sigma = ukf.sigma();
+        const MeasurementCov S = sigma.template block<M, M>(index, index) + R;
+        const CrossCov cov_xz = sigma.template middleCols<M>(index);
+
+        const MeasurementCov S_inverse = S.inverse();
+        const Measurement innovation = z - Measurement(measurement_model(ukf.mu(), 0u));
+        const scalar_type mahalanobis2 = (innovation.transpose() * S_inverse * innovation)(0);
+
+        const bool accepted = mahalanobis_test(mahalanobis2);
+        recordInnovation(S, mahalanobis2, accepted);
+        if(!accepted)
+            return false;
+
+        const CrossCov K = cov_xz * S_inverse;
+        applyCorrection(ukf, K, S, innovation);
+        return true;
+    }
+
+    /* Lower triangular L with L * L^T = A of a positive semi-definite matrix A, without pivoting.
+     * Zero pivots give zero columns, returns false if A is not positive semi-definite in this order */
+    static bool semidefiniteCholesky(const Covariance& A, Covariance& L)
+    {
+        const scalar_type tolerance = std::numeric_limits<scalar_type>::epsilon() * DOF * A.diagonal().cwiseAbs().maxCoeff();
+        L.setZero();
+        for(unsigned j = 0; j < DOF; j++)
+        {
+            const scalar_type d = A(j,j) - L.row(j).head(j).squaredNorm();
+            if(d < -tolerance)
+                return false;
+            if(d <= tolerance)
+            {
+                // the remaining entries of the column have to vanish as well
+                for(unsigned i = j + 1; i < DOF; i++)
+                {
+                    if(std::abs(A(i,j) - L.row(i).head(j).dot(L.row(j).head(j))) > tolerance)
+                        return false;
+                }
+                continue;
+            }
+            L(j,j) = std::sqrt(d);
+            for(unsigned i = j + 1; i < DOF; i++)
+                L(i,j) = (A(i,j) - L.row(i).head(j).dot(L.row(j).head(j))) / L(j,j);
+        }
+        return true;
+    }
+
+    /* Computes the factor of L * L^T + x * x^T in place, L is lower triangular and might be singular */
+    template<typename Vector>
+    static void choleskyUpdate(Covariance& L, const Vector& v)
+    {
+        VectorizedState x = v;
+        for(unsigned k = 0; k < DOF; k++)
+        {
+            if(x(k) == scalar_type(0))
+                continue;
+            const scalar_type r = std::sqrt(L(k,k) * L(k,k) + x(k) * x(k));
+            // Givens rotation eliminating x(k)
+            const scalar_type c = L(k,k) / r;
+            const scalar_type s = x(k) / r;
+            L(k,k) = r;
+            for(unsigned i = k + 1; i < DOF; i++)
+            {
+                const scalar_type l = L(i,k);
+                L(i,k) = c * l + s * x(i);
+                x(i) = c * x(i) - s * l;
+            }
+        }
+    }
+
+protected:
+    /* Unit sigma points u_i with their weights */
+    struct PointSet
+    {
+        Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic, 0, DOF, SIGMA_POINTS> unit_points;
+        Eigen::Matrix<scalar_type, Eigen::Dynamic, 1, 0, SIGMA_POINTS, 1> mean_weights;
+        Eigen::Matrix<scalar_type, Eigen::Dynamic, 1, 0, SIGMA_POINTS, 1> covariance_weights;
+        bool uniform_mean_weights;
+        bool uniform_covariance_weights;
+        /* If positive the points are a central one, if has_center is set, followed by the pairs
+         * +- axis_scale * e_j in the order of the axes, which allows to skip the product with the factor */
+        scalar_type axis_scale;
+        bool has_center;
+
+        unsigned size() const { return unit_points.cols(); }
+    };
+
+    /* Unit points and weights of the scheme in n dimensions */
+    static void computePointSet(unsigned n, const SigmaPointParameters& parameters, PointSet& set)
+    {
+        unsigned count = 0;
+        scalar_type center_mean_weight = 0;
+        scalar_type center_covariance_weight = 0;
+        scalar_type weight = 0;
+        set.axis_scale = 0;
+        set.has_center = true;
+        switch(parameters.scheme)
+        {
+            case SYMMETRIC_SIGMA_POINTS:
+                count = 2 * n + 1;
+                set.axis_scale = 1;
+                center_mean_weight = scalar_type(1) / count;
+                // the covariance is the sum over the point pairs with a weight of 0.5 each
+                center_covariance_weight = weight = scalar_type(0.5);
+                break;
+            case SCALED_UNSCENTED:
+            {
+                if(!(parameters.alpha > 0.))
+                    throw std::invalid_argument("The spread alpha of the scaled unscented transformation must be positive");
+                const scalar_type lambda = parameters.alpha * parameters.alpha * (n + parameters.kappa) - n;
+                if(!(n + lambda > scalar_type(0)))
+                    throw std::invalid_argument("The scaled unscented transformation requires alpha^2 * (n + kappa) > 0");
+                count = 2 * n + 1;
+                set.axis_scale = std::sqrt(n + lambda);
+                center_mean_weight = lambda / (n + lambda);
+                center_covariance_weight = center_mean_weight + scalar_type(1 - parameters.alpha * parameters.alpha + parameters.beta);
+                weight = scalar_type(1) / (2 * (n + lambda));
+                break;
+            }
+            case CUBATURE:
+                count = 2 * n;
+                set.axis_scale = std::sqrt(scalar_type(n));
+                set.has_center = false;
+                weight = scalar_type(1) / count;
+                break;
+            case SPHERICAL_SIMPLEX:
+                if(!(parameters.center_weight >= 0. && parameters.center_weight < 1.))
+                    throw std::invalid_argument("The weight of the central simplex point must be in [0, 1)");
+                count = n + 2;
+                center_mean_weight = center_covariance_weight = parameters.center_weight;
+                weight = (1 - parameters.center_weight) / (n + 1);
+                break;
+            default:
+                throw std::invalid_argument("Unknown sigma point scheme");
+        }
+
+        set.unit_points.setZero(n, count);
+        set.mean_weights.resize(count);
+        set.covariance_weights.resize(count);
+        const unsigned first = set.has_center ? 1 : 0;
+        if(set.has_center)
+        {
+            set.mean_weights(0) = center_mean_weight;
+            set.covariance_weights(0) = center_covariance_weight;
+        }
+        if(parameters.scheme == SYMMETRIC_SIGMA_POINTS)
+            set.mean_weights.tail(count - 1).setConstant(center_mean_weight);
+        else
+            set.mean_weights.tail(count - first).setConstant(weight);
+        set.covariance_weights.tail(count - first).setConstant(weight);
+
+        if(set.axis_scale > scalar_type(0))
+        {
+            for(unsigned j = 0; j < n; j++)
+            {
+                set.unit_points(j, first + 2 * j) = set.axis_scale;
+                set.unit_points(j, first + 2 * j + 1) = -set.axis_scale;
+            }
+        }
+        else
+        {
+            // simplex of equally weighted points, each dimension j adds a point scaled to match the variance
+            set.unit_points(0, 1) = -1 / std::sqrt(2 * weight);
+            set.unit_points(0, 2) = 1 / std::sqrt(2 * weight);
+            for(unsigned j = 2; j <= n; j++)
+            {
+                const scalar_type scale = 1 / std::sqrt(j * (j + 1) * weight);
+                set.unit_points.row(j - 1).segment(1, j).setConstant(-scale);
+                set.unit_points(j - 1, j + 1) = j * scale;
+            }
+        }
+
+        set.uniform_mean_weights = (set.mean_weights.array() == set.mean_weights(0)).all();
+        set.uniform_covariance_weights = (set.covariance_weights.array() == set.covariance_weights(0)).all();
+    }
+
+    template<typename ProcessModel>
+    struct ProcessTask
+    {
+        StateVector& X;
+        const ProcessModel& process_model;
+        ProcessTask(StateVector& X, const ProcessModel& process_model) : X(X), process_model(process_model) {}
+        void operator()(std::size_t i, unsigned worker)
+        {
+            X[i] = process_model(X[i], worker);
+        }
+    };
+
+    template<typename MeasurementModel, typename MeasurementSigmaPoints>
+    struct MeasurementTask
+    {
+        const StateVector& X;
+        const MeasurementModel& measurement_model;
+        MeasurementSigmaPoints& Z;
+        MeasurementTask(const StateVector& X, const MeasurementModel& measurement_model, MeasurementSigmaPoints& Z) :
+            X(X), measurement_model(measurement_model), Z(Z) {}
+        void operator()(std::size_t i, unsigned worker)
+        {
+            Z.col(i) = measurement_model(X[i], worker);
+        }
+    };
+
+    template<typename Task>
+    void execute(Task& task, bool parallel, std::size_t count = SIGMA_POINTS)
+    {
+        FilterInstrumentation::ScopedTimer timer(instrumentation, FilterInstrumentation::SIGMA_POINT_BATCH);
+        if(parallel && thread_pool)
+            thread_pool->parallelFor(count, task);
+        else
+        {
+            for(std::size_t i = 0; i < count; i++)
+                task(i, 0);
+        }
+    }
+
+    /* Computes C = A * diag(w) * A^T over the first w.rows() columns of A, only the lower triangle is evaluated */
+    template<typename Deviations, typename Weights, typename Result>
+    static void weightedProduct(const Deviations& A, const Weights& w, bool uniform, Result& C)
+    {
+        const int count = w.rows();
+        C.setZero();
+        if(A.rows() == 1)
+        {
+            // a single row would be taken as a vector by the rank update
+            C(0,0) = A.row(0).head(count).cwiseAbs2().dot(w);
+            return;
+        }
+        if(uniform)
+            C.template selfadjointView<Eigen::Lower>().rankUpdate(A.leftCols(count), w(0));
+        else
+        {
+            for(int i = 0; i < count; i++)
+            {
+                if(w(i) != scalar_type(0))
+                    C.template selfadjointView<Eigen::Lower>().rankUpdate(A.col(i), w(i));
+            }
+        }
+        for(int j = 1; j < C.cols(); j++)
+        {
+            for(int i = 0; i < j; i++)
+                C(i,j) = C(j,i);
+        }
+    }
+
+    /* Stores the statistics of an innovation with covariance S */
+    template<typename InnovationCov>
+    void recordInnovation(const InnovationCov& S, scalar_type mahalanobis2, bool accepted)
+    {
+        if(likelihood_enabled)
+            recordInnovation(Eigen::LLT<typename InnovationCov::PlainObject>(S), mahalanobis2, accepted);
+        else
+            recordInnovation(S.rows(), mahalanobis2, scalar_type(0), accepted);
+    }
+
+    /* Same as above, given the Cholesky decomposition of S */
+    template<typename InnovationCov>
+    void recordInnovation(const Eigen::LLT<InnovationCov>& S_llt, scalar_type mahalanobis2, bool accepted)
+    {
+        scalar_type log_likelihood = 0;
+        if(likelihood_enabled)
+        {
+            // log(det(S)) from the Cholesky factor of S
+            const scalar_type log_det = scalar_type(2) * S_llt.matrixLLT().diagonal().array().log().sum();
+            log_likelihood = scalar_type(-0.5) * (mahalanobis2 + log_det + S_llt.rows() * std::log(scalar_type(2. * M_PI)));
+        }
+        recordInnovation(S_llt.rows(), mahalanobis2, log_likelihood, accepted);
+    }
+
+    void recordInnovation(unsigned dof, scalar_type mahalanobis2, scalar_type log_likelihood, bool accepted)
+    {
+        last_innovation.sequence++;
+        last_innovation.dof = dof;
+        last_innovation.mahalanobis2 = mahalanobis2;
+        last_innovation.log_likelihood = log_likelihood;
+        last_innovation.log_likelihood_sum += log_likelihood;
+        last_innovation.accepted = accepted;
+    }
+
+    /* Applies mean += K * innovation and covariance -= K * S * K^T to the filter */
+    template<typename Gain, typename InnovationCov, typename Innovation>
+    void applyCorrection(UKF& ukf, const Gain& K, const InnovationCov& S, const Innovation& innovation)
+    {
+        mean = ukf.mu();
+        mean += K * innovation;
+        covariance = ukf.sigma();
+
+        if(backend == SQUARE_ROOT_UKF && hasFactorOf(covariance))
+        {
+            // K * S * K^T = U * U^T, with U = K * chol(S)
+            const typename Gain::PlainObject U = K * S.llt().matrixL();
+            bool downdated = true;
+            for(int i = 0; i < U.cols() && downdated; i++)
+                downdated = choleskyDowndate(factor, U.col(i));
+
+            if(downdated)
+            {
+                covariance.noalias() = factor * factor.transpose();
+                factor_of_covariance = covariance;
+            }
+            else
+            {
+                factor_valid = false;
+                covariance.noalias() -= K * S * K.transpose();
+            }
+        }
+        else
+            covariance.noalias() -= K * S * K.transpose();
+
+        ukf = UKF(mean, covariance);
+        revision++;
+    }
+
+    /* Lower triangular factor of the covariance */
+    const Covariance& choleskyFactor(const Covariance& sigma)
+    {
+        if(backend == SQUARE_ROOT_UKF && hasFactorOf(sigma))
+            return factor;
+
+        {
+            FilterInstrumentation::ScopedTimer timer(instrumentation, FilterInstrumentation::FACTORIZATION);
+            llt.compute(sigma);
+        }
+        if(llt.info() != Eigen::Success)
+            throw std::runtime_error("Cholesky decomposition of the state covariance failed");
+        factor = llt.matrixL();
+        factor_of_covariance = sigma;
+        factor_valid = true;
+        return factor;
+    }
+
+    bool hasFactorOf(const Covariance& sigma) const
+    {
+        return factor_valid && sigma == factor_of_covariance;
+    }
+
+    /* Square root of a positive semi-definite matrix, which is not required to be positive definite */
+    const Covariance& squareRoot(const Covariance& matrix)
+    {
+        if(noise_factor_valid && matrix == factored_noise)
+            return noise_factor;
+        {
+            FilterInstrumentation::ScopedTimer timer(instrumentation, FilterInstrumentation::FACTORIZATION);
+            ldlt.compute(matrix);
+        }
+        noise_factor = ldlt.matrixL();
+        noise_factor = noise_factor * ldlt.vectorD().cwiseMax(scalar_type(0)).cwiseSqrt().asDiagonal();
+        noise_factor = ldlt.transpositionsP().transpose() * noise_factor;
+        factored_noise = matrix;
+        noise_factor_valid = true;
+        return noise_factor;
+    }
+
+    /* Computes the factor of L * L^T - x * x^T in place, returns false if the result is not positive definite */
+    template<typename Vector>
+    static bool choleskyDowndate(Covariance& L, const Vector& v)
+    {
+        VectorizedState x = v;
+        for(unsigned k = 0; k < DOF; k++)
+        {
+            const scalar_type r2 = L(k,k) * L(k,k) - x(k) * x(k);
+            if(!(r2 > scalar_type(0)))
+                return false;
+            const scalar_type r = std::sqrt(r2);
+            const scalar_type c = r / L(k,k);
+            const scalar_type s = x(k) / L(k,k);
+            L(k,k) = r;
+            for(unsigned i = k + 1; i < DOF; i++)
+            {
+                L(i,k) = (L(i,k) - s * x(i)) / c;
+                x(i) = c * x(i) - s * L(i,k);
+            }
+        }
+        return true;
+    }
+
+    void generateSigmaPoints(const FilterState& mu, const Covariance& sigma)
+    {
+        samplePoints(mu, choleskyFactor(sigma), point_set);
+    }
+
+    /* Sigma points mu [+] L * u_i of the point set, L spans the leading DOFs of the state */
+    template<typename Factor>
+    void samplePoints(const FilterState& mu, const Factor& L, const PointSet& set)
+    {
+        enum { N = Factor::ColsAtCompileTime };
+        VectorizedState offset = VectorizedState::Zero();
+        if(set.axis_scale > scalar_type(0))
+        {
+            unsigned i = 0;
+            if(set.has_center)
+                sigma_points[i++] = mu;
+            for(unsigned j = 0; j < N; j++)
+            {
+                if(set.axis_scale == scalar_type(1))
+                    offset.template head<N>() = L.col(j);
+                else
+                    offset.template head<N>() = set.axis_scale * L.col(j);
+                sigma_points[i++] = mu + offset;
+                sigma_points[i++] = mu + VectorizedState(-offset);
+            }
+        }
+        else
+        {
+            // the deviations are overwritten after the propagation, they hold the offsets in the meantime
+            deviations.topLeftCorner(int(N), set.size()).noalias() = L.template triangularView<Eigen::Lower>() * set.unit_points;
+            for(unsigned i = 0; i < set.size(); i++)
+            {
+                offset.template head<N>() = deviations.col(i).template head<N>();
+                sigma_points[i] = mu + offset;
+            }
+        }
+    }
+
+    /* D = sum_i w_i * d_i * u_i^T of the deviations d_i of the propagated sigma points */
+    template<typename Deviations, typename Result>
+    static void crossDeviations(const Deviations& deviations, const PointSet& set, Result& D)
+    {
+        if(set.axis_scale > scalar_type(0))
+        {
+            // only the pairs +- e_j contribute to column j
+            const unsigned first = set.has_center ? 1 : 0;
+            const scalar_type w = set.axis_scale * set.covariance_weights(first);
+            for(int j = 0; j < D.cols(); j++)
+                D.col(j) = w * (deviations.col(first + 2 * j) - deviations.col(first + 2 * j + 1));
+        }
+        else
+            D.noalias() = deviations.leftCols(set.size()) * set.covariance_weights.asDiagonal() * set.unit_points.transpose();
+    }
+
+    /* Weighted mean of the columns of the measurement sigma points */
+    template<typename MeasurementSigmaPoints>
+    static typename MeasurementSigmaPoints::ColXpr::PlainObject weightedMean(const MeasurementSigmaPoints& Z, const PointSet& set)
+    {
+        if(set.uniform_mean_weights)
+            return Z.rowwise().sum() / scalar_type(set.size());
+        return Z * set.mean_weights;
+    }
+
+    /* Weighted mean of the sigma points of the point set */
+    static FilterState meanSigmaPoints(const StateVector& X, const PointSet& set)
+    {
+        const unsigned count = set.size();
+        FilterState reference = X[0];
+        VectorizedState mean_delta;
+        const static unsigned max_iterations = 10000;
+        unsigned i = 0;
+        do
+        {
+            mean_delta.setZero();
+            if(set.uniform_mean_weights)
+            {
+                for(typename StateVector::const_iterator it = X.begin(); it != X.begin() + count; it++)
+                    mean_delta += *it - reference;
+                mean_delta /= scalar_type(count);
+            }
+            else
+            {
+                for(unsigned k = 0; k < count; k++)
+                    mean_delta += set.mean_weights(k) * VectorizedState(X[k] - reference);
+            }
+            reference += mean_delta;
+        } while(mean_delta.norm() > 1e-6 && ++i < max_iterations);
+
+        if(i >= max_iterations)
+            throw std::runtime_error("Mean of the sigma points did not converge");
+        return reference;
+    }
+
+    boost::shared_ptr<ThreadPool> thread_pool;
+    StateVector sigma_points;
+    Eigen::Matrix<scalar_type, DOF, SIGMA_POINTS> deviations;
+    Eigen::LLT<Covariance> llt;
+    Eigen::LDLT<Covariance> ldlt;
+    FilterState mean;
+    Covariance covariance;
+
+    FilterBackend backend;
+    /* Lower triangular factor of factor_of_covariance */
+    Covariance factor;
+    Covariance factor_of_covariance;
+    bool factor_valid;
+    Covariance noise_factor;
+    /* Process noise the noise factor was computed of */
+    Covariance factored_noise;
+    bool noise_factor_valid;
+    Eigen::Matrix<scalar_type, SIGMA_POINTS + DOF, DOF> compound;
+    Eigen::HouseholderQR< Eigen::Matrix<scalar_type, SIGMA_POINTS + DOF, DOF> > qr;
+    Innovation last_innovation;
+    FilterInstrumentation* instrumentation;
+    unsigned long revision;
+    bool cross_covariance_enabled;
+    bool likelihood_enabled;
+    Covariance prediction_cross_covariance;
+    SigmaPointParameters scheme;
+    PointSet point_set;
+    /* Point set of the core of structuredPredict, computed on its first call */
+    PointSet core_point_set;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}
+
+#endif
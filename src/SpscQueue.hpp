@@ -0,0 +1,83 @@
+#ifndef _UWV_KALMAN_FILTERS_SPSC_QUEUE_HPP_
+#define _UWV_KALMAN_FILTERS_SPSC_QUEUE_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Bounded lock-free queue for a single producer and a single consumer thread.
+ *
+ * The storage is allocated once at construction, the capacity is rounded up to a power of two.
+ * push is only called by the producer, front and pop only by the consumer.
+ * The indices are padded to separate cache lines to avoid false sharing between both threads.
+ */
+template<typename T, typename Allocator = std::allocator<T> >
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity) : head(0), tail(0)
+    {
+        if(capacity == 0)
+            throw std::invalid_argument("The capacity of a queue must be positive");
+        std::size_t size = 1;
+        while(size < capacity)
+            size <<= 1;
+        elements.resize(size);
+        mask = size - 1;
+    }
+
+    std::size_t capacity() const { return elements.size(); }
+
+    /* Number of queued elements, exact only if called by the producer or the consumer */
+    std::size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /* Returns false if the queue is full */
+    bool push(const T& element)
+    {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail.load(std::memory_order_acquire) == elements.size())
+            return false;
+        elements[h & mask] = element;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Oldest element or NULL if the queue is empty, the element stays valid until pop is called */
+    const T* front() const
+    {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        if(t == head.load(std::memory_order_acquire))
+            return NULL;
+        return &elements[t & mask];
+    }
+
+    /* Removes the oldest element, the queue must not be empty */
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    SpscQueue(const SpscQueue&);
+    SpscQueue& operator=(const SpscQueue&);
+
+    std::vector<T, Allocator> elements;
+    std::size_t mask;
+    enum { CACHE_LINE = 64 };
+    char head_padding[CACHE_LINE];
+    std::atomic<std::size_t> head;
+    char tail_padding[CACHE_LINE - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail;
+};
+
+}
+
+#endif
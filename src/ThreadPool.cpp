@@ -0,0 +1,100 @@
+#include "ThreadPool.hpp"
+
+using namespace uwv_kalman_filters;
+
+ThreadPool::ThreadPool(unsigned workers) : task(NULL), task_context(NULL), task_count(0),
+    next_index(0), generation(0), busy_workers(0), shutdown(false)
+{
+    for(unsigned worker = 1; worker < workers; worker++)
+        threads.push_back(std::thread(&ThreadPool::workerLoop, this, worker));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    start_condition.notify_all();
+    for(std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); it++)
+        it->join();
+}
+
+unsigned ThreadPool::size() const
+{
+    return threads.size() + 1;
+}
+
+void ThreadPool::run(std::size_t count, Task task, void* context)
+{
+    if(count == 0)
+        return;
+
+    // the pool executes one range at a time
+    std::lock_guard<std::mutex> run_lock(run_mutex);
+
+    if(threads.empty() || count == 1)
+    {
+        for(std::size_t i = 0; i < count; i++)
+            task(context, i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = task;
+        task_context = context;
+        task_count = count;
+        next_index.store(0);
+        error = std::exception_ptr();
+        busy_workers = threads.size();
+        generation++;
+    }
+    start_condition.notify_all();
+
+    process(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_condition.wait(lock, [this]() { return busy_workers == 0; });
+    this->task = NULL;
+    if(error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::process(unsigned worker)
+{
+    try
+    {
+        for(std::size_t i = next_index.fetch_add(1); i < task_count; i = next_index.fetch_add(1))
+            task(task_context, i, worker);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!error)
+            error = std::current_exception();
+        // skip the remaining indices
+        next_index.store(task_count);
+    }
+}
+
+void ThreadPool::workerLoop(unsigned worker)
+{
+    unsigned last_generation = 0;
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start_condition.wait(lock, [this, last_generation]() { return shutdown || generation != last_generation; });
+            if(shutdown)
+                return;
+            last_generation = generation;
+        }
+
+        process(worker);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--busy_workers == 0)
+            done_condition.notify_one();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef _UWV_KALMAN_FILTERS_THREAD_POOL_HPP_
+#define _UWV_KALMAN_FILTERS_THREAD_POOL_HPP_
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+
+namespace uwv_kalman_filters
+{
+
+/**
+ * Fixed-size pool of worker threads executing index ranges in parallel.
+ *
+ * The threads are created once at construction. A call of parallelFor distributes
+ * the indices dynamically between the workers and the calling thread, which takes
+ * part in the work as worker 0. Each invocation of the function receives the index
+ * and the id of the worker executing it, in the range [0, size()).
+ * This allows to access per worker scratch data without locking.
+ * A call to parallelFor returns once all indices have been processed.
+ */
+class ThreadPool
+{
+public:
+    /* Creates a pool with the given number of concurrent workers, including the calling thread */
+    explicit ThreadPool(unsigned workers);
+    ~ThreadPool();
+
+    /* Number of concurrent workers, including the calling thread */
+    unsigned size() const;
+
+    /* Calls function(index, worker) for all indices in [0, count) */
+    template<typename Function>
+    void parallelFor(std::size_t count, Function& function)
+    {
+        run(count, &invoke<Function>, &function);
+    }
+
+private:
+    typedef void (*Task)(void* context, std::size_t index, unsigned worker);
+
+    template<typename Function>
+    static void invoke(void* context, std::size_t index, unsigned worker)
+    {
+        (*static_cast<Function*>(context))(index, worker);
+    }
+
+    void run(std::size_t count, Task task, void* context);
+    void process(unsigned worker);
+    void workerLoop(unsigned worker);
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    std::vector<std::thread> threads;
+    std::mutex run_mutex;
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+    Task task;
+    void* task_context;
+    std::size_t task_count;
+    std::atomic<std::size_t> next_index;
+    unsigned generation;
+    unsigned busy_workers;
+    bool shutdown;
+    std::exception_ptr error;
+};
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+#include "VehicleFleet.hpp"
+#include <stdexcept>
+#include "EffortModel.hpp"
+#include "MissionReplay.hpp"
+
+using namespace uwv_kalman_filters;
+
+VehicleFleet::VehicleFleet(unsigned threads)
+{
+    if(threads > 1)
+        thread_pool.reset(new ThreadPool(threads));
+}
+
+unsigned VehicleFleet::addVehicleClass(const VehicleClass& vehicle_class)
+{
+    // each worker of the fleet evaluates the motion models on its own instances
+    const unsigned workers = thread_pool ? thread_pool->size() : 1;
+    ClassModels models;
+    models.configuration.reset(new VehicleClass(vehicle_class));
+    boost::shared_ptr<PoseUKF::EffortModels> effort_models(new PoseUKF::EffortModels());
+    for(unsigned i = 0; i < workers; i++)
+        effort_models->push_back(boost::shared_ptr<EffortModel>(new EffortModel(vehicle_class.model_parameters)));
+    models.effort_models = effort_models;
+    models.prediction_models = VelocityUKF::createPredictionModels(vehicle_class.model_parameters, workers);
+    vehicle_classes.push_back(models);
+    return vehicle_classes.size() - 1;
+}
+
+unsigned VehicleFleet::createVehicle(unsigned vehicle_class, const PoseUKF::State& initial_state, const PoseUKF::Covariance& state_cov)
+{
+    if(vehicle_class >= vehicle_classes.size())
+        throw std::invalid_argument("Unknown vehicle class");
+    const ClassModels& models = vehicle_classes[vehicle_class];
+    const VehicleClass& config = *models.configuration;
+    boost::shared_ptr<PoseUKF> filter(new PoseUKF(initial_state, state_cov, config.location,
+                                                  config.model_parameters, config.filter_parameter));
+    filter->setEffortModels(models.effort_models);
+    const unsigned vehicle = addVehicle(filter);
+    vehicle_class_indices[vehicle] = vehicle_class;
+    return vehicle;
+}
+
+void VehicleFleet::createVelocityFilter(unsigned vehicle, const VelocityUKF::State& initial_state, const VelocityUKF::Covariance& state_cov)
+{
+    if(vehicle >= pose_filters.size())
+        throw std::out_of_range("Unknown vehicle");
+    if(vehicle_class_indices[vehicle] < 0)
+        throw std::invalid_argument("The vehicle was not created from a vehicle class");
+    const ClassModels& models = vehicle_classes[vehicle_class_indices[vehicle]];
+    boost::shared_ptr<VelocityUKF> filter(new VelocityUKF(initial_state, state_cov));
+    // the motion model of the filter only follows the orientation, the prediction uses the models of the class
+    filter->setupMotionModel(models.configuration->model_parameters);
+    filter->setPredictionModels(models.prediction_models);
+    setVelocityFilter(vehicle, filter);
+    shared_velocity_models[vehicle] = true;
+}
+
+unsigned VehicleFleet::addVehicle(const boost::shared_ptr<PoseUKF>& pose_filter, const boost::shared_ptr<VelocityUKF>& velocity_filter)
+{
+    if(!pose_filter)
+        throw std::invalid_argument("A vehicle requires a pose filter");
+    pose_filters.push_back(pose_filter);
+    velocity_filters.push_back(velocity_filter);
+    vehicle_class_indices.push_back(-1);
+    shared_velocity_models.push_back(false);
+    states.positions.push_back(Eigen::Vector3d::Zero());
+    states.orientations.push_back(Eigen::Quaterniond::Identity());
+    states.velocities.push_back(Eigen::Vector3d::Zero());
+    states.twists.push_back(base::Vector6d::Zero());
+    gatherState(pose_filters.size() - 1);
+    return pose_filters.size() - 1;
+}
+
+void VehicleFleet::setVelocityFilter(unsigned vehicle, const boost::shared_ptr<VelocityUKF>& velocity_filter)
+{
+    if(vehicle >= pose_filters.size())
+        throw std::out_of_range("Unknown vehicle");
+    velocity_filters[vehicle] = velocity_filter;
+    shared_velocity_models[vehicle] = false;
+    gatherState(vehicle);
+}
+
+void VehicleFleet::selectModels(std::size_t vehicle, unsigned worker)
+{
+    if(vehicle_class_indices[vehicle] < 0)
+        return;
+    pose_filters[vehicle]->setEffortModelOffset(worker);
+    if(shared_velocity_models[vehicle])
+        velocity_filters[vehicle]->setPredictionModelSlot(worker);
+}
+
+void VehicleFleet::gatherState(std::size_t vehicle)
+{
+    PoseUKF::State state;
+    pose_filters[vehicle]->getCurrentState(state);
+    states.positions[vehicle] = state.position;
+    states.orientations[vehicle] = state.orientation;
+    states.velocities[vehicle] = state.velocity;
+    if(velocity_filters[vehicle])
+        states.twists[vehicle] = velocity_filters[vehicle]->getTwist();
+    else
+        states.twists[vehicle].setZero();
+}
+
+void VehicleFleet::predictionStep(double delta_t)
+{
+    // each vehicle gets a segment of the batch, filters which can't be batched predict on their own
+    sigma_point_batch.clear();
+    single_precision_batch.clear();
+    for(std::size_t i = 0; i < pose_filters.size(); i++)
+    {
+        const bool single_precision = pose_filters[i]->getPropagationPrecision() == PoseUKF::SINGLE_PRECISION;
+        const unsigned count = pose_filters[i]->getSigmaPointCount();
+        sigma_point_batch.addSegment(single_precision ? 0 : count);
+        single_precision_batch.addSegment(single_precision ? count : 0);
+    }
+    auto begin = [this, delta_t](std::size_t vehicle, unsigned worker)
+    {
+        selectModels(vehicle, worker);
+        PoseUKF& filter = *pose_filters[vehicle];
+        const bool batched = filter.getPropagationPrecision() == PoseUKF::SINGLE_PRECISION ?
+                             filter.beginBatchedPrediction(delta_t, single_precision_batch, vehicle) :
+                             filter.beginBatchedPrediction(delta_t, sigma_point_batch, vehicle);
+        if(!batched)
+            filter.predictionStep(delta_t);
+    };
+    fanOut(begin);
+
+    // a single evaluation of the process model, with threads each worker takes a contiguous range of vehicles
+    const unsigned vehicles = pose_filters.size();
+    const unsigned ranges = thread_pool ? thread_pool->size() : 1;
+    auto propagate = [this, delta_t, vehicles, ranges](std::size_t range, unsigned)
+    {
+        PoseUKF::predictBatch(sigma_point_batch, delta_t, range * vehicles / ranges, (range + 1) * vehicles / ranges);
+        PoseUKF::predictBatch(single_precision_batch, delta_t, range * vehicles / ranges, (range + 1) * vehicles / ranges);
+    };
+    if(thread_pool)
+        thread_pool->parallelFor(ranges, propagate);
+    else
+        propagate(0, 0);
+
+    auto commit = [this, delta_t](std::size_t vehicle, unsigned worker)
+    {
+        selectModels(vehicle, worker);
+        if(sigma_point_batch.segments[vehicle].columns > 0)
+            pose_filters[vehicle]->commitBatchedPrediction(sigma_point_batch, vehicle);
+        else if(single_precision_batch.segments[vehicle].columns > 0)
+            pose_filters[vehicle]->commitBatchedPrediction(single_precision_batch, vehicle);
+        if(velocity_filters[vehicle])
+            velocity_filters[vehicle]->predictionStep(delta_t);
+        gatherState(vehicle);
+    };
+    fanOut(commit);
+}
+
+unsigned VehicleFleet::integrateRecords(const std::vector<FleetRecord>& records)
+{
+    // counting sort of the records by vehicle, keeping the order of each vehicle
+    record_offsets.assign(pose_filters.size() + 1, 0);
+    for(std::size_t i = 0; i < records.size(); i++)
+    {
+        if(records[i].vehicle >= pose_filters.size())
+            throw std::out_of_range("Record of an unknown vehicle");
+        record_offsets[records[i].vehicle + 1]++;
+    }
+    for(std::size_t i = 1; i < record_offsets.size(); i++)
+        record_offsets[i] += record_offsets[i - 1];
+    record_order.resize(records.size());
+    integrated_records.assign(pose_filters.size(), 0);
+    for(std::size_t i = 0; i < records.size(); i++)
+        record_order[record_offsets[records[i].vehicle] + integrated_records[records[i].vehicle]++] = i;
+
+    auto task = [this, &records](std::size_t vehicle, unsigned worker)
+    {
+        selectModels(vehicle, worker);
+        unsigned integrated = 0;
+        for(unsigned i = record_offsets[vehicle]; i < record_offsets[vehicle + 1]; i++)
+        {
+            const MissionLogRecord& record = records[record_order[i]].record;
+            bool integrated_record = integrateRecord(*pose_filters[vehicle], record);
+            if(velocity_filters[vehicle] && integrateRecord(*velocity_filters[vehicle], record))
+                integrated_record = true;
+            if(integrated_record)
+                integrated++;
+        }
+        integrated_records[vehicle] = integrated;
+        if(record_offsets[vehicle + 1] > record_offsets[vehicle])
+            gatherState(vehicle);
+    };
+    fanOut(task);
+
+    unsigned integrated = 0;
+    for(std::size_t i = 0; i < integrated_records.size(); i++)
+        integrated += integrated_records[i];
+    return integrated;
+}
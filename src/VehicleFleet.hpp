@@ -0,0 +1,163 @@
+#ifndef _UWV_KALMAN_FILTERS_VEHICLE_FLEET_HPP_
+#define _UWV_KALMAN_FILTERS_VEHICLE_FLEET_HPP_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <Eigen/StdVector>
+#include "PoseUKF.hpp"
+#include "VelocityUKF.hpp"
+#include "MissionLog.hpp"
+
+namespace uwv_kalman_filters
+{
+
+/* Configuration shared by all vehicles of the same type */
+struct VehicleClass
+{
+    LocationConfiguration location;
+    uwv_dynamic_model::UWVParameters model_parameters;
+    PoseUKF::PoseUKFParameter filter_parameter;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/* Record of the sensor stream of one vehicle of a fleet */
+struct FleetRecord
+{
+    unsigned vehicle;
+    MissionLogRecord record;
+};
+
+/* Estimates of all vehicles of a fleet, indexed by vehicle */
+struct FleetStates
+{
+    /* Position, orientation and velocity of the IMU in the navigation frame of the PoseUKF */
+    std::vector< Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > positions;
+    std::vector< Eigen::Quaterniond, Eigen::aligned_allocator<Eigen::Quaterniond> > orientations;
+    std::vector< Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > velocities;
+    /* Twist of the VelocityUKF in the body frame, zero for vehicles without one */
+    std::vector< base::Vector6d, Eigen::aligned_allocator<base::Vector6d> > twists;
+};
+
+/**
+ * Container for the simulation of many vehicles, each with its own PoseUKF and optionally a VelocityUKF.
+ *
+ * A single call advances or updates the whole fleet, the vehicles are distributed on a thread pool,
+ * one vehicle per task, in the same way as the hypotheses of a PoseUKFBank. The filters of a vehicle
+ * are therefore expected to run their sigma points on a single thread.
+ *
+ * The filters of the vehicles created from a VehicleClass share its read-only configuration and its
+ * motion models, i.e. the effort models of the PoseUKFs and the prediction models of the VelocityUKFs.
+ * The class holds one model per worker of the fleet, each task selects the models of its worker.
+ *
+ * The prediction samples the sigma points of all PoseUKFs into one structure of arrays
+ * (see PoseUKF::SigmaPointBatch) and propagates them in a single evaluation of the process model,
+ * which works on the components of all sigma points of a vehicle at once. The mean and covariance of
+ * each vehicle stay in its filter. Filters propagating in single precision (see PoseUKF::setPropagationPrecision)
+ * share a second batch in float. Filters whose prediction can't be batched (see
+ * PoseUKF::beginBatchedPrediction) predict on their own.
+ * After each call the estimates of all vehicles are gathered in a structure of arrays (see FleetStates),
+ * which allows the simulation to read the whole fleet without touching the filters.
+ */
+class VehicleFleet
+{
+public:
+    explicit VehicleFleet(unsigned threads = 1);
+
+    /* Registers a vehicle configuration for createVehicle and creates its shared models, returns its index */
+    unsigned addVehicleClass(const VehicleClass& vehicle_class);
+
+    /* Creates a PoseUKF of the given class, returns the index of the vehicle */
+    unsigned createVehicle(unsigned vehicle_class, const PoseUKF::State& initial_state, const PoseUKF::Covariance& state_cov);
+
+    /* Creates a VelocityUKF for a vehicle created by createVehicle, with the motion model of its class.
+     * Throws std::invalid_argument if the vehicle has no class */
+    void createVelocityFilter(unsigned vehicle, const VelocityUKF::State& initial_state, const VelocityUKF::Covariance& state_cov);
+
+    /* Adds a vehicle with existing filters, returns its index. The velocity filter is optional.
+     * The filters keep their own motion models */
+    unsigned addVehicle(const boost::shared_ptr<PoseUKF>& pose_filter,
+                        const boost::shared_ptr<VelocityUKF>& velocity_filter = boost::shared_ptr<VelocityUKF>());
+
+    /* Attaches a velocity filter to the vehicle, replacing the current one. It keeps its own motion model */
+    void setVelocityFilter(unsigned vehicle, const boost::shared_ptr<VelocityUKF>& velocity_filter);
+
+    /* Number of vehicles */
+    unsigned size() const { return pose_filters.size(); }
+
+    const boost::shared_ptr<PoseUKF>& getPoseFilter(unsigned vehicle) const { return pose_filters[vehicle]; }
+    const boost::shared_ptr<VelocityUKF>& getVelocityFilter(unsigned vehicle) const { return velocity_filters[vehicle]; }
+
+    /* Predicts the filters of all vehicles */
+    void predictionStep(double delta_t);
+
+    /* Integrates the records of each vehicle in the given order, see integrateRecord. Both the PoseUKF and the
+     * VelocityUKF of a vehicle receive the records they can integrate, e.g. velocities and z positions.
+     * The time stamps are ignored, the records should be given between the predictions to their time.
+     * Returns the number of records integrated in at least one of the filters */
+    unsigned integrateRecords(const std::vector<FleetRecord>& records);
+
+    /* Calls function(vehicle, pose_filter, velocity_filter) for every vehicle, the velocity filter might be NULL.
+     * The filters use the motion models of the worker calling the function, they must not be passed on to other threads */
+    template<typename Function>
+    void forEach(Function& function)
+    {
+        auto task = [this, &function](std::size_t vehicle, unsigned worker)
+        {
+            selectModels(vehicle, worker);
+            function(unsigned(vehicle), *pose_filters[vehicle], velocity_filters[vehicle].get());
+            gatherState(vehicle);
+        };
+        fanOut(task);
+    }
+
+    /* Estimates of all vehicles after the last call of the fleet */
+    const FleetStates& getStates() const { return states; }
+
+protected:
+    template<typename Task>
+    void fanOut(Task& task)
+    {
+        if(thread_pool)
+            thread_pool->parallelFor(pose_filters.size(), task);
+        else
+        {
+            for(std::size_t i = 0; i < pose_filters.size(); i++)
+                task(i, 0);
+        }
+    }
+
+    void gatherState(std::size_t vehicle);
+
+    /* Lets the filters of a vehicle created from a class use the shared models of the worker */
+    void selectModels(std::size_t vehicle, unsigned worker);
+
+    /* Configuration of a vehicle class and the motion models of its vehicles, one per worker */
+    struct ClassModels
+    {
+        boost::shared_ptr<const VehicleClass> configuration;
+        boost::shared_ptr<const PoseUKF::EffortModels> effort_models;
+        boost::shared_ptr<const VelocityUKF::PredictionModels> prediction_models;
+    };
+
+    boost::shared_ptr<ThreadPool> thread_pool;
+    std::vector<ClassModels> vehicle_classes;
+    /* Class of each vehicle, negative for vehicles added with their own filters */
+    std::vector<int> vehicle_class_indices;
+    /* True if the velocity filter of the vehicle uses the prediction models of its class */
+    std::vector<bool> shared_velocity_models;
+    std::vector< boost::shared_ptr<PoseUKF> > pose_filters;
+    std::vector< boost::shared_ptr<VelocityUKF> > velocity_filters;
+    FleetStates states;
+    /* Sigma points of the batched prediction in each precision, reused by predictionStep.
+     * Each vehicle has a segment in both, the one of the other precision is empty */
+    PoseUKF::SigmaPointBatch sigma_point_batch;
+    PoseUKF::SinglePrecisionSigmaPointBatch single_precision_batch;
+    /* Record indices sorted by vehicle, reused by integrateRecords */
+    std::vector<unsigned> record_offsets;
+    std::vector<unsigned> record_order;
+    std::vector<unsigned> integrated_records;
+};
+
+}
+
+#endif
@@ -1,8 +1,13 @@
 #include "VelocityUKF.hpp"
 #include <uwv_dynamic_model/ModelSimulation.hpp>
+#include <uwv_dynamic_model/DynamicModel.hpp>
+#include <Eigen/LU>
+#include <stdexcept>
 
 using namespace uwv_kalman_filters;
 
+template class uwv_kalman_filters::SigmaPointFilter<VelocityUKF::WState>;
+
 template <typename VelocityState>
 VelocityState
 processMotionModel(const VelocityState &state, boost::shared_ptr<uwv_dynamic_model::ModelSimulation> motion_model,
@@ -32,6 +37,49 @@ processMotionModel(const VelocityState &state, boost::shared_ptr<uwv_dynamic_mod
     return new_state;
 }
 
+/* Linear acceleration of the motion model, M^-1 * (efforts - efforts of the model at zero acceleration) */
+static Eigen::Vector3d
+modelAcceleration(uwv_dynamic_model::DynamicModel& dynamic_model, const base::Matrix6d& inverse_inertia,
+                  const Eigen::Quaterniond& orientation, const base::Vector3d& linear_velocity,
+                  const base::Vector3d& angular_velocity, const base::Vector6d& body_efforts)
+{
+    base::Vector6d velocity_6d;
+    velocity_6d << linear_velocity, angular_velocity;
+    base::Vector6d efforts = body_efforts - dynamic_model.calcEfforts(base::Vector6d::Zero(), velocity_6d, orientation);
+    return inverse_inertia.topRows<3>() * efforts;
+}
+
+template <typename VelocityState>
+VelocityState
+processAccelerationModel(const VelocityState &state, const boost::shared_ptr<uwv_dynamic_model::DynamicModel>& dynamic_model,
+                         const base::Matrix6d& inverse_inertia, const Eigen::Quaterniond& orientation,
+                         const base::Vector3d& angular_velocity, const base::Vector6d& body_efforts,
+                         bool runge_kutta, double delta_time)
+{
+    const Eigen::Vector3d velocity = state.velocity;
+    Eigen::Vector3d velocity_delta;
+    Eigen::Vector3d k1 = modelAcceleration(*dynamic_model, inverse_inertia, orientation, velocity, angular_velocity, body_efforts);
+    if(runge_kutta)
+    {
+        Eigen::Vector3d k2 = modelAcceleration(*dynamic_model, inverse_inertia, orientation, velocity + (0.5 * delta_time) * k1, angular_velocity, body_efforts);
+        Eigen::Vector3d k3 = modelAcceleration(*dynamic_model, inverse_inertia, orientation, velocity + (0.5 * delta_time) * k2, angular_velocity, body_efforts);
+        Eigen::Vector3d k4 = modelAcceleration(*dynamic_model, inverse_inertia, orientation, velocity + delta_time * k3, angular_velocity, body_efforts);
+        velocity_delta = (delta_time / 6.) * (k1 + 2. * k2 + 2. * k3 + k4);
+    }
+    else
+        velocity_delta = delta_time * k1;
+
+    // apply velocity delta
+    VelocityState new_state(state);
+    new_state.velocity.boxplus(velocity_delta);
+
+    // apply velocity in z
+    Eigen::Matrix<double, 1, 1> z_vel;
+    z_vel(0) = (orientation * new_state.velocity).z();
+    new_state.z_position.boxplus(z_vel, delta_time);
+    return new_state;
+}
+
 template <typename VelocityState>
 VelocityType
 measurementDVL(const VelocityState &state)
@@ -46,20 +94,104 @@ measurementPressureSensor(const VelocityState &state)
     return state.z_position;
 }
 
-VelocityUKF::VelocityUKF(const State& initial_state, const Covariance& state_cov)
+typedef FilterInstrumentation::CallScope< SigmaPointFilter<VelocityUKF::WState>::Innovation > CallScope;
+
+static const char* const channel_names[VelocityUKF::CHANNEL_COUNT] = {"prediction", "dvl", "pressure"};
+
+VelocityUKF::VelocityUKF(const State& initial_state, const Covariance& state_cov) : prediction_model_slot(0), prediction_mode(MODEL_SIMULATION), state_revision(0)
 {
     initializeFilter(initial_state, state_cov);
+    angular_velocity.mu = GyroMeasurement::Mu::Zero();
+    angular_velocity.cov = GyroMeasurement::Cov::Zero();
+
+    sigma_point_filter.reset(new SigmaPointFilter<WState>());
+    instrumentation.reset(new FilterInstrumentation(channel_names, CHANNEL_COUNT));
+    sigma_point_filter->setInstrumentation(instrumentation.get());
 
     process_noise_cov = Covariance::Zero();
     MTK::setDiagonal(process_noise_cov, &WState::velocity, 0.0001);
 }
 
+void VelocityUKF::setPredictionMode(PredictionMode mode)
+{
+    prediction_mode = mode;
+}
+
+void VelocityUKF::setFilterBackend(FilterBackend backend)
+{
+    sigma_point_filter->setBackend(backend);
+}
+
+void VelocityUKF::setSigmaPointScheme(const SigmaPointParameters& parameters)
+{
+    sigma_point_filter->setScheme(parameters);
+}
+
+FilterStatistics VelocityUKF::getStatistics() const
+{
+    return instrumentation->getStatistics();
+}
+
+unsigned long VelocityUKF::getStateRevision() const
+{
+    return sigma_point_filter->getRevision() + state_revision;
+}
+
+const base::Vector6d& VelocityUKF::getTwist() const
+{
+    return twist_output.get(getStateRevision(), [this](base::Vector6d& output)
+    {
+        output << ukf->mu().velocity, angular_velocity.mu;
+    });
+}
+
+const base::Matrix6d& VelocityUKF::getTwistCovariance() const
+{
+    return twist_cov_output.get(getStateRevision(), [this](base::Matrix6d& output)
+    {
+        output.setZero();
+        output.topLeftCorner<3,3>() = MTK::subblock(ukf->sigma(), &State::velocity);
+        output.bottomRightCorner<3,3>() = angular_velocity.cov;
+    });
+}
+
+boost::shared_ptr<VelocityUKF::PredictionModels> VelocityUKF::createPredictionModels(const uwv_dynamic_model::UWVParameters& parameters,
+                                                                                    unsigned slots)
+{
+    boost::shared_ptr<PredictionModels> models(new PredictionModels());
+    for(unsigned i = 0; i < slots; i++)
+    {
+        models->simulations.push_back(boost::shared_ptr<uwv_dynamic_model::ModelSimulation>(
+                new uwv_dynamic_model::ModelSimulation(uwv_dynamic_model::DYNAMIC, 0.01, 1)));
+        models->simulations.back()->setUWVParameters(parameters);
+        models->dynamic_models.push_back(boost::shared_ptr<uwv_dynamic_model::DynamicModel>(new uwv_dynamic_model::DynamicModel()));
+        models->dynamic_models.back()->setUWVParameters(parameters);
+    }
+    models->inverse_inertia = parameters.inertia_matrix.inverse();
+    return models;
+}
+
+void VelocityUKF::setPredictionModels(const boost::shared_ptr<const PredictionModels>& models, unsigned slot)
+{
+    if(!models || slot >= models->simulations.size())
+        throw std::invalid_argument("The slot is not one of the prediction models");
+    prediction_models = models;
+    prediction_model_slot = slot;
+}
+
+void VelocityUKF::setPredictionModelSlot(unsigned slot)
+{
+    if(!prediction_models || slot >= prediction_models->simulations.size())
+        throw std::invalid_argument("The slot is not one of the prediction models");
+    prediction_model_slot = slot;
+}
+
 bool VelocityUKF::setupMotionModel(const uwv_dynamic_model::UWVParameters& parameters)
 {
     motion_model.reset(new uwv_dynamic_model::ModelSimulation(uwv_dynamic_model::DYNAMIC, 0.01, 1));
     motion_model->setUWVParameters(parameters);
-    prediction_model.reset(new uwv_dynamic_model::ModelSimulation(uwv_dynamic_model::DYNAMIC, 0.01, 1));
-    prediction_model->setUWVParameters(parameters);
+    prediction_models = createPredictionModels(parameters);
+    prediction_model_slot = 0;
 
     uwv_dynamic_model::PoseVelocityState model_state;
     model_state.position = base::Vector3d::Zero();
@@ -77,10 +209,10 @@ bool VelocityUKF::setupMotionModel(const uwv_dynamic_model::UWVParameters& param
 
 void VelocityUKF::integrateMeasurement(const DVLMeasurement& measurement)
 {
+    CallScope scope(instrumentation.get(), DVL_CHANNEL, sigma_point_filter->getLastInnovation());
     checkMeasurment(measurement.mu, measurement.cov);
-    ukf->update(measurement.mu, boost::bind(measurementDVL<State>, _1),
-                boost::bind(ukfom::id< DVLMeasurement::Cov >, measurement.cov),
-                ukfom::accept_any_mahalanobis_distance<State::scalar>);
+    sigma_point_filter->update(*ukf, measurement.mu, boost::bind(measurementDVL<State>, _1),
+                               measurement.cov, ukfom::accept_any_mahalanobis_distance<State::scalar>);
 }
 
 void VelocityUKF::integrateMeasurement(const GyroMeasurement& measurement)
@@ -94,6 +226,7 @@ void VelocityUKF::integrateMeasurement(const GyroMeasurement& measurement)
         motion_model->setPose(model_state);
     }
     angular_velocity = measurement;
+    state_revision++;
 }
 
 void VelocityUKF::integrateMeasurement(const BodyEffortsMeasurement& measurement)
@@ -104,22 +237,31 @@ void VelocityUKF::integrateMeasurement(const BodyEffortsMeasurement& measurement
 
 void VelocityUKF::integrateMeasurement(const PressureMeasurement& measurement)
 {
+    CallScope scope(instrumentation.get(), PRESSURE_CHANNEL, sigma_point_filter->getLastInnovation());
     checkMeasurment(measurement.mu, measurement.cov);
-    ukf->update(measurement.mu, boost::bind(measurementPressureSensor<State>, _1),
-                boost::bind(ukfom::id< PressureMeasurement::Cov >, measurement.cov),
-                ukfom::accept_any_mahalanobis_distance<State::scalar>);
+    sigma_point_filter->update(*ukf, measurement.mu, boost::bind(measurementPressureSensor<State>, _1),
+                               measurement.cov, ukfom::accept_any_mahalanobis_distance<State::scalar>);
 }
 
 void VelocityUKF::predictionStepImpl(double delta)
 {
+    CallScope scope(instrumentation.get(), PREDICTION_CHANNEL, sigma_point_filter->getLastInnovation());
     // use motion model to determine the current acceleration
-    if (motion_model.get() == NULL || prediction_model.get() == NULL)
+    if (motion_model.get() == NULL || prediction_models.get() == NULL)
         throw std::runtime_error("Motion model is not initialized!");
 
     // apply motion commands
     uwv_dynamic_model::PoseVelocityState model_state = motion_model->getPose();
-    ukf->predict(boost::bind(processMotionModel<WState>, _1, prediction_model, model_state.orientation,
-                                angular_velocity.mu, body_efforts.mu, delta), MTK_UKF::cov(delta * process_noise_cov));
+    if(prediction_mode == MODEL_SIMULATION)
+        sigma_point_filter->predict(*ukf, boost::bind(processMotionModel<WState>, _1, prediction_models->simulations[prediction_model_slot],
+                                                      model_state.orientation, angular_velocity.mu, body_efforts.mu, delta),
+                                    delta * process_noise_cov);
+    else
+        sigma_point_filter->predict(*ukf, boost::bind(processAccelerationModel<WState>, _1,
+                                                      boost::cref(prediction_models->dynamic_models[prediction_model_slot]),
+                                                      boost::cref(prediction_models->inverse_inertia), model_state.orientation, angular_velocity.mu,
+                                                      body_efforts.mu, prediction_mode == RUNGE_KUTTA_STEP, delta),
+                                    delta * process_noise_cov);
 
     // this motion model is updated to have a guess about the current orientation
     motion_model->setSamplingTime(delta);
@@ -9,10 +9,13 @@
 #include <mtk/types/vect.hpp>
 #include <mtk/startIdx.hpp>
 #include <mtk/build_manifold.hpp>
+#include "SigmaPointFilter.hpp"
+#include "LazyOutput.hpp"
 
 namespace uwv_dynamic_model
 {
     class ModelSimulation;
+    class DynamicModel;
 }
 
 namespace uwv_kalman_filters
@@ -38,13 +41,73 @@ public:
     MEASUREMENT(BodyEffortsMeasurement, 6)
     MEASUREMENT(PressureMeasurement, 1)
 
+    /* Integration of the motion model in the prediction step */
+    enum PredictionMode
+    {
+        /* Each sigma point is integrated by the uwv_dynamic_model::ModelSimulation */
+        MODEL_SIMULATION,
+        /* Single explicit Euler step of the model acceleration */
+        EULER_STEP,
+        /* Single classical Runge-Kutta step of the model acceleration */
+        RUNGE_KUTTA_STEP
+    };
+
+    /* Models of the prediction step, which can be shared by the filters of identical vehicles.
+     * The models of a slot must not be used concurrently, filters running at the same time need distinct slots */
+    struct PredictionModels
+    {
+        std::vector< boost::shared_ptr<uwv_dynamic_model::ModelSimulation> > simulations;
+        std::vector< boost::shared_ptr<uwv_dynamic_model::DynamicModel> > dynamic_models;
+        base::Matrix6d inverse_inertia;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    /* Instrumented calls, see getStatistics */
+    enum StatisticsChannel
+    {
+        PREDICTION_CHANNEL,
+        DVL_CHANNEL,
+        PRESSURE_CHANNEL,
+        CHANNEL_COUNT
+    };
+
 public:
     VelocityUKF(const State& initial_state, const Covariance& state_cov);
     virtual ~VelocityUKF() {}
 
+    /** Selects the covariance representation, see FilterBackend */
+    void setFilterBackend(FilterBackend backend);
+
+    /** Selects the sigma point set of the predictions and updates, see SigmaPointScheme.
+     * Throws std::invalid_argument if the parameters are invalid */
+    void setSigmaPointScheme(const SigmaPointParameters& parameters);
+
+    /** Snapshot of the call counts, timings and NIS values per StatisticsChannel.
+     * Can be called from any thread, all counters are zero unless built with ENABLE_INSTRUMENTATION */
+    FilterStatistics getStatistics() const;
+
     /** Set AUV motion model parameters */
     bool setupMotionModel(const uwv_dynamic_model::UWVParameters& parameters);
 
+    /** Prediction models of the given parameters with the given number of slots */
+    static boost::shared_ptr<PredictionModels> createPredictionModels(const uwv_dynamic_model::UWVParameters& parameters,
+                                                                      unsigned slots = 1);
+
+    /** Predicts with shared models instead of the ones created by setupMotionModel, which is still required
+     * for the orientation guess of the filter. The given slot is used, see setPredictionModelSlot.
+     * Calling setupMotionModel again creates models of its own.
+     * Throws std::invalid_argument if the slot is not one of the models */
+    void setPredictionModels(const boost::shared_ptr<const PredictionModels>& models, unsigned slot = 0);
+
+    /** Selects the slot of the prediction models */
+    void setPredictionModelSlot(unsigned slot);
+
+    /** Selects how the motion model is integrated, the default is MODEL_SIMULATION.
+     * In the EULER_STEP and RUNGE_KUTTA_STEP modes the acceleration of each sigma point is
+     * evaluated directly using the inverse of the inertia matrix cached in the prediction models.
+     * Orientation and angular velocity are assumed to be constant during a prediction step. */
+    void setPredictionMode(PredictionMode mode);
+
     /** Velocity of the AUV */
     void integrateMeasurement(const DVLMeasurement& measurement);
 
@@ -57,14 +120,39 @@ public:
     /** Altitude to the AUV */
     void integrateMeasurement(const PressureMeasurement& measurement);
 
+    /** Changes with every prediction, measurement update and rotation rate.
+     * The outputs below are computed at most once per revision and are not thread-safe */
+    unsigned long getStateRevision() const;
+
+    /** Linear velocity of the state and the latest angular velocity (in this order) in the body frame */
+    const base::Vector6d& getTwist() const;
+
+    /** Covariance of the twist, the angular velocity is uncorrelated with the state */
+    const base::Matrix6d& getTwistCovariance() const;
+
 protected:
     void predictionStepImpl(double delta_t);
 
 protected:
     boost::shared_ptr<uwv_dynamic_model::ModelSimulation> motion_model;
-    boost::shared_ptr<uwv_dynamic_model::ModelSimulation> prediction_model;
+    boost::shared_ptr<const PredictionModels> prediction_models;
+    unsigned prediction_model_slot;
+    PredictionMode prediction_mode;
     GyroMeasurement angular_velocity;
     BodyEffortsMeasurement body_efforts;
+    boost::shared_ptr< SigmaPointFilter<WState> > sigma_point_filter;
+    boost::shared_ptr<FilterInstrumentation> instrumentation;
+    unsigned long state_revision;
+    mutable LazyOutput<base::Vector6d> twist_output;
+    mutable LazyOutput<base::Matrix6d> twist_cov_output;
+
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
 
+/* The non-template members of the filter for the VelocityState are instantiated once in VelocityUKF.cpp.
+ * The member templates predict and update are instantiated implicitly with the models bound in
+ * VelocityUKF.cpp, which is the only translation unit calling them */
+extern template class SigmaPointFilter<VelocityUKF::WState>;
+
 }
\ No newline at end of file
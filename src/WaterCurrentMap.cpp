@@ -0,0 +1,121 @@
+#include "WaterCurrentMap.hpp"
+#include <cmath>
+#include <stdexcept>
+
+using namespace uwv_kalman_filters;
+
+WaterCurrentMap::WaterCurrentMap(double horizontal_resolution, double layer_thickness, double first_cell_blank, std::size_t max_cells) :
+    horizontal_resolution(horizontal_resolution), layer_thickness(layer_thickness), first_cell_blank(first_cell_blank),
+    used_cells(0), front(-1), back(-1)
+{
+    if(!(horizontal_resolution > 0.) || !(layer_thickness > 0.) || max_cells == 0)
+        throw std::invalid_argument("Water current map requires a positive resolution and size");
+    if(!(first_cell_blank >= 0.))
+        throw std::invalid_argument("Water current map requires a non-negative first cell blank");
+
+    entries.resize(max_cells);
+    std::size_t bucket_count = 1;
+    while(bucket_count < max_cells)
+        bucket_count *= 2;
+    buckets.assign(bucket_count, -1);
+}
+
+WaterCurrentMap::Key WaterCurrentMap::getKey(const Eigen::Vector3d& position) const
+{
+    Key key;
+    key.x = int(std::floor(position.x() / horizontal_resolution));
+    key.y = int(std::floor(position.y() / horizontal_resolution));
+    key.layer = int(std::floor((first_cell_blank - position.z()) / layer_thickness));
+    return key;
+}
+
+const WaterCurrentCell* WaterCurrentMap::find(const Key& key)
+{
+    const int entry = findEntry(key);
+    if(entry < 0)
+        return NULL;
+    touch(entry);
+    return &entries[entry].cell;
+}
+
+void WaterCurrentMap::store(const Key& key, const WaterCurrentCell& cell)
+{
+    int entry = findEntry(key);
+    if(entry < 0)
+    {
+        if(used_cells < entries.size())
+            entry = int(used_cells++);
+        else
+        {
+            // the least recently used cell is replaced
+            entry = back;
+            unlinkBucket(entry);
+            unlink(entry);
+        }
+        Entry& e = entries[entry];
+        e.key = key;
+        e.previous = -1;
+        e.next = -1;
+        const std::size_t index = bucket(key);
+        e.bucket_next = buckets[index];
+        buckets[index] = entry;
+    }
+    touch(entry);
+    entries[entry].cell = cell;
+}
+
+void WaterCurrentMap::clear()
+{
+    buckets.assign(buckets.size(), -1);
+    used_cells = 0;
+    front = -1;
+    back = -1;
+}
+
+int WaterCurrentMap::findEntry(const Key& key) const
+{
+    for(int entry = buckets[bucket(key)]; entry >= 0; entry = entries[entry].bucket_next)
+    {
+        if(entries[entry].key == key)
+            return entry;
+    }
+    return -1;
+}
+
+void WaterCurrentMap::touch(int entry)
+{
+    if(entry == front)
+        return;
+    if(entries[entry].previous >= 0 || entries[entry].next >= 0 || entry == back)
+        unlink(entry);
+    entries[entry].previous = -1;
+    entries[entry].next = front;
+    if(front >= 0)
+        entries[front].previous = entry;
+    front = entry;
+    if(back < 0)
+        back = entry;
+}
+
+void WaterCurrentMap::unlink(int entry)
+{
+    Entry& e = entries[entry];
+    if(e.previous >= 0)
+        entries[e.previous].next = e.next;
+    else
+        front = e.next;
+    if(e.next >= 0)
+        entries[e.next].previous = e.previous;
+    else
+        back = e.previous;
+    e.previous = -1;
+    e.next = -1;
+}
+
+void WaterCurrentMap::unlinkBucket(int entry)
+{
+    int* link = &buckets[bucket(entries[entry].key)];
+    while(*link != entry)
+        link = &entries[*link].bucket_next;
+    *link = entries[entry].bucket_next;
+}
@@ -0,0 +1,101 @@
+#ifndef _UWV_KALMAN_FILTERS_WATER_CURRENT_MAP_HPP_
+#define _UWV_KALMAN_FILTERS_WATER_CURRENT_MAP_HPP_
+
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace uwv_kalman_filters
+{
+
+/* Water current estimate of a map cell, the current at the vehicle and below it in the North/East directions */
+struct WaterCurrentCell
+{
+    Eigen::Vector2d water_velocity;
+    Eigen::Vector2d water_velocity_below;
+    /* Joint covariance of water_velocity and water_velocity_below */
+    Eigen::Matrix4d cov;
+    /* Filter time in seconds the estimate was stored at */
+    double time;
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+/**
+ * Spatial map of water current estimates.
+ *
+ * The map is a sparse grid of cells with a horizontal resolution in meters and layers
+ * with the thickness of an ADCP cell. Cells are hashed by their integer coordinates,
+ * lookup and storage are O(1). The number of cells is bounded, if the map is full the
+ * least recently used cell is dropped. All cells are allocated at construction,
+ * lookup and storage don't allocate memory.
+ */
+class WaterCurrentMap
+{
+public:
+    struct Key
+    {
+        int x;
+        int y;
+        int layer;
+        bool operator==(const Key& other) const { return x == other.x && y == other.y && layer == other.layer; }
+        bool operator!=(const Key& other) const { return !(*this == other); }
+    };
+
+    /* horizontal_resolution and layer_thickness in meters, usually WaterVelocityParameters::cell_size.
+     * first_cell_blank is the distance of the first ADCP cell below the vehicle, WaterVelocityParameters::first_cell_blank */
+    WaterCurrentMap(double horizontal_resolution, double layer_thickness, double first_cell_blank = 0.,
+                    std::size_t max_cells = 10000);
+
+    /* Cell of a position in the navigation frame. The layer is the one of the first ADCP cell below the
+     * position, the layers start at z = 0 and extend downwards */
+    Key getKey(const Eigen::Vector3d& position) const;
+
+    /* Returns the cell or NULL if it was not stored yet, the cell is marked as recently used */
+    const WaterCurrentCell* find(const Key& key);
+
+    /* Stores or replaces the estimate of a cell */
+    void store(const Key& key, const WaterCurrentCell& cell);
+
+    std::size_t size() const { return used_cells; }
+    std::size_t getMaxCells() const { return entries.size(); }
+    void clear();
+
+private:
+    /* Cell of the pool, linked into the recently used list and the chain of its hash bucket */
+    struct Entry
+    {
+        Key key;
+        WaterCurrentCell cell;
+        int previous;
+        int next;
+        int bucket_next;
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+    std::size_t bucket(const Key& key) const
+    {
+        return ((std::size_t(unsigned(key.x)) * 73856093u) ^ (std::size_t(unsigned(key.y)) * 19349663u) ^
+                (std::size_t(unsigned(key.layer)) * 83492791u)) & (buckets.size() - 1);
+    }
+
+    int findEntry(const Key& key) const;
+    /* Moves the entry to the front of the recently used list */
+    void touch(int entry);
+    void unlink(int entry);
+    void unlinkBucket(int entry);
+
+    double horizontal_resolution;
+    double layer_thickness;
+    double first_cell_blank;
+    std::vector< Entry, Eigen::aligned_allocator<Entry> > entries;
+    /* First entry of each hash bucket, the count is a power of two */
+    std::vector<int> buckets;
+    std::size_t used_cells;
+    /* Most and least recently used entry */
+    int front;
+    int back;
+};
+
+}
+
+#endif
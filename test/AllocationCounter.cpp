@@ -0,0 +1,92 @@
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <new>
+
+static std::atomic<std::size_t> allocation_counter(0);
+
+std::size_t uwv_kalman_filters::test::allocationCount()
+{
+    return allocation_counter.load(std::memory_order_relaxed);
+}
+
+#if defined(UWV_KALMAN_FILTERS_SANITIZER_ALLOCATION_HOOKS)
+
+/* The sanitizers replace malloc themselves, their runtime reports every allocation to the hook */
+extern "C" int __sanitizer_install_malloc_and_free_hooks(void (*malloc_hook)(const volatile void*, std::size_t),
+                                                         void (*free_hook)(const volatile void*));
+
+static void countAllocation(const volatile void*, std::size_t)
+{
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void ignoreFree(const volatile void*)
+{
+}
+
+static struct AllocationHooks
+{
+    AllocationHooks() { __sanitizer_install_malloc_and_free_hooks(countAllocation, ignoreFree); }
+} allocation_hooks;
+
+#elif defined(__GLIBC__)
+
+/* The replaced allocation functions forward to glibc, operator new ends up in malloc as well */
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t count, std::size_t size);
+extern "C" void* __libc_realloc(void* p, std::size_t size);
+
+extern "C" void* malloc(std::size_t size) noexcept
+{
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size) noexcept
+{
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* p, std::size_t size) noexcept
+{
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+#else
+
+void* operator new(std::size_t size)
+{
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#endif
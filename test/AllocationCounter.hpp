@@ -0,0 +1,44 @@
+#ifndef _UWV_KALMAN_FILTERS_ALLOCATION_COUNTER_HPP_
+#define _UWV_KALMAN_FILTERS_ALLOCATION_COUNTER_HPP_
+
+#include <cstddef>
+#include <cstdlib>
+
+/* The allocations are counted at the level of malloc if the sanitizer runtime provides allocation
+ * hooks or the C library is glibc, which also covers the Eigen types and the MTK/ukfom temporaries.
+ * Otherwise only the replaced global operator new is counted */
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define UWV_KALMAN_FILTERS_SANITIZER_ALLOCATION_HOOKS
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define UWV_KALMAN_FILTERS_SANITIZER_ALLOCATION_HOOKS
+#endif
+#endif
+
+#if defined(UWV_KALMAN_FILTERS_SANITIZER_ALLOCATION_HOOKS) || defined(__GLIBC__)
+#define UWV_KALMAN_FILTERS_COUNTS_MALLOC
+#endif
+
+namespace uwv_kalman_filters
+{
+namespace test
+{
+
+/* Number of heap allocations since program start, see UWV_KALMAN_FILTERS_COUNTS_MALLOC.
+ * The counter is shared by all threads */
+std::size_t allocationCount();
+
+/* Counts the heap allocations of the enclosing scope */
+class AllocationCounter
+{
+public:
+    AllocationCounter() : start(allocationCount()) {}
+    std::size_t count() const { return allocationCount() - start; }
+private:
+    std::size_t start;
+};
+
+}
+}
+
+#endif
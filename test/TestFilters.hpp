@@ -0,0 +1,108 @@
+#ifndef _UWV_KALMAN_FILTERS_TEST_FILTERS_HPP_
+#define _UWV_KALMAN_FILTERS_TEST_FILTERS_HPP_
+
+#include <uwv_kalman_filters/PoseUKF.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace uwv_kalman_filters
+{
+namespace test
+{
+
+/* Motion model parameters of a medium sized AUV */
+inline uwv_dynamic_model::UWVParameters vehicleParameters()
+{
+    uwv_dynamic_model::UWVParameters parameters;
+    base::Vector6d inertia;
+    inertia << 120., 160., 160., 15., 25., 25.;
+    parameters.inertia_matrix = inertia.asDiagonal();
+    parameters.damping_matrices.resize(2);
+    base::Vector6d lin_damping;
+    lin_damping << 20., 30., 30., 5., 8., 8.;
+    parameters.damping_matrices[0] = lin_damping.asDiagonal();
+    base::Vector6d quad_damping;
+    quad_damping << 60., 90., 90., 10., 15., 15.;
+    parameters.damping_matrices[1] = quad_damping.asDiagonal();
+    return parameters;
+}
+
+inline LocationConfiguration testLocation()
+{
+    LocationConfiguration location;
+    location.latitude = 0.9325;
+    location.longitude = 0.1552;
+    location.altitude = 0.;
+    return location;
+}
+
+/* PoseUKF of a vehicle moving with 1 m/s, the noise parameters are those of a typical mission */
+inline boost::shared_ptr<PoseUKF> createPoseUKF(FilterBackend backend = STANDARD_UKF, unsigned sigma_point_threads = 1)
+{
+    uwv_dynamic_model::UWVParameters model_parameters = vehicleParameters();
+
+    PoseUKF::State state;
+    state.velocity = Eigen::Vector3d(1., 0.1, 0.);
+    state.gravity(0) = 9.81;
+    state.inertia << model_parameters.inertia_matrix.block<2,2>(0,0), model_parameters.inertia_matrix.block<2,1>(0,5);
+    state.lin_damping << model_parameters.damping_matrices[0].block<2,2>(0,0), model_parameters.damping_matrices[0].block<2,1>(0,5);
+    state.quad_damping << model_parameters.damping_matrices[1].block<2,2>(0,0), model_parameters.damping_matrices[1].block<2,1>(0,5);
+
+    PoseUKF::Covariance state_cov = PoseUKF::Covariance::Zero();
+    MTK::setDiagonal(state_cov, &PoseUKF::State::position, 1.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::orientation, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::acceleration, 1e-1);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_gyro, 1e-8);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_acc, 1e-4);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::gravity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::inertia, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::lin_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::quad_damping, 10.);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::water_velocity_below, 1e-2);
+    MTK::setDiagonal(state_cov, &PoseUKF::State::bias_adcp, 1e-3);
+
+    PoseUKF::PoseUKFParameter filter_parameter;
+    filter_parameter.imu_in_body = Eigen::Vector3d(0.1, 0., 0.05);
+    filter_parameter.gyro_bias_tau = 3600.;
+    filter_parameter.acc_bias_tau = 3600.;
+    filter_parameter.inertia_tau = 3600.;
+    filter_parameter.lin_damping_tau = 3600.;
+    filter_parameter.quad_damping_tau = 3600.;
+    filter_parameter.water_velocity_tau = 900.;
+    filter_parameter.water_velocity_limits = 0.5;
+    filter_parameter.water_velocity_scale = 0.001;
+    filter_parameter.adcp_bias_tau = 3600.;
+
+    boost::shared_ptr<PoseUKF> filter(new PoseUKF(state, state_cov, testLocation(), model_parameters, filter_parameter,
+                                                    sigma_point_threads));
+    filter->setFilterBackend(backend);
+
+    PoseUKF::Covariance process_noise = PoseUKF::Covariance::Zero();
+    MTK::setDiagonal(process_noise, &PoseUKF::State::position, 1e-4);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::orientation, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::velocity, 1e-4);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::acceleration, 1e-2);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_gyro, 1e-12);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_acc, 1e-8);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::gravity, 1e-8);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::inertia, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::lin_damping, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::quad_damping, 1e-3);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::water_velocity, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::water_velocity_below, 1e-6);
+    MTK::setDiagonal(process_noise, &PoseUKF::State::bias_adcp, 1e-8);
+    filter->setProcessNoiseCovariance(process_noise);
+
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu = Eigen::Vector3d(0., 0., 0.05);
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    filter->integrateMeasurement(rotation_rate);
+
+    return filter;
+}
+
+}
+}
+
+#endif
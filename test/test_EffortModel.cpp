@@ -0,0 +1,87 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/EffortModel.hpp>
+#include "TestFilters.hpp"
+
+using namespace uwv_kalman_filters;
+
+static EffortModel::ParameterBlock parameterBlock(const base::Matrix6d& matrix)
+{
+    EffortModel::ParameterBlock block;
+    block << matrix.block<2,2>(0,0), matrix.block<2,1>(0,5);
+    return block;
+}
+
+struct EffortInputs
+{
+    EffortModel::ParameterBlock inertia;
+    EffortModel::ParameterBlock lin_damping;
+    EffortModel::ParameterBlock quad_damping;
+    base::Vector6d acceleration;
+    base::Orientation orientation;
+    base::Vector6d velocities[3];
+
+    EffortInputs()
+    {
+        const uwv_dynamic_model::UWVParameters parameters = test::vehicleParameters();
+        inertia = parameterBlock(parameters.inertia_matrix);
+        lin_damping = parameterBlock(parameters.damping_matrices[0]);
+        quad_damping = parameterBlock(parameters.damping_matrices[1]);
+        acceleration << 0.05, -0.01, 0.02, 0., 0.01, 0.03;
+        orientation = base::Orientation(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()) *
+                                        Eigen::AngleAxisd(0.05, Eigen::Vector3d::UnitY()));
+        velocities[0] << 1., 0.1, 0., 0., 0., 0.05;
+        velocities[1] << -0.3, 0.4, 0.1, 0.02, -0.01, -0.2;
+        velocities[2] << 1.8, -0.2, 0.3, 0., 0.04, 0.1;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(effort_context_matches_the_effort_model)
+{
+    const EffortInputs inputs;
+    EffortModel direct_model(test::vehicleParameters());
+    EffortModel context_model(test::vehicleParameters());
+    EffortContext context;
+    context.setTolerance(0.);
+    context.update(context_model, inputs.inertia, inputs.lin_damping, inputs.quad_damping, inputs.acceleration, inputs.orientation);
+
+    for(unsigned i = 0; i < 3; i++)
+    {
+        const base::Vector6d expected = direct_model.calcEfforts(inputs.inertia, inputs.lin_damping, inputs.quad_damping,
+                                                                 inputs.acceleration, inputs.velocities[i], inputs.orientation);
+        const base::Vector6d efforts = context.calcEfforts(context_model, inputs.velocities[i]);
+        BOOST_CHECK_SMALL((efforts - expected).norm(), 1e-9 * (1. + expected.norm()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(effort_context_reassembles_beyond_its_tolerance)
+{
+    const EffortInputs inputs;
+    const double tolerance = 1e-3;
+    EffortModel direct_model(test::vehicleParameters());
+    EffortModel context_model(test::vehicleParameters());
+    EffortContext context;
+    context.setTolerance(tolerance);
+    context.update(context_model, inputs.inertia, inputs.lin_damping, inputs.quad_damping, inputs.acceleration, inputs.orientation);
+
+    // within the tolerance the context is kept, the efforts deviate at most by the relative parameter change
+    EffortModel::ParameterBlock lin_damping = inputs.lin_damping * (1. + 0.5 * tolerance);
+    context.update(context_model, inputs.inertia, lin_damping, inputs.quad_damping, inputs.acceleration, inputs.orientation);
+    for(unsigned i = 0; i < 3; i++)
+    {
+        const base::Vector6d expected = direct_model.calcEfforts(inputs.inertia, lin_damping, inputs.quad_damping,
+                                                                 inputs.acceleration, inputs.velocities[i], inputs.orientation);
+        const base::Vector6d efforts = context.calcEfforts(context_model, inputs.velocities[i]);
+        BOOST_CHECK_SMALL((efforts - expected).norm(), tolerance * (1. + expected.norm()));
+    }
+
+    // beyond the tolerance it is assembled again and matches the effort model
+    lin_damping = inputs.lin_damping * (1. + 10. * tolerance);
+    context.update(context_model, inputs.inertia, lin_damping, inputs.quad_damping, inputs.acceleration, inputs.orientation);
+    for(unsigned i = 0; i < 3; i++)
+    {
+        const base::Vector6d expected = direct_model.calcEfforts(inputs.inertia, lin_damping, inputs.quad_damping,
+                                                                 inputs.acceleration, inputs.velocities[i], inputs.orientation);
+        const base::Vector6d efforts = context.calcEfforts(context_model, inputs.velocities[i]);
+        BOOST_CHECK_SMALL((efforts - expected).norm(), 1e-9 * (1. + expected.norm()));
+    }
+}
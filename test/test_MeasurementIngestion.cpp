@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/MeasurementIngestion.hpp>
+#include "TestFilters.hpp"
+#include <thread>
+
+using namespace uwv_kalman_filters;
+
+struct IngestionMeasurements
+{
+    PoseUKF::Velocity velocity;
+    PoseUKF::Z_Position z_position;
+
+    IngestionMeasurements()
+    {
+        velocity.mu << 1., 0.1, 0.;
+        velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+        z_position.mu << 0.;
+        z_position.cov << 0.01;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(ingestion_merges_the_queues_by_time_stamp)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    MeasurementIngestion ingestion(*filter, base::Time::fromSeconds(1.));
+    const IngestionMeasurements m;
+
+    // the older depth is merged first although it was pushed last, otherwise it would be late
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.2), m.velocity));
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.1), m.z_position));
+    BOOST_CHECK_EQUAL(ingestion.process(), 2u);
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1200000);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_VELOCITY).integrated, 1u);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_Z_POSITION).integrated, 1u);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_Z_POSITION).queue_latency.count, 1u);
+
+    // records older than the filter time are dropped
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.15), m.z_position));
+    BOOST_CHECK_EQUAL(ingestion.process(), 1u);
+    const IngestionQueueStatistics statistics = ingestion.getStatistics(LOG_Z_POSITION);
+    BOOST_CHECK_EQUAL(statistics.pushed, 2u);
+    BOOST_CHECK_EQUAL(statistics.integrated, 1u);
+    BOOST_CHECK_EQUAL(statistics.dropped_late, 1u);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_VELOCITY).integrated, 1u);
+
+    // records of an unknown dimension or type aren't integrated
+    MissionLogRecord reference;
+    reference.setMeasurement(LOG_REFERENCE_POSITION, base::Time::fromSeconds(1.3).toMicroseconds(),
+                             Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity());
+    BOOST_CHECK(ingestion.push(reference));
+    BOOST_CHECK_EQUAL(ingestion.process(true), 1u);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_REFERENCE_POSITION).invalid, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(ingestion_waits_for_the_reorder_window)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    MeasurementIngestion ingestion(*filter, base::Time::fromSeconds(1.), 0.5);
+    const IngestionMeasurements m;
+
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.1), m.velocity));
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.4), m.velocity));
+    BOOST_CHECK_EQUAL(ingestion.process(), 0u);
+
+    // the depth is older than the watermark of the newest velocity, the later velocity isn't
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.2), m.z_position));
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.8), m.velocity));
+    BOOST_CHECK_EQUAL(ingestion.process(), 2u);
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1200000);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_Z_POSITION).dropped_late, 0u);
+
+    BOOST_CHECK_EQUAL(ingestion.process(true), 2u);
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1800000);
+    BOOST_CHECK_EQUAL(ingestion.getStatistics(LOG_VELOCITY).integrated, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(ingestion_drops_the_newest_record_of_a_full_queue)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    MeasurementIngestion ingestion(*filter, base::Time::fromSeconds(1.));
+    IngestionQueueParameters parameters;
+    parameters.capacity = 2;
+    parameters.overflow_policy = DROP_NEWEST;
+    ingestion.setQueueParameters(LOG_VELOCITY, parameters);
+    const IngestionMeasurements m;
+
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.1), m.velocity));
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.2), m.velocity));
+    BOOST_CHECK(!ingestion.push(base::Time::fromSeconds(1.3), m.velocity));
+    BOOST_CHECK_EQUAL(ingestion.process(true), 2u);
+
+    const IngestionQueueStatistics statistics = ingestion.getStatistics(LOG_VELOCITY);
+    BOOST_CHECK_EQUAL(statistics.pushed, 2u);
+    BOOST_CHECK_EQUAL(statistics.dropped_overflow, 1u);
+    BOOST_CHECK_EQUAL(statistics.max_depth, 2u);
+    BOOST_CHECK_EQUAL(statistics.integrated, 2u);
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1200000);
+}
+
+BOOST_AUTO_TEST_CASE(ingestion_drops_stale_records)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    MeasurementIngestion ingestion(*filter, base::Time::fromSeconds(1.));
+    IngestionQueueParameters parameters;
+    parameters.max_queue_latency = 1e-3;
+    ingestion.setQueueParameters(LOG_VELOCITY, parameters);
+    const IngestionMeasurements m;
+
+    BOOST_CHECK(ingestion.push(base::Time::fromSeconds(1.1), m.velocity));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    BOOST_CHECK_EQUAL(ingestion.process(true), 1u);
+
+    const IngestionQueueStatistics statistics = ingestion.getStatistics(LOG_VELOCITY);
+    BOOST_CHECK_EQUAL(statistics.dropped_stale, 1u);
+    BOOST_CHECK_EQUAL(statistics.integrated, 0u);
+    // the filter isn't predicted to a dropped record
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1000000);
+}
+
+BOOST_AUTO_TEST_CASE(ingestion_blocks_the_producer_of_a_full_queue)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    MeasurementIngestion ingestion(*filter, base::Time::fromSeconds(1.));
+    IngestionQueueParameters parameters;
+    parameters.capacity = 4;
+    parameters.overflow_policy = BLOCK_PRODUCER;
+    ingestion.setQueueParameters(LOG_VELOCITY, parameters);
+    ingestion.setQueueParameters(LOG_Z_POSITION, parameters);
+    const IngestionMeasurements m;
+    const unsigned records = 200;
+
+    // two sensor threads produce while the estimation thread consumes, no record may be lost
+    ingestion.start();
+    std::thread velocity_producer([&]()
+    {
+        for(unsigned i = 0; i < records; i++)
+            ingestion.push(base::Time::fromSeconds(1. + 0.01 * i), m.velocity);
+    });
+    std::thread depth_producer([&]()
+    {
+        for(unsigned i = 0; i < records; i++)
+            ingestion.push(base::Time::fromSeconds(1.005 + 0.01 * i), m.z_position);
+    });
+    velocity_producer.join();
+    depth_producer.join();
+    ingestion.stop();
+    ingestion.process(true);
+
+    const IngestionQueueStatistics velocity = ingestion.getStatistics(LOG_VELOCITY);
+    const IngestionQueueStatistics depth = ingestion.getStatistics(LOG_Z_POSITION);
+    BOOST_CHECK_EQUAL(velocity.pushed, records);
+    BOOST_CHECK_EQUAL(depth.pushed, records);
+    BOOST_CHECK_EQUAL(velocity.dropped_overflow + depth.dropped_overflow, 0u);
+    BOOST_CHECK(velocity.max_depth <= 4u);
+    // without a reorder window a record can arrive after a newer one of the other sensor was merged
+    BOOST_CHECK_EQUAL(velocity.integrated + velocity.dropped_late, records);
+    BOOST_CHECK_EQUAL(depth.integrated + depth.dropped_late, records);
+    // the newest record can't be late, the filter ends at its time
+    BOOST_CHECK_EQUAL(ingestion.getTime().toMicroseconds(), 1005000 + 10000 * (records - 1));
+}
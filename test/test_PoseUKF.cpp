@@ -0,0 +1,443 @@
+#include <boost/test/unit_test.hpp>
+#include "TestFilters.hpp"
+#include "AllocationCounter.hpp"
+
+using namespace uwv_kalman_filters;
+
+#ifdef UWV_KALMAN_FILTERS_COUNTS_MALLOC
+static std::size_t predictionAllocations(PoseUKF& filter)
+{
+    // the first steps allocate the buffers and the cached factors
+    for(unsigned i = 0; i < 10; i++)
+        filter.predictionStep(0.01);
+
+    test::AllocationCounter counter;
+    for(unsigned i = 0; i < 10; i++)
+        filter.predictionStep(0.01);
+    return counter.count();
+}
+
+BOOST_AUTO_TEST_CASE(prediction_step_does_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(square_root_prediction_step_does_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF(SQUARE_ROOT_UKF);
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(structured_prediction_step_does_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    filter->setStructuredPrediction(true);
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(merged_prediction_steps_do_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    filter->setFullPredictionPeriod(0.05);
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(single_precision_prediction_step_does_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    filter->setPropagationPrecision(PoseUKF::SINGLE_PRECISION);
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(water_current_map_prediction_step_does_not_allocate)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    // the vehicle enters another cell with every step, the full map drops its oldest cells
+    boost::shared_ptr<WaterCurrentMap> map(new WaterCurrentMap(0.005, 1., 0., 4));
+    filter->setWaterCurrentMap(map);
+    BOOST_CHECK_EQUAL(predictionAllocations(*filter), 0u);
+    BOOST_CHECK_EQUAL(map->size(), 4u);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(water_current_map_drops_the_least_recently_used_cell)
+{
+    WaterCurrentMap map(1., 1., 0.5, 2);
+    WaterCurrentMap::Key keys[3];
+    for(int i = 0; i < 3; i++)
+        keys[i] = map.getKey(Eigen::Vector3d(i, 0., -2.));
+    BOOST_CHECK_EQUAL(keys[0].layer, 2);
+
+    WaterCurrentCell cell;
+    cell.water_velocity.setZero();
+    cell.water_velocity_below.setZero();
+    cell.cov.setIdentity();
+    for(int i = 0; i < 2; i++)
+    {
+        cell.time = i;
+        map.store(keys[i], cell);
+    }
+    // the first cell becomes the most recently used one, storing a third cell drops the second
+    BOOST_REQUIRE(map.find(keys[0]));
+    cell.time = 2.;
+    map.store(keys[2], cell);
+    BOOST_CHECK_EQUAL(map.size(), 2u);
+    BOOST_REQUIRE(map.find(keys[0]));
+    BOOST_CHECK_EQUAL(map.find(keys[0])->time, 0.);
+    BOOST_CHECK(!map.find(keys[1]));
+    BOOST_REQUIRE(map.find(keys[2]));
+    BOOST_CHECK_EQUAL(map.find(keys[2])->time, 2.);
+}
+
+BOOST_AUTO_TEST_CASE(revisited_water_current_cell_decays_with_its_age)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    boost::shared_ptr<WaterCurrentMap> map(new WaterCurrentMap(0.5, 1.));
+    filter->setWaterCurrentMap(map);
+    const WaterCurrentMap::Key first_cell = map->getKey(Eigen::Vector3d::Zero());
+
+    // leave the first cell, then return to it with a position fix
+    unsigned steps = 0;
+    for(; steps < 60; steps++)
+        filter->predictionStep(0.01);
+    BOOST_REQUIRE(map->find(first_cell));
+    const WaterCurrentCell stored = *map->find(first_cell);
+    BOOST_CHECK(stored.time > 0.);
+
+    PoseUKF::XY_Position xy_position;
+    xy_position.mu.setZero();
+    xy_position.cov = Eigen::Matrix2d::Identity() * 1e-6;
+    filter->integrateMeasurement(xy_position);
+    filter->predictionStep(0.01);
+    steps++;
+
+    const double decay = std::exp(-(steps * 0.01 - stored.time) / 900.);
+    const Eigen::Matrix4d expected_cov = decay * decay * stored.cov + (1. - decay * decay) * 0.25 * Eigen::Matrix4d::Identity();
+    PoseUKF::State state;
+    PoseUKF::Covariance cov;
+    filter->getCurrentState(state, cov);
+    BOOST_CHECK_SMALL((Eigen::Vector2d(state.water_velocity) - decay * stored.water_velocity).norm(), 1e-12);
+    BOOST_CHECK_SMALL((MTK::subblock(cov, &PoseUKF::State::water_velocity) - expected_cov.topLeftCorner<2,2>()).cwiseAbs().maxCoeff(), 1e-12);
+    BOOST_CHECK_SMALL((MTK::subblock(cov, &PoseUKF::State::water_velocity_below) - expected_cov.bottomRightCorner<2,2>()).cwiseAbs().maxCoeff(), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(effort_update_scheduling_counts_skipped_updates)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    filter->setDynamicModelMinDepth(2.);
+    EffortUpdateSchedulingParameters parameters;
+    parameters.velocity_timeout = 1.;
+    parameters.max_velocity_std = 1.;
+    parameters.decimation = 5;
+    filter->enableEffortUpdateScheduling(parameters);
+
+    PoseUKF::Z_Position z_position;
+    PoseUKF::Velocity velocity;
+    velocity.mu << 1., 0.1, 0.;
+    velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    PoseUKF::BodyEffortsMeasurement efforts;
+    efforts.mu << 20., 0., 0., 0., 0., 1.;
+    efforts.cov = base::Matrix6d::Identity();
+    const PoseUKF::EffortUpdateStatistics& statistics = filter->getEffortUpdateStatistics();
+
+    // at the surface all updates are skipped
+    z_position.mu << 0.;
+    z_position.cov << 1.;
+    for(unsigned i = 0; i < 50; i++)
+    {
+        filter->predictionStep(0.01);
+        filter->integrateMeasurement(z_position);
+        filter->integrateMeasurement(velocity);
+        filter->integrateMeasurement(efforts);
+    }
+    BOOST_CHECK_EQUAL(statistics.applied, 0u);
+    BOOST_CHECK_EQUAL(statistics.skipped_surface, 50u);
+    BOOST_CHECK_EQUAL(statistics.skipped_decimated, 0u);
+
+    // with bottom lock and a tight velocity every 5th update is applied
+    z_position.mu << -10.;
+    z_position.cov << 1e-4;
+    for(unsigned i = 0; i < 50; i++)
+    {
+        filter->predictionStep(0.01);
+        filter->integrateMeasurement(z_position);
+        filter->integrateMeasurement(velocity);
+        filter->integrateMeasurement(efforts);
+    }
+    BOOST_CHECK_EQUAL(statistics.applied, 10u);
+    BOOST_CHECK_EQUAL(statistics.skipped_surface, 50u);
+    BOOST_CHECK_EQUAL(statistics.skipped_decimated, 40u);
+
+    // once the velocity timed out every update is applied
+    for(unsigned i = 0; i < 150; i++)
+    {
+        filter->predictionStep(0.01);
+        filter->integrateMeasurement(z_position);
+        filter->integrateMeasurement(efforts);
+    }
+    const PoseUKF::EffortUpdateStatistics dropout = statistics;
+    BOOST_CHECK_EQUAL(dropout.applied + dropout.skipped_decimated, 50u + 150u);
+    for(unsigned i = 0; i < 50; i++)
+    {
+        filter->predictionStep(0.01);
+        filter->integrateMeasurement(z_position);
+        filter->integrateMeasurement(efforts);
+    }
+    BOOST_CHECK_EQUAL(statistics.applied, dropout.applied + 50u);
+    BOOST_CHECK_EQUAL(statistics.skipped_decimated, dropout.skipped_decimated);
+    BOOST_CHECK_EQUAL(statistics.skipped_surface, 50u);
+}
+
+BOOST_AUTO_TEST_CASE(rejected_batch_velocity_keeps_the_bottom_lock_lost)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    InnovationGateParameters gates;
+    gates.velocity = 0.95;
+    filter->setInnovationGates(gates);
+    EffortUpdateSchedulingParameters parameters;
+    parameters.max_velocity_std = 1.;
+    parameters.decimation = 0;
+    filter->enableEffortUpdateScheduling(parameters);
+
+    PoseUKF::Velocity outlier;
+    outlier.mu << 50., 0., 0.;
+    outlier.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    PoseUKF::BodyEffortsMeasurement efforts;
+    efforts.mu << 20., 0., 0., 0., 0., 1.;
+    efforts.cov = base::Matrix6d::Identity();
+
+    // without any accepted velocity there is no bottom lock and the updates are applied
+    filter->predictionStep(0.01);
+    filter->beginUpdate();
+    filter->integrateMeasurement(outlier);
+    filter->integrateMeasurement(efforts);
+    filter->commitUpdate();
+    BOOST_CHECK_EQUAL(filter->getEffortUpdateStatistics().applied, 1u);
+    BOOST_CHECK_EQUAL(filter->getEffortUpdateStatistics().skipped_decimated, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(merged_prediction_steps_add_the_noise_of_each_step)
+{
+    boost::shared_ptr<PoseUKF> single = test::createPoseUKF();
+    boost::shared_ptr<PoseUKF> merged = test::createPoseUKF();
+    merged->setFullPredictionPeriod(0.1);
+    PoseUKF::Covariance prior;
+    PoseUKF::State state;
+    single->getCurrentState(state, prior);
+
+    for(unsigned i = 0; i < 10; i++)
+    {
+        single->predictionStep(0.01);
+        merged->predictionStep(0.01);
+    }
+    merged->flushPrediction();
+    BOOST_CHECK_EQUAL(single->getFullPredictionCount(), 10u);
+    BOOST_CHECK_EQUAL(merged->getFullPredictionCount(), 1u);
+
+    // the gravity is a random walk, its variance only grows by the process noise
+    PoseUKF::Covariance single_cov, merged_cov;
+    single->getCurrentState(state, single_cov);
+    merged->getCurrentState(state, merged_cov);
+    const double single_growth = MTK::subblock(single_cov, &PoseUKF::State::gravity)(0, 0) - MTK::subblock(prior, &PoseUKF::State::gravity)(0, 0);
+    const double merged_growth = MTK::subblock(merged_cov, &PoseUKF::State::gravity)(0, 0) - MTK::subblock(prior, &PoseUKF::State::gravity)(0, 0);
+    BOOST_CHECK_CLOSE(single_growth, 10 * 0.01 * 0.01 * 1e-8, 1e-2);
+    BOOST_CHECK_CLOSE(merged_growth, single_growth, 1e-2);
+}
+
+#ifdef UWV_KALMAN_FILTERS_INSTRUMENTATION
+BOOST_AUTO_TEST_CASE(nested_calls_attribute_the_innovation_to_the_innermost_call)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    filter->setFullPredictionPeriod(0.045);
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu << 0., 0., 0.05;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    PoseUKF::Acceleration acceleration;
+    acceleration.mu << 0., 0., 9.81;
+    acceleration.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    PoseUKF::Velocity velocity;
+    velocity.mu << 1., 0.1, 0.;
+    velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+
+    // the pre-integrated acceleration is integrated by the full prediction of the prediction step
+    for(unsigned i = 0; i < 5; i++)
+    {
+        filter->preintegrateImuSample(rotation_rate, acceleration, 0.01);
+        filter->predictionStep(0.01);
+    }
+    // the velocity update completes the pending prediction first
+    filter->predictionStep(0.01);
+    filter->integrateMeasurement(velocity);
+
+    const FilterStatistics statistics = filter->getStatistics();
+    BOOST_CHECK(statistics.enabled);
+    BOOST_CHECK_EQUAL(statistics.channels[PoseUKF::ACCELERATION_CHANNEL].innovations, 1u);
+    BOOST_CHECK_EQUAL(statistics.channels[PoseUKF::VELOCITY_CHANNEL].innovations, 1u);
+    BOOST_CHECK_EQUAL(statistics.channels[PoseUKF::FULL_PREDICTION_CHANNEL].calls, 2u);
+    BOOST_CHECK_EQUAL(statistics.channels[PoseUKF::FULL_PREDICTION_CHANNEL].innovations, 0u);
+    BOOST_CHECK_EQUAL(statistics.channels[PoseUKF::PREDICTION_CHANNEL].innovations, 0u);
+}
+#endif
+
+static void checkSameEstimate(PoseUKF& filter, PoseUKF& reference, double tolerance)
+{
+    PoseUKF::State state, reference_state;
+    PoseUKF::Covariance cov, reference_cov;
+    filter.getCurrentState(state, cov);
+    reference.getCurrentState(reference_state, reference_cov);
+    BOOST_CHECK_SMALL((PoseUKF::WState(state) - PoseUKF::WState(reference_state)).cwiseAbs().maxCoeff(), tolerance);
+    BOOST_CHECK_SMALL((cov - reference_cov).cwiseAbs().maxCoeff(), tolerance);
+}
+
+BOOST_AUTO_TEST_CASE(sigma_point_threads_give_bit_identical_estimates)
+{
+    boost::shared_ptr<PoseUKF> serial = test::createPoseUKF(STANDARD_UKF, 1);
+    boost::shared_ptr<PoseUKF> parallel = test::createPoseUKF(STANDARD_UKF, 4);
+    PoseUKF::BodyEffortsMeasurement efforts;
+    efforts.mu << 20., 0., 0., 0., 0., 1.;
+    efforts.cov = base::Matrix6d::Identity();
+    PoseUKF::WaterVelocityMeasurement water_velocity;
+    water_velocity.mu << 0.9, 0.1;
+    water_velocity.cov = Eigen::Matrix2d::Identity() * 1e-2;
+
+    // the reductions over the sigma points are serial, so the worker count doesn't change the result
+    for(unsigned i = 0; i < 5; i++)
+    {
+        serial->predictionStep(0.01);
+        parallel->predictionStep(0.01);
+        checkSameEstimate(*parallel, *serial, 0.);
+        serial->integrateMeasurement(efforts);
+        parallel->integrateMeasurement(efforts);
+        checkSameEstimate(*parallel, *serial, 0.);
+        serial->integrateMeasurement(water_velocity, 0.5);
+        parallel->integrateMeasurement(water_velocity, 0.5);
+        checkSameEstimate(*parallel, *serial, 0.);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(structured_prediction_matches_the_dense_prediction)
+{
+    boost::shared_ptr<PoseUKF> dense = test::createPoseUKF();
+    boost::shared_ptr<PoseUKF> structured = test::createPoseUKF();
+    structured->setStructuredPrediction(true);
+
+    // the states outside of the navigation core are linear in the process model
+    for(unsigned i = 0; i < 20; i++)
+    {
+        dense->predictionStep(0.01);
+        structured->predictionStep(0.01);
+    }
+    checkSameEstimate(*structured, *dense, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(single_precision_prediction_keeps_the_position_far_from_the_origin)
+{
+    boost::shared_ptr<PoseUKF> reference = test::createPoseUKF();
+    boost::shared_ptr<PoseUKF> single = test::createPoseUKF();
+    single->setPropagationPrecision(PoseUKF::SINGLE_PRECISION);
+    // a float has a resolution of about 1cm at 100km
+    PoseUKF::Checkpoint checkpoint;
+    reference->saveCheckpoint(checkpoint);
+    checkpoint.mu.position = Eigen::Vector3d(1e5, -1e5, -10.);
+    reference->restoreCheckpoint(checkpoint);
+    single->restoreCheckpoint(checkpoint);
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu << 0.01, -0.02, 0.05;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    reference->integrateMeasurement(rotation_rate);
+    single->integrateMeasurement(rotation_rate);
+
+    for(unsigned i = 0; i < 100; i++)
+    {
+        reference->predictionStep(0.01);
+        single->predictionStep(0.01);
+    }
+    PoseUKF::State state, reference_state;
+    PoseUKF::Covariance cov, reference_cov;
+    single->getCurrentState(state, cov);
+    reference->getCurrentState(reference_state, reference_cov);
+    BOOST_CHECK_SMALL((Eigen::Vector3d(state.position) - Eigen::Vector3d(reference_state.position)).norm(), 1e-5);
+    BOOST_CHECK_SMALL(Eigen::AngleAxisd(state.orientation.inverse() * reference_state.orientation).angle(), 1e-5);
+    // the rounding of the sigma points is relative to their spread
+    BOOST_CHECK_SMALL((cov - reference_cov).cwiseAbs().maxCoeff(), 1e-3 * reference_cov.cwiseAbs().maxCoeff());
+    BOOST_CHECK_EQUAL(single->getFullPredictionCount(), reference->getFullPredictionCount());
+}
+
+BOOST_AUTO_TEST_CASE(water_velocity_profile_matches_sequential_cell_updates)
+{
+    boost::shared_ptr<PoseUKF> sequential = test::createPoseUKF();
+    boost::shared_ptr<PoseUKF> stacked = test::createPoseUKF();
+    // with a known orientation the cell model is linear in the velocity and water current states
+    PoseUKF::Checkpoint checkpoint;
+    sequential->saveCheckpoint(checkpoint);
+    MTK::subblock(checkpoint.sigma, &PoseUKF::State::orientation) = Eigen::Matrix3d::Identity() * 1e-12;
+    sequential->restoreCheckpoint(checkpoint);
+    stacked->restoreCheckpoint(checkpoint);
+
+    PoseUKF::WaterVelocityProfile profile;
+    PoseUKF::WaterVelocityMeasurement cell;
+    cell.cov = Eigen::Matrix2d::Identity() * 1e-2;
+    for(unsigned i = 0; i < 8; i++)
+    {
+        cell.mu << 0.9 + 0.01 * i, 0.1 - 0.005 * i;
+        const double weighting = double(i) / 8.;
+        profile.addCell(cell.mu, cell.cov, weighting);
+        sequential->integrateMeasurement(cell, weighting);
+    }
+    stacked->integrateMeasurement(profile);
+
+    // the cells are independent, so the stacked update is the product of the cell updates
+    checkSameEstimate(*stacked, *sequential, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(preintegrated_prediction_matches_the_full_rate_prediction)
+{
+    boost::shared_ptr<PoseUKF> full_rate = test::createPoseUKF();
+    boost::shared_ptr<PoseUKF> preintegrated = test::createPoseUKF();
+    preintegrated->setFullPredictionPeriod(0.1);
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu << 0., 0., 0.2;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    PoseUKF::Acceleration acceleration;
+    acceleration.mu << 0., 0., 9.81;
+    acceleration.cov = Eigen::Matrix3d::Identity() * 1e-4;
+
+    // the full rate filter integrates every sample, the other one a single delta rotation and mean specific force.
+    // the rotation about the vertical axis keeps the specific force of the gravity constant
+    for(unsigned i = 0; i < 10; i++)
+    {
+        full_rate->integrateMeasurement(rotation_rate);
+        full_rate->predictionStep(0.01);
+        full_rate->integrateMeasurement(acceleration);
+        preintegrated->preintegrateImuSample(rotation_rate, acceleration, 0.01);
+        preintegrated->predictionStep(0.01);
+    }
+    preintegrated->flushPrediction();
+    BOOST_CHECK_EQUAL(preintegrated->getFullPredictionCount(), 1u);
+
+    PoseUKF::State full_rate_state, preintegrated_state;
+    PoseUKF::Covariance full_rate_cov, preintegrated_cov;
+    full_rate->getCurrentState(full_rate_state, full_rate_cov);
+    preintegrated->getCurrentState(preintegrated_state, preintegrated_cov);
+    const Eigen::Vector3d orientation_error = preintegrated_state.orientation - full_rate_state.orientation;
+    BOOST_CHECK_SMALL(orientation_error.norm(), 1e-4);
+    BOOST_CHECK_SMALL((Eigen::Vector3d(preintegrated_state.velocity) - Eigen::Vector3d(full_rate_state.velocity)).norm(), 1e-3);
+    BOOST_CHECK_SMALL((Eigen::Vector3d(preintegrated_state.position) - Eigen::Vector3d(full_rate_state.position)).norm(), 1e-3);
+    BOOST_CHECK_SMALL((MTK::subblock(preintegrated_cov, &PoseUKF::State::orientation) -
+                       MTK::subblock(full_rate_cov, &PoseUKF::State::orientation)).cwiseAbs().maxCoeff(), 1e-5);
+}
+
+BOOST_AUTO_TEST_CASE(preintegrated_samples_have_to_cover_the_predicted_interval)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu << 0., 0., 0.05;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    PoseUKF::Acceleration acceleration;
+    acceleration.mu << 0., 0., 9.81;
+    acceleration.cov = Eigen::Matrix3d::Identity() * 1e-4;
+
+    filter->preintegrateImuSample(rotation_rate, acceleration, 0.01);
+    BOOST_CHECK_THROW(filter->predictionStep(0.02), std::runtime_error);
+}
@@ -0,0 +1,97 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/PoseUKFBank.hpp>
+#include "TestFilters.hpp"
+#include <cmath>
+
+using namespace uwv_kalman_filters;
+
+/* Test filter with its position moved by the given offset */
+static boost::shared_ptr<PoseUKF> createHypothesis(const Eigen::Vector3d& position_offset)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    PoseUKF::Checkpoint checkpoint;
+    filter->saveCheckpoint(checkpoint);
+    checkpoint.mu.position = checkpoint.mu.position + position_offset;
+    filter->restoreCheckpoint(checkpoint);
+    return filter;
+}
+
+BOOST_AUTO_TEST_CASE(bank_accumulates_every_innovation_of_a_call)
+{
+    PoseUKFBank bank(test::testLocation());
+    boost::shared_ptr<PoseUKF> reference = test::createPoseUKF();
+    reference->setInnovationLikelihood(true);
+    bank.addHypothesis(test::createPoseUKF());
+    bank.getHypothesis(0)->setFullPredictionPeriod(0.05);
+    reference->setFullPredictionPeriod(0.05);
+
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu << 0., 0., 0.05;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    PoseUKF::Acceleration acceleration;
+    acceleration.mu << 0., 0., 9.81;
+    acceleration.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    PoseUKF::Velocity velocity;
+    velocity.mu << 1., 0.1, 0.;
+    velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+
+    for(unsigned i = 0; i < 3; i++)
+    {
+        bank.getHypothesis(0)->preintegrateImuSample(rotation_rate, acceleration, 0.01);
+        reference->preintegrateImuSample(rotation_rate, acceleration, 0.01);
+        bank.predictionStep(0.01);
+        reference->predictionStep(0.01);
+    }
+
+    // the velocity update of the bank also completes the pending prediction, which integrates
+    // the pre-integrated acceleration, the reference evaluates both innovations one by one
+    bank.integrateMeasurement(velocity);
+    reference->flushPrediction();
+    const double acceleration_log_likelihood = reference->getLastInnovation().log_likelihood;
+    reference->integrateMeasurement(velocity);
+    const double velocity_log_likelihood = reference->getLastInnovation().log_likelihood;
+
+    BOOST_CHECK(acceleration_log_likelihood != 0.);
+    BOOST_CHECK_CLOSE(bank.getLogLikelihood(0), acceleration_log_likelihood + velocity_log_likelihood, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(bank_prunes_unlikely_hypotheses)
+{
+    PoseUKFBank bank(test::testLocation());
+    bank.addHypothesis(createHypothesis(Eigen::Vector3d::Zero()));
+    bank.addHypothesis(createHypothesis(Eigen::Vector3d(5., 0., 0.)));
+    bank.addHypothesis(createHypothesis(Eigen::Vector3d(0.1, 0., 0.)));
+
+    PoseUKF::XY_Position xy_position;
+    xy_position.mu << 0., 0.;
+    xy_position.cov = Eigen::Matrix2d::Identity() * 0.01;
+    for(unsigned i = 0; i < 5; i++)
+    {
+        bank.predictionStep(0.01);
+        bank.integrateMeasurement(xy_position);
+    }
+
+    BOOST_CHECK(bank.getLogLikelihood(1) < bank.getLogLikelihood(2));
+    BOOST_CHECK(bank.getLogLikelihood(2) < bank.getLogLikelihood(0));
+    BOOST_CHECK_EQUAL(bank.prune(1e-6), 1u);
+    BOOST_REQUIRE_EQUAL(bank.size(), 2u);
+    BOOST_CHECK_EQUAL(bank.getMostLikely(), 0u);
+    BOOST_CHECK_CLOSE(bank.getProbability(0) + bank.getProbability(1), 1., 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(bank_merges_close_hypotheses)
+{
+    PoseUKFBank bank(test::testLocation());
+    boost::shared_ptr<PoseUKF> likely = createHypothesis(Eigen::Vector3d::Zero());
+    bank.addHypothesis(createHypothesis(Eigen::Vector3d(0.01, 0., 0.)), 1.);
+    bank.addHypothesis(createHypothesis(Eigen::Vector3d(20., 0., 0.)), 1.);
+    bank.addHypothesis(likely, 3.);
+
+    // the survivor of the close pair is the more likely one, it carries the probability of both
+    BOOST_CHECK_EQUAL(bank.merge(1.), 1u);
+    BOOST_REQUIRE_EQUAL(bank.size(), 2u);
+    BOOST_CHECK(bank.getHypothesis(0) == likely);
+    BOOST_CHECK_CLOSE(bank.getLogLikelihood(0), std::log(4.), 1e-9);
+    BOOST_CHECK_CLOSE(bank.getProbability(0), 0.8, 1e-9);
+    BOOST_CHECK_CLOSE(bank.getProbability(1), 0.2, 1e-9);
+}
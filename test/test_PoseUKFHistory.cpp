@@ -0,0 +1,68 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/PoseUKFHistory.hpp>
+#include "TestFilters.hpp"
+
+using namespace uwv_kalman_filters;
+
+BOOST_AUTO_TEST_CASE(delayed_measurements_give_the_in_order_estimate)
+{
+    boost::shared_ptr<PoseUKF> filters[2] = { test::createPoseUKF(), test::createPoseUKF() };
+    EffortUpdateSchedulingParameters parameters;
+    parameters.velocity_timeout = 0.2;
+    parameters.max_velocity_std = 1.;
+    parameters.decimation = 3;
+    for(unsigned i = 0; i < 2; i++)
+    {
+        filters[i]->setDynamicModelMinDepth(2.);
+        filters[i]->enableEffortUpdateScheduling(parameters);
+    }
+    PoseUKFHistory in_order(*filters[0], base::Time());
+    PoseUKFHistory delayed(*filters[1], base::Time());
+
+    PoseUKF::Z_Position z_position;
+    z_position.mu << -10.;
+    z_position.cov << 1e-2;
+    PoseUKF::Velocity velocity;
+    velocity.mu << 1., 0.1, 0.;
+    velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    PoseUKF::BodyEffortsMeasurement efforts;
+    efforts.mu << 20., 0., 0., 0., 0., 1.;
+    efforts.cov = base::Matrix6d::Identity();
+
+    // the velocities arrive three epochs late at the second history
+    const unsigned delay = 3;
+    for(unsigned i = 1; i <= 100; i++)
+    {
+        const base::Time time = base::Time::fromMicroseconds(10000 * i);
+        in_order.predictionStep(time);
+        delayed.predictionStep(time);
+        in_order.integrateMeasurement(time, z_position);
+        delayed.integrateMeasurement(time, z_position);
+        in_order.integrateMeasurement(time, efforts);
+        delayed.integrateMeasurement(time, efforts);
+        if(i % 15 == 0)
+            in_order.integrateMeasurement(time, velocity);
+        if(i > delay && (i - delay) % 15 == 0)
+            delayed.integrateMeasurement(base::Time::fromMicroseconds(10000 * (i - delay)), velocity);
+    }
+    BOOST_CHECK_EQUAL(in_order.getDelayedCount(), 0u);
+    BOOST_CHECK_EQUAL(delayed.getDelayedCount(), 6u);
+    BOOST_CHECK_EQUAL(delayed.getDroppedCount(), 0u);
+
+    PoseUKF::State states[2];
+    PoseUKF::Covariance covs[2];
+    for(unsigned i = 0; i < 2; i++)
+        filters[i]->getCurrentState(states[i], covs[i]);
+    BOOST_CHECK_SMALL((states[0].position - states[1].position).norm(), 1e-9);
+    BOOST_CHECK_SMALL((states[0].velocity - states[1].velocity).norm(), 1e-9);
+    BOOST_CHECK_SMALL(states[0].orientation.angularDistance(states[1].orientation), 1e-9);
+    BOOST_CHECK_SMALL((covs[0] - covs[1]).cwiseAbs().maxCoeff(), 1e-9);
+
+    const PoseUKF::EffortUpdateStatistics& statistics = filters[0]->getEffortUpdateStatistics();
+    const PoseUKF::EffortUpdateStatistics& delayed_statistics = filters[1]->getEffortUpdateStatistics();
+    BOOST_CHECK_EQUAL(statistics.applied + statistics.skipped_decimated, 100u);
+    BOOST_CHECK(statistics.skipped_decimated > 0u);
+    BOOST_CHECK_EQUAL(delayed_statistics.applied, statistics.applied);
+    BOOST_CHECK_EQUAL(delayed_statistics.skipped_decimated, statistics.skipped_decimated);
+    BOOST_CHECK_EQUAL(delayed_statistics.skipped_surface, statistics.skipped_surface);
+}
@@ -0,0 +1,54 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/PoseUKFSmoother.hpp>
+#include <Eigen/Eigenvalues>
+#include <vector>
+#include "TestFilters.hpp"
+
+using namespace uwv_kalman_filters;
+
+BOOST_AUTO_TEST_CASE(smoothed_covariance_is_bounded_by_the_filtered_one)
+{
+    boost::shared_ptr<PoseUKF> filter = test::createPoseUKF();
+    PoseUKFSmoother smoother(*filter, 20);
+
+    // straight line with a velocity update in each epoch
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu.setZero();
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    filter->integrateMeasurement(rotation_rate);
+    PoseUKF::Velocity velocity;
+    velocity.mu << 1., 0.1, 0.;
+    velocity.cov = Eigen::Matrix3d::Identity() * 1e-4;
+
+    const unsigned epochs = 10;
+    std::vector< PoseUKF::Covariance, Eigen::aligned_allocator<PoseUKF::Covariance> > filtered(epochs);
+    PoseUKF::State state;
+    for(unsigned i = 0; i < epochs; i++)
+    {
+        filter->getCurrentState(state, filtered[i]);
+        filter->predictionStep(0.1);
+        filter->integrateMeasurement(velocity);
+    }
+    BOOST_REQUIRE_EQUAL(smoother.size(), epochs);
+
+    // at the last epoch the smoothed moments are the filtered ones
+    PoseUKF::Covariance current_cov;
+    filter->getCurrentState(state, current_cov);
+    SmoothedPoseState smoothed;
+    BOOST_REQUIRE(smoother.getSmoothedState(0, smoothed));
+    BOOST_CHECK_SMALL((smoothed.sigma - current_cov).cwiseAbs().maxCoeff(), 1e-15);
+    BOOST_CHECK_SMALL((smoothed.mu - PoseUKF::WState(state)).norm(), 1e-15);
+
+    // earlier epochs gain information from the following updates
+    for(unsigned lag = 1; lag <= epochs; lag++)
+    {
+        BOOST_REQUIRE(smoother.getSmoothedState(lag, smoothed));
+        const PoseUKF::Covariance& filtered_cov = filtered[epochs - lag];
+        const double tolerance = 1e-9 * filtered_cov.diagonal().maxCoeff();
+        Eigen::SelfAdjointEigenSolver<PoseUKF::Covariance> solver(filtered_cov - smoothed.sigma);
+        BOOST_CHECK_GE(solver.eigenvalues().minCoeff(), -tolerance);
+        BOOST_CHECK_LE(smoothed.sigma.trace(), filtered_cov.trace());
+        BOOST_CHECK_LT(MTK::subblock(smoothed.sigma, &PoseUKF::State::velocity)(0, 0),
+                       MTK::subblock(filtered_cov, &PoseUKF::State::velocity)(0, 0));
+    }
+}
@@ -0,0 +1,183 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/VehicleFleet.hpp>
+#include <uwv_kalman_filters/MissionReplay.hpp>
+#include "TestFilters.hpp"
+
+using namespace uwv_kalman_filters;
+
+/* Class of the test vehicle, the filters of the class only differ from test::createPoseUKF in their models */
+static VehicleClass testVehicleClass()
+{
+    VehicleClass vehicle_class;
+    vehicle_class.location = test::testLocation();
+    vehicle_class.model_parameters = test::vehicleParameters();
+    vehicle_class.filter_parameter.imu_in_body = Eigen::Vector3d(0.1, 0., 0.05);
+    vehicle_class.filter_parameter.gyro_bias_tau = 3600.;
+    vehicle_class.filter_parameter.acc_bias_tau = 3600.;
+    vehicle_class.filter_parameter.inertia_tau = 3600.;
+    vehicle_class.filter_parameter.lin_damping_tau = 3600.;
+    vehicle_class.filter_parameter.quad_damping_tau = 3600.;
+    vehicle_class.filter_parameter.water_velocity_tau = 900.;
+    vehicle_class.filter_parameter.water_velocity_limits = 0.5;
+    vehicle_class.filter_parameter.water_velocity_scale = 0.001;
+    vehicle_class.filter_parameter.adcp_bias_tau = 3600.;
+    return vehicle_class;
+}
+
+/* Adds a vehicle of the class in the state of the reference filter, which measured the given rotation rate */
+static unsigned createVehicle(VehicleFleet& fleet, unsigned vehicle_class, PoseUKF& reference,
+                              const Eigen::Vector3d& rotation_rate_mu = Eigen::Vector3d(0., 0., 0.05))
+{
+    PoseUKF::State state;
+    PoseUKF::Covariance state_cov;
+    reference.getCurrentState(state, state_cov);
+    const unsigned vehicle = fleet.createVehicle(vehicle_class, state, state_cov);
+    PoseUKF& filter = *fleet.getPoseFilter(vehicle);
+    filter.setProcessNoiseCovariance(reference.getProcessNoiseCovariance());
+    PoseUKF::RotationRate rotation_rate;
+    rotation_rate.mu = rotation_rate_mu;
+    rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+    filter.integrateMeasurement(rotation_rate);
+    return vehicle;
+}
+
+static void checkSameEstimate(PoseUKF& filter, PoseUKF& reference, double tolerance)
+{
+    PoseUKF::State state, reference_state;
+    PoseUKF::Covariance state_cov, reference_cov;
+    filter.getCurrentState(state, state_cov);
+    reference.getCurrentState(reference_state, reference_cov);
+    BOOST_CHECK_SMALL((PoseUKF::WState(state) - PoseUKF::WState(reference_state)).cwiseAbs().maxCoeff(), tolerance);
+    BOOST_CHECK_SMALL((state_cov - reference_cov).cwiseAbs().maxCoeff(), tolerance);
+}
+
+BOOST_AUTO_TEST_CASE(batched_prediction_matches_the_filter_prediction)
+{
+    const unsigned thread_counts[] = {1, 3};
+    for(unsigned t = 0; t < 2; t++)
+    {
+        VehicleFleet fleet(thread_counts[t]);
+        const unsigned vehicle_class = fleet.addVehicleClass(testVehicleClass());
+        std::vector< boost::shared_ptr<PoseUKF> > references;
+        for(unsigned i = 0; i < 4; i++)
+        {
+            references.push_back(test::createPoseUKF());
+            PoseUKF::RotationRate rotation_rate;
+            rotation_rate.mu << 0.01 * i, -0.02, 0.05 + 0.1 * i;
+            rotation_rate.cov = Eigen::Matrix3d::Identity() * 1e-6;
+            references.back()->integrateMeasurement(rotation_rate);
+            createVehicle(fleet, vehicle_class, *references.back(), rotation_rate.mu);
+        }
+        // a filter merging its predictions is predicted on its own
+        references[3]->setFullPredictionPeriod(0.03);
+        fleet.getPoseFilter(3)->setFullPredictionPeriod(0.03);
+        // a single precision filter is predicted in the single precision batch
+        references[2]->setPropagationPrecision(PoseUKF::SINGLE_PRECISION);
+        fleet.getPoseFilter(2)->setPropagationPrecision(PoseUKF::SINGLE_PRECISION);
+
+        for(unsigned step = 0; step < 10; step++)
+        {
+            fleet.predictionStep(0.01);
+            for(unsigned i = 0; i < references.size(); i++)
+                references[i]->predictionStep(0.01);
+        }
+        for(unsigned i = 0; i < references.size(); i++)
+        {
+            fleet.getPoseFilter(i)->flushPrediction();
+            references[i]->flushPrediction();
+            BOOST_CHECK_EQUAL(fleet.getPoseFilter(i)->getFullPredictionCount(), references[i]->getFullPredictionCount());
+            checkSameEstimate(*fleet.getPoseFilter(i), *references[i], 1e-12);
+        }
+        PoseUKF::State state;
+        fleet.getPoseFilter(0)->getCurrentState(state);
+        BOOST_CHECK_SMALL((fleet.getStates().positions[0] - Eigen::Vector3d(state.position)).norm(), 1e-15);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(velocity_filter_receives_velocity_and_pressure_records)
+{
+    VehicleFleet fleet;
+    const unsigned vehicle_class = fleet.addVehicleClass(testVehicleClass());
+    boost::shared_ptr<PoseUKF> reference_pose = test::createPoseUKF();
+    const unsigned vehicle = createVehicle(fleet, vehicle_class, *reference_pose);
+
+    VelocityUKF::State state;
+    state.velocity = Eigen::Vector3d(1., 0.1, 0.);
+    state.z_position(0) = -10.;
+    const VelocityUKF::Covariance state_cov = VelocityUKF::Covariance::Identity() * 0.1;
+    fleet.createVelocityFilter(vehicle, state, state_cov);
+    VelocityUKF reference(state, state_cov);
+    reference.setupMotionModel(test::vehicleParameters());
+
+    VelocityUKF::DVLMeasurement dvl;
+    dvl.mu << 1.2, 0., 0.1;
+    dvl.cov = Eigen::Matrix3d::Identity() * 1e-4;
+    VelocityUKF::PressureMeasurement pressure;
+    pressure.mu << -9.5;
+    pressure.cov << 0.01;
+    std::vector<FleetRecord> records(2);
+    records[0].vehicle = records[1].vehicle = vehicle;
+    records[0].record.setMeasurement(LOG_VELOCITY, 0, dvl.mu, dvl.cov);
+    records[1].record.setMeasurement(LOG_Z_POSITION, 0, pressure.mu, pressure.cov);
+
+    fleet.predictionStep(0.01);
+    reference.predictionStep(0.01);
+    BOOST_CHECK_EQUAL(fleet.integrateRecords(records), 2u);
+    reference.integrateMeasurement(dvl);
+    reference.integrateMeasurement(pressure);
+
+    VelocityUKF::State filtered, expected;
+    VelocityUKF::Covariance filtered_cov, expected_cov;
+    fleet.getVelocityFilter(vehicle)->getCurrentState(filtered, filtered_cov);
+    reference.getCurrentState(expected, expected_cov);
+    BOOST_CHECK_SMALL((VelocityUKF::WState(filtered) - VelocityUKF::WState(expected)).norm(), 1e-12);
+    BOOST_CHECK_SMALL((filtered_cov - expected_cov).cwiseAbs().maxCoeff(), 1e-12);
+    BOOST_CHECK_SMALL(filtered.z_position(0) + 9.5, 0.05);
+    BOOST_CHECK_SMALL((fleet.getStates().twists[vehicle].head<3>() - Eigen::Vector3d(filtered.velocity)).norm(), 1e-15);
+}
+
+BOOST_AUTO_TEST_CASE(vehicles_of_a_class_share_its_effort_models)
+{
+    VehicleFleet fleet(3);
+    const unsigned vehicle_class = fleet.addVehicleClass(testVehicleClass());
+    boost::shared_ptr<PoseUKF> reference = test::createPoseUKF();
+    std::vector<FleetRecord> records;
+    for(unsigned i = 0; i < 6; i++)
+    {
+        createVehicle(fleet, vehicle_class, *reference);
+        // the parameters of each vehicle are applied to the models of the worker integrating it
+        PoseUKF::Checkpoint checkpoint;
+        fleet.getPoseFilter(i)->saveCheckpoint(checkpoint);
+        checkpoint.mu.lin_damping(0, 0) += 2. * i;
+        fleet.getPoseFilter(i)->restoreCheckpoint(checkpoint);
+
+        PoseUKF::BodyEffortsMeasurement efforts;
+        efforts.mu << 20. + i, 0., 0., 0., 0., 1.;
+        efforts.cov = base::Matrix6d::Identity();
+        FleetRecord record;
+        record.vehicle = i;
+        record.record.setMeasurement(LOG_BODY_EFFORTS, 0, efforts.mu, efforts.cov);
+        record.record.aux[0] = i % 2;
+        records.push_back(record);
+    }
+    BOOST_CHECK_EQUAL(fleet.integrateRecords(records), 6u);
+
+    for(unsigned i = 0; i < 6; i++)
+    {
+        boost::shared_ptr<PoseUKF> expected = test::createPoseUKF();
+        PoseUKF::Checkpoint checkpoint;
+        expected->saveCheckpoint(checkpoint);
+        checkpoint.mu.lin_damping(0, 0) += 2. * i;
+        expected->restoreCheckpoint(checkpoint);
+        BOOST_CHECK(integrateRecord(*expected, records[i].record));
+        checkSameEstimate(*fleet.getPoseFilter(i), *expected, 1e-12);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(velocity_filters_require_a_vehicle_class)
+{
+    VehicleFleet fleet;
+    const unsigned vehicle = fleet.addVehicle(test::createPoseUKF());
+    BOOST_CHECK_THROW(fleet.createVelocityFilter(vehicle, VelocityUKF::State(), VelocityUKF::Covariance::Identity()),
+                      std::invalid_argument);
+}
@@ -0,0 +1,38 @@
+#include <boost/test/unit_test.hpp>
+#include <uwv_kalman_filters/VelocityUKF.hpp>
+
+using namespace uwv_kalman_filters;
+
+static void checkPressureUpdate(FilterBackend backend)
+{
+    VelocityUKF::State state;
+    state.velocity = Eigen::Vector3d(1., 0.1, 0.);
+    state.z_position(0) = -10.;
+    VelocityUKF::Covariance state_cov = VelocityUKF::Covariance::Identity() * 0.1;
+    state_cov(2, 3) = state_cov(3, 2) = 0.05;
+    VelocityUKF filter(state, state_cov);
+    filter.setFilterBackend(backend);
+
+    VelocityUKF::PressureMeasurement pressure;
+    pressure.mu << -9.5;
+    pressure.cov << 0.01;
+    filter.integrateMeasurement(pressure);
+
+    // the pressure observes the z position directly, for which the update is the Kalman update
+    const double s = state_cov(3, 3) + pressure.cov(0, 0);
+    const VelocityUKF::WState::vectorized_type gain = state_cov.col(3) / s;
+    const VelocityUKF::WState expected_mu = VelocityUKF::WState(state) + VelocityUKF::WState::vectorized_type(gain * (pressure.mu(0) - state.z_position(0)));
+    const VelocityUKF::Covariance expected_cov = state_cov - s * gain * gain.transpose();
+
+    VelocityUKF::State filtered;
+    VelocityUKF::Covariance filtered_cov;
+    filter.getCurrentState(filtered, filtered_cov);
+    BOOST_CHECK_SMALL((VelocityUKF::WState(filtered) - expected_mu).norm(), 1e-12);
+    BOOST_CHECK_SMALL((filtered_cov - expected_cov).cwiseAbs().maxCoeff(), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(pressure_update_is_the_kalman_update)
+{
+    checkPressureUpdate(STANDARD_UKF);
+    checkPressureUpdate(SQUARE_ROOT_UKF);
+}